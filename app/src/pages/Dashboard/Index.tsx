@@ -7,7 +7,7 @@ import Faciliteiten from './components/Faciliteiten';
 import { scanService } from '../../services/scanService';
 import { facilityService } from '../../services/facilityService';
 
-import { User, Scan, Facility } from '../../types';
+import { User, Scan, Facility, Occupancy } from '../../types';
 
 interface DashboardProps {
     user: User | null;
@@ -16,7 +16,9 @@ interface DashboardProps {
 const Dashboard: React.FC<DashboardProps> = ({ user }) => {
   const [scans, setScans] = useState<Scan[]>([]);
   const [facilities, setFacilities] = useState<Facility[]>([]);
+  const [occupancy, setOccupancy] = useState<Occupancy[]>([]);
   const [loading, setLoading] = useState(true);
+  const [reload, setReload] = useState(0);
 
   useEffect(() => {
     const fetchData = async () => {
@@ -25,12 +27,14 @@ const Dashboard: React.FC<DashboardProps> = ({ user }) => {
         return;
       }
       try {
-        const [scansData, facilitiesData] = await Promise.all([
-          scanService.getScans(),
-          facilityService.getFacilities()
+        const [scansPage, facilitiesData, occupancyData] = await Promise.all([
+          scanService.getScans({ limit: 10 }),
+          facilityService.getFacilities(),
+          facilityService.getOccupancy()
         ]);
-        setScans(scansData);
+        setScans(scansPage.scans);
         setFacilities(facilitiesData);
+        setOccupancy(occupancyData);
       } catch (error) {
         console.error('Failed to fetch dashboard data:', error);
       } finally {
@@ -39,10 +43,27 @@ const Dashboard: React.FC<DashboardProps> = ({ user }) => {
     };
 
     fetchData();
+  }, [user, reload]);
+
+  // New scans are pushed by the backend; the list and the occupancy follow them
+  useEffect(() => {
+    if (!user) return;
+    return scanService.subscribeScans(
+      (scan) => {
+        setScans(prev => [scan, ...prev.filter(s => s.id !== scan.id)].slice(0, 10));
+        setOccupancy(prev => prev.map((o) => {
+          if (o.facility_id !== scan.facility_id) return o;
+          const next = { ...o, [scan.in_out]: o[scan.in_out] + 1 };
+          const present = Math.max(0, next.in - next.out);
+          return { ...next, present, full: present >= o.capacity, over_capacity: present > o.capacity };
+        }));
+      },
+      () => setReload(n => n + 1)
+    );
   }, [user]);
 
   // Transform scans data for display
-  const displayScans = scans.slice(0, 10).map((scan) => {
+  const displayScans = scans.map((scan) => {
     const facility = facilities.find(f => f.facilities_id === scan.facility_id);
     return {
       id: scan.id,
@@ -100,7 +121,7 @@ const Dashboard: React.FC<DashboardProps> = ({ user }) => {
 
         <Weer variants={itemVariants} />
 
-        <Faciliteiten facilities={facilities} variants={itemVariants} user={user} loading={loading} />
+        <Faciliteiten facilities={facilities} occupancy={occupancy} variants={itemVariants} user={user} loading={loading} />
       </motion.section>
     </div>
   );
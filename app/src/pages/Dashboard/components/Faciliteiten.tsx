@@ -2,16 +2,17 @@ import { motion, Variants } from 'framer-motion';
 import { FaLock, FaTools } from 'react-icons/fa';
 import { MdLocalLaundryService } from 'react-icons/md';
 
-import { User, Facility } from '../../../types';
+import { User, Facility, Occupancy } from '../../../types';
 
 interface FaciliteitenProps {
     facilities: Facility[];
+    occupancy?: Occupancy[];
     variants?: Variants;
     user: User | null;
     loading?: boolean;
 }
 
-const Faciliteiten: React.FC<FaciliteitenProps> = ({ facilities, variants, user, loading }) => {
+const Faciliteiten: React.FC<FaciliteitenProps> = ({ facilities, occupancy = [], variants, user, loading }) => {
     const brokenFacilities = facilities.filter(f => f.broken);
     const workingFacilities = facilities.filter(f => !f.broken);
     const brokenRatio = facilities.length > 0 ? brokenFacilities.length / facilities.length : 0;
@@ -30,6 +31,8 @@ const Faciliteiten: React.FC<FaciliteitenProps> = ({ facilities, variants, user,
         return <FaTools className="w-4 h-4" />;
     };
 
+    const occupancyOf = (id: number) => occupancy.find(o => o.facility_id === id);
+
     // Group facilities by type
     const groupedFacilities = facilities.reduce((acc, facility) => {
         const type = facility.facility_type;
@@ -85,18 +88,22 @@ const Faciliteiten: React.FC<FaciliteitenProps> = ({ facilities, variants, user,
                                     <div className="flex flex-wrap gap-2">
                                         {typeFacilities.map((facility, index) => {
                                             const isBroken = facility.broken;
+                                            const current = occupancyOf(facility.facilities_id);
                                             return (
                                                 <div
                                                     key={facility.facilities_id}
                                                     className={`flex items-center gap-2 px-3 py-1.5 rounded-lg text-sm ${
                                                         isBroken
                                                             ? 'bg-rose-500/20 text-rose-400 border border-rose-500/50'
-                                                            : 'bg-emerald-500/20 text-emerald-400 border border-emerald-500/50'
+                                                            : current?.full
+                                                                ? 'bg-amber-500/20 text-amber-400 border border-amber-500/50'
+                                                                : 'bg-emerald-500/20 text-emerald-400 border border-emerald-500/50'
                                                     }`}
                                                     title={`Capaciteit: ${facility.capacity}`}
                                                 >
-                                                    <span className={`w-2 h-2 rounded-full ${isBroken ? 'bg-rose-500' : 'bg-emerald-500'}`}></span>
+                                                    <span className={`w-2 h-2 rounded-full ${isBroken ? 'bg-rose-500' : current?.full ? 'bg-amber-500' : 'bg-emerald-500'}`}></span>
                                                     <span>#{index + 1}</span>
+                                                    {current && <span className="text-xs">{current.present}/{facility.capacity}</span>}
                                                     {isBroken && <span className="text-xs">(Defect)</span>}
                                                 </div>
                                             );
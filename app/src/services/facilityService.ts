@@ -1,5 +1,5 @@
 import api from './api';
-import { Facility, FacilitiesResponse } from '../types';
+import { Facility, FacilitiesResponse, Occupancy, OccupancyResponse } from '../types';
 
 export const facilityService = {
   async getFacilities(): Promise<Facility[]> {
@@ -7,6 +7,11 @@ export const facilityService = {
     return response.data.facilities;
   },
 
+  async getOccupancy(): Promise<Occupancy[]> {
+    const response = await api.get<OccupancyResponse>('/facility/occupancy');
+    return response.data.occupancy;
+  },
+
   async createFacility(facilityType: string, capacity: number): Promise<void> {
     await api.put('/facility/create-facility', { facilityType, capacity });
   },
@@ -1,5 +1,5 @@
 import api from './api';
-import { Scan, ScansResponse } from '../types';
+import { Scan, ScansQuery, ScansResponse } from '../types';
 
 export interface LogScanData {
   tag_id: number;
@@ -8,9 +8,20 @@ export interface LogScanData {
 }
 
 export const scanService = {
-  async getScans(): Promise<Scan[]> {
-    const response = await api.get<ScansResponse>('/druppel/scans');
-    return response.data.scans;
+  // One page, newest first; pass the page's 'next' as 'before' for the one after it
+  async getScans(query: ScansQuery = {}): Promise<ScansResponse> {
+    const response = await api.get<ScansResponse>('/druppel/scans', { params: query });
+    return response.data;
+  },
+
+  // Scans as the backend stores them, over Server-Sent Events. The browser reconnects
+  // by itself; onReset is called when it missed too much and the list must be
+  // fetched again. Returns a function that closes the stream.
+  subscribeScans(onScan: (scan: Scan) => void, onReset: () => void): () => void {
+    const source = new EventSource(`${api.defaults.baseURL}/druppel/scans/stream`);
+    source.onmessage = (event) => onScan(JSON.parse(event.data));
+    source.addEventListener('reset', onReset);
+    return () => source.close();
   },
 
   async logScan(data: LogScanData): Promise<void> {
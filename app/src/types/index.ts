@@ -95,6 +95,30 @@ export interface PaginatedResponse<T> {
 
 export interface ScansResponse {
   scans: Scan[];
+  next: string | null;
+}
+
+export interface ScansQuery {
+  limit?: number;
+  before?: string;
+  from?: number;
+  to?: number;
+  facility?: number;
+}
+
+export interface Occupancy {
+  facility_id: number;
+  facility_type: string;
+  capacity: number;
+  in: number;
+  out: number;
+  present: number;
+  full: boolean;
+  over_capacity: boolean;
+}
+
+export interface OccupancyResponse {
+  occupancy: Occupancy[];
 }
 
 export interface KeyfobsResponse {
@@ -0,0 +1,186 @@
+// Scan ingestion load test
+//
+// Simulated scanners post batches to /api/druppel/scans/batch as fast as the backend
+// acknowledges them, the way a scanner drains its queue after an outage, and the
+// sustained scans/second and request latency are reported. Before and after the run
+// GET /health is read for the server's own view: rows per insert round and round
+// time. Run it against a backend on a test database, once per version to compare:
+//
+//   bun bench/scanLoad.js [--url http://localhost:3000] [--scanners 16] [--batch 8]
+//                         [--seconds 30] [--location 1] [--watch] [--json]
+//
+// With --watch the run also listens on the scan event stream, the way the dashboard
+// does, and reports tap-to-screen latency: from a scan's tap (its timestamp, taken
+// when the batch is built) to its event arriving. Run it with --scanners 1 --batch 1
+// for the latency of a single tap on an otherwise idle backend.
+//
+// Keyfob keys come from GET /api/druppel/keyfobs; scans for unknown keys are skipped
+// by the backend, so an empty keyfobs table measures the lookup path only.
+const options = {
+    url: 'http://localhost:3000',
+    scanners: 16,
+    batch: 8,
+    seconds: 30,
+    location: 1,
+    watch: false,
+    json: false,
+};
+
+for (let i = 2; i < process.argv.length; i++) {
+    const name = process.argv[i].replace(/^--/, '');
+    if (!(name in options)) {
+        console.error(`Unknown option --${name}`);
+        process.exit(2);
+    }
+    if (typeof options[name] === 'boolean') {
+        options[name] = true;
+    } else {
+        const value = process.argv[++i];
+        options[name] = typeof options[name] === 'number' ? Number(value) : value;
+    }
+}
+
+function percentile(sorted, q) {
+    if (sorted.length === 0) return null;
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * q))];
+}
+
+async function getJson(path) {
+    const res = await fetch(options.url + path);
+    return res.json();
+}
+
+// Collects the tap-to-screen latency of every event for our location from 'since' on
+async function watch(since, results, signal) {
+    const res = await fetch(`${options.url}/api/druppel/scans/stream?facility=${options.location}`, {
+        headers: { Accept: 'text/event-stream' },
+        signal,
+    });
+    if (!res.ok) throw new Error(`scan stream: HTTP ${res.status}`);
+    const decoder = new TextDecoder();
+    let buffer = '';
+    try {
+        for await (const chunk of res.body) {
+            const received = Date.now();
+            buffer += decoder.decode(chunk, { stream: true });
+            let end;
+            while ((end = buffer.indexOf('\n\n')) >= 0) {
+                const lines = buffer.slice(0, end).split('\n');
+                buffer = buffer.slice(end + 2);
+                const data = lines.find((line) => line.startsWith('data: '));
+                if (!data || lines.some((line) => line.startsWith('event: '))) continue;
+                const scan = JSON.parse(data.slice(6));
+                if (scan.timestamp >= since) results.latencies.push(received - scan.timestamp);
+            }
+        }
+    } catch (error) {
+        if (error.name !== 'AbortError') throw error;
+    }
+}
+
+async function scanner(index, keys, deadline, results) {
+    const device = `load-${index}`;
+    let seq = 0;
+    while (performance.now() < deadline) {
+        const scans = [];
+        for (let i = 0; i < options.batch; i++) {
+            scans.push({
+                keyfob_key: keys[(index * options.batch + seq) % keys.length],
+                location_id: options.location,
+                inout: seq % 2 === 0 ? 'in' : 'out',
+                time: Date.now(),
+                seq: seq++,
+            });
+        }
+        const start = performance.now();
+        try {
+            const res = await fetch(options.url + '/api/druppel/scans/batch', {
+                method: 'POST',
+                headers: { 'Content-Type': 'application/json' },
+                body: JSON.stringify({ device, now: Date.now(), scans }),
+            });
+            await res.text();
+            if (res.ok) {
+                results.latencies.push(performance.now() - start);
+                results.scans += scans.length;
+            } else {
+                results.errors++;
+            }
+        } catch (error) {
+            results.errors++;
+        }
+    }
+}
+
+async function main() {
+    const keyfobs = await getJson('/api/druppel/keyfobs');
+    const keys = (keyfobs.keyfobs || []).map((row) => row.keyfob_key).filter(Boolean);
+    if (keys.length === 0) keys.push('00:00:00:00');
+    const before = await getJson('/health').catch(() => null);
+
+    const results = { scans: 0, errors: 0, latencies: [] };
+    const events = { latencies: [] };
+    const stop = new AbortController();
+    const watching = options.watch ? watch(Date.now(), events, stop.signal) : null;
+    const start = performance.now();
+    const deadline = start + options.seconds * 1000;
+    await Promise.all(Array.from({ length: options.scanners }, (_, i) => scanner(i, keys, deadline, results)));
+    const elapsed = (performance.now() - start) / 1000;
+    if (watching) {
+        // Events for the last acknowledged scans may still be on their way
+        await new Promise((resolve) => setTimeout(resolve, 1000));
+        stop.abort();
+        await watching;
+    }
+
+    const after = await getJson('/health').catch(() => null);
+    const sorted = results.latencies.sort((a, b) => a - b);
+    const screen = events.latencies.sort((a, b) => a - b);
+    const report = {
+        scanners: options.scanners,
+        batch: options.batch,
+        seconds: elapsed,
+        keyfobs: keys.length,
+        requests: sorted.length,
+        errors: results.errors,
+        scans_per_s: results.scans / elapsed,
+        latency_ms: { p50: percentile(sorted, 0.5), p99: percentile(sorted, 0.99), max: sorted[sorted.length - 1] ?? null },
+        tap_to_screen_ms: options.watch ? {
+            events: screen.length,
+            p50: percentile(screen, 0.5),
+            p99: percentile(screen, 0.99),
+            max: screen[screen.length - 1] ?? null,
+        } : null,
+        server: after && after.ingest ? {
+            rounds: after.ingest.rounds - (before?.ingest?.rounds ?? 0),
+            rows_per_round: (after.ingest.rows - (before?.ingest?.rows ?? 0)) /
+                Math.max(1, after.ingest.rounds - (before?.ingest?.rounds ?? 0)),
+            round_ms: after.ingest.round_ms,
+            connections: after.db.connections,
+        } : null,
+    };
+
+    if (options.json) {
+        console.log(JSON.stringify(report));
+        return;
+    }
+    const fmt = (v) => (v == null ? '-' : v.toFixed(1));
+    console.log(`${report.scanners} scanners x ${report.batch} scans per batch for ${elapsed.toFixed(1)} s, ${report.keyfobs} keyfobs`);
+    console.log(`${report.requests} requests, ${report.errors} errors: ${report.scans_per_s.toFixed(1)} scans/s`);
+    console.log(`latency ms  p50 ${fmt(report.latency_ms.p50)}  p99 ${fmt(report.latency_ms.p99)}  max ${fmt(report.latency_ms.max)}`);
+    if (report.tap_to_screen_ms) {
+        const t = report.tap_to_screen_ms;
+        console.log(`tap-to-screen ms  p50 ${fmt(t.p50)}  p99 ${fmt(t.p99)}  max ${fmt(t.max)}  (${t.events} events for ${results.scans} scans)`);
+    }
+    if (report.server) {
+        console.log(`server: ${report.server.rounds} insert rounds, ${report.server.rows_per_round.toFixed(1)} rows per round, ` +
+            `round p99 ${fmt(report.server.round_ms.p99)} ms`);
+    } else {
+        console.log('server: no /health (older backend)');
+    }
+}
+
+main().catch((error) => {
+    console.error('Load test failed:', error.message);
+    process.exit(1);
+});
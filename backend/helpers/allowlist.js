@@ -0,0 +1,58 @@
+const { getKeyfobs } = require('./scans.js');
+
+// Versioned view of the keyfobs that may open a gate, for scanners that keep a local copy.
+// Every change to the active set bumps the version and is kept as a delta, so a scanner
+// that is a few versions behind only downloads what changed. 'epoch' changes when the
+// backend restarts; scanners on another epoch get a full list.
+const HISTORY_LIMIT = 50;
+const epoch = Date.now().toString(36);
+
+let version = 0;
+let current = new Set();
+const history = [];
+
+// Keys as the scanner reports them ("AA:BB:CC:DD"), stored without separators
+function normalizeKey(key) {
+    return String(key).replace(/[^0-9a-fA-F]/g, '').toUpperCase();
+}
+
+async function refresh() {
+    const rows = await getKeyfobs();
+    const keys = new Set(rows.map((row) => normalizeKey(row.keyfob_key)).filter((key) => key.length > 0));
+
+    const added = [...keys].filter((key) => !current.has(key));
+    const removed = [...current].filter((key) => !keys.has(key));
+    if (added.length === 0 && removed.length === 0 && version > 0) return;
+
+    version++;
+    history.push({ version, added, removed });
+    if (history.length > HISTORY_LIMIT) history.shift();
+    current = keys;
+}
+
+export async function getAllowlistDelta(sinceVersion, sinceEpoch) {
+    await refresh();
+
+    const since = Number(sinceVersion);
+    const oldest = history.length > 0 ? history[0].version : version;
+    const canDelta = sinceEpoch === epoch && Number.isInteger(since) && since >= oldest - 1 && since <= version;
+    if (!canDelta) {
+        return { epoch, version, full: true, keys: [...current] };
+    }
+
+    // Fold the deltas after 'since' into one; a key added then removed cancels out
+    const added = new Set();
+    const removed = new Set();
+    for (const delta of history) {
+        if (delta.version <= since) continue;
+        for (const key of delta.added) {
+            removed.delete(key);
+            added.add(key);
+        }
+        for (const key of delta.removed) {
+            added.delete(key);
+            removed.add(key);
+        }
+    }
+    return { epoch, version, full: false, added: [...added], removed: [...removed] };
+}
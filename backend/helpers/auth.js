@@ -1,6 +1,6 @@
-const mariadb = require('mariadb');
 const dotenv = require('dotenv').config({quiet: true});
 const nodemailer = require('nodemailer');
+const { getPool } = require('./db.js');
 const { hashPassword, comparePassword, generateOTP, generateToken, verifyToken } = require("./passwordHandler.js");
 
 var transporter = nodemailer.createTransport({
@@ -13,16 +13,8 @@ var transporter = nodemailer.createTransport({
     }
 });
 
-var vpool = {
-        host: process.env.DB_HOST,
-        user: process.env.DB_USER,
-        password: process.env.DB_PASS,
-        database: process.env.DB_NAME,
-        port: process.env.DB_PORT,
-}
-
 export async function createUser(first_name, last_name, affix, email, username, role) {
-    const pool = mariadb.createPool(vpool);
+    const pool = getPool();
     let conn;
 
     try {
@@ -30,7 +22,7 @@ export async function createUser(first_name, last_name, affix, email, username,
         const otp = generateOTP();
         // console.log('Generated OTP:', otp);
         const hashedPassword = await hashPassword(otp);
-        const result = await conn.query("INSERT INTO users (first_name, last_name, affix, role, email, username, password) VALUES (?, ?, ?, ?, ?, ?, ?)", [first_name, last_name, affix, role, email, username, hashedPassword]);
+        const result = await conn.execute("INSERT INTO users (first_name, last_name, affix, role, email, username, password) VALUES (?, ?, ?, ?, ?, ?, ?)", [first_name, last_name, affix, role, email, username, hashedPassword]);
 
         // await sendMail(otp); TODOOOO
         return result;
@@ -61,11 +53,11 @@ export async function sendMail(otp, toEmail) {
 }
 
 export async function loginUser(username, password) {
-    const pool = mariadb.createPool(vpool);
+    const pool = getPool();
     let conn;
     try {
         conn = await pool.getConnection();
-        const rows = await conn.query("SELECT * FROM users WHERE username = ?", [username]);
+        const rows = await conn.execute("SELECT * FROM users WHERE username = ?", [username]);
         if (!rows || rows.length === 0) {
             throw new Error('User not found');
         }
@@ -92,16 +84,15 @@ export async function loginUser(username, password) {
         throw new Error('Error logging in user');
     } finally {
         if (conn) conn.release();
-        await pool.end();
     }
 }
 
 export async function changePassword(username, oldPassword, newPassword) {
-    const pool = mariadb.createPool(vpool);
+    const pool = getPool();
     let conn;
     try {
         conn = await pool.getConnection();
-        const rows = await conn.query("SELECT * FROM users WHERE username = ?", [username]);
+        const rows = await conn.execute("SELECT * FROM users WHERE username = ?", [username]);
         if (!rows || rows.length === 0) {
             throw new Error('User not found');
         }
@@ -111,13 +102,12 @@ export async function changePassword(username, oldPassword, newPassword) {
             throw new Error('Old password is incorrect');
         }
         const hashedNewPassword = await hashPassword(newPassword);
-        await conn.query("UPDATE users SET password = ? WHERE username = ?", [hashedNewPassword, username]);
+        await conn.execute("UPDATE users SET password = ? WHERE username = ?", [hashedNewPassword, username]);
         return { message: 'Password changed successfully' };
     } catch (error) {
         console.error('Error changing password:', error);
         throw new Error('Error changing password');
     } finally {
         if (conn) conn.release();
-        await pool.end();
     }
 }
\ No newline at end of file
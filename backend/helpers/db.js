@@ -0,0 +1,79 @@
+const mariadb = require('mariadb');
+const dotenv = require('dotenv').config({quiet: true});
+
+// One pool for the whole process, created on first use. Every helper borrows a
+// connection from it and releases it; nothing closes the pool but shutdown.
+//
+// Queries go through conn.execute(), the binary protocol: each connection prepares a
+// statement once and keeps it in a cache of DB_PREPARE_CACHE entries, so a scan
+// insert after the first is a single round trip with no parsing on the server.
+// Idle connections are pinged before being handed out again and dropped after
+// DB_IDLE_TIMEOUT_S, so a database restart costs one failed validation rather than
+// a failed request.
+const POOL_DEFAULTS = {
+    connectionLimit: 10,
+    minimumIdle: 2,
+    idleTimeout: 300,           // s
+    acquireTimeout: 5000,       // ms
+    prepareCacheLength: 256,
+};
+
+function envInt(name, fallback) {
+    const value = Number.parseInt(process.env[name], 10);
+    return Number.isInteger(value) && value >= 0 ? value : fallback;
+}
+
+let pool = null;
+
+export function getPool() {
+    if (pool) return pool;
+    pool = mariadb.createPool({
+        host: process.env.DB_HOST,
+        user: process.env.DB_USER,
+        password: process.env.DB_PASS,
+        database: process.env.DB_NAME,
+        port: process.env.DB_PORT,
+        connectionLimit: envInt('DB_POOL_SIZE', POOL_DEFAULTS.connectionLimit),
+        minimumIdle: envInt('DB_POOL_MIN_IDLE', POOL_DEFAULTS.minimumIdle),
+        idleTimeout: envInt('DB_IDLE_TIMEOUT_S', POOL_DEFAULTS.idleTimeout),
+        acquireTimeout: envInt('DB_ACQUIRE_TIMEOUT_MS', POOL_DEFAULTS.acquireTimeout),
+        prepareCacheLength: envInt('DB_PREPARE_CACHE', POOL_DEFAULTS.prepareCacheLength),
+        minDelayValidation: 500,    // ms idle before a connection is pinged on borrow
+    });
+    pool.on('error', (error) => {
+        console.error('Database pool error:', error);
+    });
+    return pool;
+}
+
+// Pool occupancy and a round trip to the database, for GET /health
+export async function getDbHealth() {
+    const p = getPool();
+    const start = process.hrtime.bigint();
+    let ok = true;
+    let error;
+    try {
+        await p.query('SELECT 1');
+    } catch (err) {
+        ok = false;
+        error = err.message;
+    }
+    return {
+        ok,
+        error,
+        ping_ms: Number(process.hrtime.bigint() - start) / 1e6,
+        connections: {
+            total: p.totalConnections(),
+            active: p.activeConnections(),
+            idle: p.idleConnections(),
+            waiting: p.taskQueueSize(),
+        },
+    };
+}
+
+export async function closePool() {
+    if (!pool) return;
+    const p = pool;
+    pool = null;
+    await p.end();
+}
@@ -0,0 +1,111 @@
+const { getPool } = require('./db.js');
+
+// Who is in each facility right now, kept in memory instead of counted from the logs
+// on every dashboard refresh. The counts are per local day: one aggregate query over
+// today's scans seeds them at startup, after which every stored scan batch bumps
+// them (recordScans, called by the ingestion queue in scans.js). At midnight they
+// start again from zero, so a missed "out" never carries over to the next day.
+//
+// Capacities come from the facilities table and are re-read at most once per
+// CAPACITY_TTL_MS, so a new or resized facility shows up within that time.
+const CAPACITY_TTL_MS = 60 * 1000;
+
+let day = null;                 // local start of the day the counts belong to, ms
+const counts = new Map();       // facility_id -> { in, out }
+let facilities = [];
+let facilitiesAt = 0;
+
+function startOfDay(time) {
+    const date = new Date(time);
+    date.setHours(0, 0, 0, 0);
+    return date.getTime();
+}
+
+function rollOver(now) {
+    const today = startOfDay(now);
+    if (today !== day) {
+        counts.clear();
+        day = today;
+    }
+}
+
+function countsFor(facility_id) {
+    let c = counts.get(facility_id);
+    if (!c) {
+        c = { in: 0, out: 0 };
+        counts.set(facility_id, c);
+    }
+    return c;
+}
+
+export async function initOccupancy() {
+    const pool = getPool();
+    let conn;
+    try {
+        conn = await pool.getConnection();
+        const since = startOfDay(Date.now());
+        const rows = await conn.execute(
+            "SELECT facility_id, SUM(in_out = 'in') AS ins, SUM(in_out = 'out') AS outs FROM logs WHERE timestamp >= ? GROUP BY facility_id",
+            [since]);
+        counts.clear();
+        day = since;
+        for (const row of rows) {
+            const c = countsFor(Number(row.facility_id));
+            c.in = Number(row.ins);
+            c.out = Number(row.outs);
+        }
+    } catch (error) {
+        // Counting starts from the next scan instead; the numbers are low until tomorrow
+        console.error('Error seeding occupancy:', error);
+        day = startOfDay(Date.now());
+    } finally {
+        if (conn) conn.release();
+    }
+}
+
+// rows: [{ location_id, time, inout }] as written to the logs table
+export function recordScans(rows) {
+    rollOver(Date.now());
+    for (const row of rows) {
+        if (row.time < day || (row.inout !== 'in' && row.inout !== 'out')) continue;
+        countsFor(Number(row.location_id))[row.inout]++;
+    }
+}
+
+async function activeFacilities() {
+    if (Date.now() - facilitiesAt < CAPACITY_TTL_MS) return facilities;
+    const pool = getPool();
+    let conn;
+    try {
+        conn = await pool.getConnection();
+        facilities = await conn.execute("SELECT facilities_id, facility_type, capacity FROM facilities WHERE active = true");
+        facilitiesAt = Date.now();
+        return facilities;
+    } catch (error) {
+        console.error('Error retrieving facilities:', error);
+        throw new Error('Error retrieving occupancy');
+    } finally {
+        if (conn) conn.release();
+    }
+}
+
+export async function getOccupancy() {
+    const list = await activeFacilities();
+    rollOver(Date.now());
+    return list.map((facility) => {
+        const id = Number(facility.facilities_id);
+        const c = counts.get(id) || { in: 0, out: 0 };
+        const capacity = Number(facility.capacity);
+        const present = Math.max(0, c.in - c.out);
+        return {
+            facility_id: id,
+            facility_type: facility.facility_type,
+            capacity,
+            in: c.in,
+            out: c.out,
+            present,
+            full: present >= capacity,
+            over_capacity: present > capacity,
+        };
+    });
+}
@@ -0,0 +1,131 @@
+// Scan event stream
+//
+// Every scan the ingestion queue stores is fanned out to the dashboards listening on
+// GET /druppel/scans/stream (Server-Sent Events), so they see a tap as soon as it is
+// in the database instead of re-fetching the scan list.
+//
+// Each event is serialized once and shared by all clients. A client whose socket is
+// full gets its events queued, up to CLIENT_QUEUE_MAX; one that falls further behind
+// is disconnected rather than buffered without bound. The browser reconnects on its
+// own with the id of the last event it saw, and the events since then are replayed
+// from the last REPLAY_EVENTS; when it has missed more than that it is told to
+// re-fetch the list ('reset').
+//
+// Event ids are "<boot>:<seq>". The sequence starts over with every backend process,
+// so an id from another boot says nothing about what the client has seen and always
+// gets a reset.
+const crypto = require('crypto');
+
+const CLIENT_QUEUE_MAX = 256;
+const REPLAY_EVENTS = 1024;
+const MAX_CLIENTS = 200;
+const HEARTBEAT_MS = 15 * 1000;     // keeps idle connections open through proxies
+
+const clients = new Set();
+const replay = [];                  // { seq, facility_id, chunk }, oldest first
+const boot = crypto.randomBytes(4).toString('hex');
+let seq = 0;
+const stats = { published: 0, connects: 0, disconnected_slow: 0 };
+
+function send(client, chunk) {
+    if (client.queue.length > 0) {
+        if (client.queue.length >= CLIENT_QUEUE_MAX) {
+            stats.disconnected_slow++;
+            client.res.destroy();
+            return;
+        }
+        client.queue.push(chunk);
+        return;
+    }
+    if (!client.res.write(chunk)) {
+        // The chunk is with the socket; the next ones wait for 'drain'
+        client.queue.push(null);
+    }
+}
+
+function flush(client) {
+    // The head of the queue is the marker for the write that filled the socket
+    client.queue.shift();
+    while (client.queue.length > 0) {
+        const chunk = client.queue.shift();
+        if (!client.res.write(chunk)) {
+            client.queue.unshift(null);
+            return;
+        }
+    }
+}
+
+// rows: [{ id, keyfob_id, facility_id, timestamp, in_out }] as stored in the logs table
+export function publishScans(rows) {
+    for (const row of rows) {
+        seq++;
+        const event = { seq, facility_id: Number(row.facility_id), chunk: `id: ${boot}:${seq}\ndata: ${JSON.stringify(row)}\n\n` };
+        replay.push(event);
+        if (replay.length > REPLAY_EVENTS) replay.shift();
+        stats.published++;
+        for (const client of clients) {
+            if (client.facility == null || client.facility === event.facility_id) {
+                send(client, event.chunk);
+            }
+        }
+    }
+}
+
+// "<boot>:<seq>" as sent in the id field, or null when it is not one of ours
+function parseEventId(value) {
+    const match = /^([0-9a-f]+):(\d+)$/.exec(value || '');
+    return match ? { boot: match[1], seq: Number(match[2]) } : null;
+}
+
+// Takes over res for the lifetime of the connection. lastEventId is the browser's
+// Last-Event-ID header on a reconnect; facility narrows the stream to one location.
+export function subscribe(res, { lastEventId, facility }) {
+    if (clients.size >= MAX_CLIENTS) {
+        return res.status(503).json({ error: 'Too many scan stream clients' });
+    }
+    res.status(200).set({
+        'Content-Type': 'text/event-stream',
+        'Cache-Control': 'no-cache',
+        'Connection': 'keep-alive',
+        'X-Accel-Buffering': 'no',
+    });
+    res.flushHeaders();
+    res.socket?.setNoDelay(true);
+
+    const client = { res, facility, queue: [] };
+    res.write('retry: 2000\n\n');
+    const last = lastEventId == null ? null : parseEventId(lastEventId);
+    if (lastEventId != null && !(last && last.boot === boot && last.seq === seq)) {
+        if (!last || last.boot !== boot || last.seq > seq || replay.length === 0 || replay[0].seq > last.seq + 1) {
+            res.write(`id: ${boot}:${seq}\nevent: reset\ndata: {}\n\n`);
+        } else {
+            for (const event of replay) {
+                if (event.seq > last.seq && (facility == null || facility === event.facility_id)) {
+                    send(client, event.chunk);
+                }
+            }
+        }
+    }
+
+    const heartbeat = setInterval(() => send(client, ': ping\n\n'), HEARTBEAT_MS);
+    res.on('drain', () => flush(client));
+    res.on('close', () => {
+        clearInterval(heartbeat);
+        clients.delete(client);
+    });
+    clients.add(client);
+    stats.connects++;
+}
+
+// Streams never end on their own; server.close() waits for them
+export function closeScanStreams() {
+    for (const client of clients) {
+        client.res.end();
+    }
+}
+
+export function getScanEventStats() {
+    let queued = 0;
+    for (const client of clients) queued += client.queue.length;
+    return { clients: clients.size, boot, last_seq: seq, queued, ...stats };
+}
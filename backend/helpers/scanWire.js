@@ -0,0 +1,81 @@
+// Decoder for the binary scan batches scanners post to /druppel/scans/binary.
+// The layout is documented in scanner/main/scan_wire.h; keep the two in step.
+// Everything is little-endian and packed:
+//   header: u8 version, u8 count, i64 now_ms, u32 epoch, u8 device_len, device
+//   record: u8 uid_len, u8 flags, u8 reader, u16 facility_id, u32 seq, i64 timestamp_ms, uid
+const WIRE_VERSION = 2;
+const HEADER_LEN = 15;
+const RECORD_LEN = 17;
+const UID_MAX = 10;
+
+const FLAG_OUT = 0x01;
+const FLAG_UNIX_TIME = 0x02;
+const FLAG_DECIDED = 0x04;
+const FLAG_GRANTED = 0x08;
+
+// Same form as the JSON uploads ("AA:BB:CC:DD"), so both match keyfobs.keyfob_key
+function uidToKey(buf, start, len) {
+    const parts = [];
+    for (let i = 0; i < len; i++) {
+        parts.push(buf[start + i].toString(16).toUpperCase().padStart(2, '0'));
+    }
+    return parts.join(':');
+}
+
+// Returns { device, epoch, now, scans } with scans shaped like the JSON batch items; throws on a
+// malformed body
+export function decodeScanBatch(buf) {
+    if (!Buffer.isBuffer(buf) || buf.length < HEADER_LEN) {
+        throw new Error('Body shorter than the batch header');
+    }
+    const version = buf.readUInt8(0);
+    if (version !== WIRE_VERSION) {
+        throw new Error(`Unsupported batch version ${version}`);
+    }
+    const count = buf.readUInt8(1);
+    const now = Number(buf.readBigInt64LE(2));
+    const epoch = buf.readUInt32LE(10);
+    const deviceLen = buf.readUInt8(14);
+    let offset = HEADER_LEN + deviceLen;
+    if (offset > buf.length) {
+        throw new Error('Device name runs past the end of the body');
+    }
+    const device = buf.toString('utf8', HEADER_LEN, offset);
+
+    const scans = [];
+    for (let i = 0; i < count; i++) {
+        if (offset + RECORD_LEN > buf.length) {
+            throw new Error(`Scan ${i}: record runs past the end of the body`);
+        }
+        const uidLen = buf.readUInt8(offset);
+        const flags = buf.readUInt8(offset + 1);
+        const reader = buf.readUInt8(offset + 2);
+        const locationId = buf.readUInt16LE(offset + 3);
+        const seq = buf.readUInt32LE(offset + 5);
+        const timestamp = Number(buf.readBigInt64LE(offset + 9));
+        offset += RECORD_LEN;
+        if (uidLen === 0 || uidLen > UID_MAX) {
+            throw new Error(`Scan ${i}: invalid UID length ${uidLen}`);
+        }
+        if (offset + uidLen > buf.length) {
+            throw new Error(`Scan ${i}: UID runs past the end of the body`);
+        }
+
+        const scan = {
+            keyfob_key: uidToKey(buf, offset, uidLen),
+            location_id: locationId,
+            inout: flags & FLAG_OUT ? 'out' : 'in',
+            seq,
+            reader,
+        };
+        if (flags & FLAG_UNIX_TIME) scan.time = timestamp;
+        else scan.timestamp = timestamp;
+        if (flags & FLAG_DECIDED) scan.granted = (flags & FLAG_GRANTED) !== 0;
+        scans.push(scan);
+        offset += uidLen;
+    }
+    if (offset !== buf.length) {
+        throw new Error(`${buf.length - offset} trailing bytes after ${count} scans`);
+    }
+    return { device, epoch, now, scans };
+}
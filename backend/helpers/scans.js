@@ -1,123 +1,379 @@
-const mariadb = require('mariadb');
-const dotenv = require('dotenv').config({quiet: true});
-
-var vpool = {
-        host: process.env.DB_HOST,
-        user: process.env.DB_USER,
-        password: process.env.DB_PASS,
-        database: process.env.DB_NAME,
-        port: process.env.DB_PORT,
+const { getPool } = require('./db.js');
+const { recordScans } = require('./occupancy.js');
+const { publishScans } = require('./scanEvents.js');
+
+// Scan ingestion
+//
+// Scanners post at the same moment when several gates fire. Rows that arrive while
+// an insert is running wait for it and then go to the database together: one keyfob
+// lookup and one multi-row insert per round, however many requests are in it. With
+// nothing in flight a request is written straight away, so an idle backend adds no
+// delay. A round whose insert fails is retried request by request, so one bad batch
+// cannot fail the scans of another scanner that happened to share its round. Once the
+// insert is committed nothing is retried: occupancy and the event stream are updated
+// after it, and a failure there must not store the rows a second time.
+const INGEST_MAX_ROWS = 500;
+
+// rows: [{ keyfob_id } or { keyfob_key }, plus location_id, time, inout, and upload:
+// { device, epoch, seq } for scans a scanner may send again]
+const ingestQueue = [];
+let ingestRunning = false;
+
+// Round durations for GET /health, newest last
+const INGEST_SAMPLES = 1024;
+const ingestStats = { requests: 0, rows: 0, rounds: 0, max_round_rows: 0, round_ms: [] };
+
+// IN lists are padded to a power of two, so the prepared statement cache holds a
+// handful of shapes instead of one per list length
+function inList(values) {
+    const padded = values.length > 0 ? [...values] : [null];
+    let size = 1;
+    while (size < padded.length) size *= 2;
+    while (padded.length < size) padded.push(padded[0]);
+    return { sql: padded.map(() => '?').join(', '), params: padded };
 }
 
-export async function logScan(tag_id, location_id, time, inout) {
-    const pool = mariadb.createPool(vpool);
+// Scanners may send a batch again that was already stored: the journal replays
+// everything past the position it last saved, and a lost response looks like a failed
+// request. Per device the highest sequence number stored is kept together with the
+// epoch it was counted in (one journal, or one boot without it); numbers from another
+// epoch are not comparable and are never dropped. The positions are read with FOR
+// UPDATE and written in the same transaction as the scans, so a resend that overlaps
+// the first attempt waits for it and then sees its scans as repeats.
+//
+// Returns per row whether it repeats a scan already stored.
+async function claimUploads(conn, rows) {
+    const repeat = rows.map(() => false);
+    const devices = [...new Set(rows.filter((row) => row.upload).map((row) => row.upload.device))];
+    if (devices.length === 0) return repeat;
+
+    const list = inList(devices);
+    const marks = new Map();
+    const found = await conn.execute(
+        `SELECT device, epoch, last_seq FROM scanner_uploads WHERE device IN (${list.sql}) FOR UPDATE`, list.params);
+    for (const mark of found) {
+        marks.set(mark.device, { epoch: Number(mark.epoch), last_seq: Number(mark.last_seq) });
+    }
+
+    const changed = new Map();
+    rows.forEach((row, i) => {
+        if (!row.upload) return;
+        const { device, epoch, seq } = row.upload;
+        const mark = marks.get(device);
+        if (mark && mark.epoch === epoch && seq <= mark.last_seq) {
+            repeat[i] = true;
+            return;
+        }
+        const next = { epoch, last_seq: mark && mark.epoch === epoch ? Math.max(mark.last_seq, seq) : seq };
+        marks.set(device, next);
+        changed.set(device, next);
+    });
+    if (changed.size > 0) {
+        await conn.batch(
+            "INSERT INTO scanner_uploads (device, epoch, last_seq) VALUES (?, ?, ?) ON DUPLICATE KEY UPDATE epoch = VALUES(epoch), last_seq = VALUES(last_seq)",
+            [...changed].map(([device, mark]) => [device, mark.epoch, mark.last_seq]));
+    }
+    return repeat;
+}
+
+// Returns per row whether it was stored or repeats an earlier upload, and the stored
+// rows as the logs table has them; rows whose keyfob is unknown are skipped
+async function insertScanRows(rows) {
+    const pool = getPool();
     let conn;
     try {
         conn = await pool.getConnection();
-        const result = await conn.query("INSERT INTO logs (keyfob_id, facility_id, timestamp, in_out) VALUES (?, ?, ?, ?)", [tag_id, location_id, time, inout]);
-        return result;
+        await conn.beginTransaction();
+        const repeat = await claimUploads(conn, rows);
+        const ids = inList([...new Set(rows.filter((row) => row.keyfob_id != null).map((row) => row.keyfob_id))]);
+        const keys = inList([...new Set(rows.filter((row) => row.keyfob_id == null).map((row) => row.keyfob_key))]);
+        const found = await conn.execute(
+            `SELECT keyfob_id, keyfob_key FROM keyfobs WHERE keyfob_id IN (${ids.sql}) OR keyfob_key IN (${keys.sql})`,
+            [...ids.params, ...keys.params]
+        );
+        const knownIds = new Set();
+        const idByKey = new Map();
+        for (const keyfob of found) {
+            knownIds.add(Number(keyfob.keyfob_id));
+            idByKey.set(keyfob.keyfob_key, keyfob.keyfob_id);
+        }
+
+        const values = [];
+        let inserted = [];
+        const stored = rows.map((row, i) => {
+            if (repeat[i]) return false;
+            const id = row.keyfob_id != null ? (knownIds.has(Number(row.keyfob_id)) ? row.keyfob_id : null) : idByKey.get(row.keyfob_key);
+            if (id == null) return false;
+            values.push([id, row.location_id, row.time, row.inout]);
+            return true;
+        });
+        if (values.length > 0) {
+            // fullResult gives the insert id of every row, for the event stream
+            const results = await conn.batch({ sql: "INSERT INTO logs (keyfob_id, facility_id, timestamp, in_out) VALUES (?, ?, ?, ?)", fullResult: true }, values);
+            inserted = values.map(([keyfob_id, facility_id, timestamp, in_out], i) => ({
+                id: Number(results[i].insertId), keyfob_id: Number(keyfob_id), facility_id: Number(facility_id), timestamp, in_out,
+            }));
+        }
+        await conn.commit();
+        return { stored, repeat, inserted };
+    } catch (error) {
+        if (conn) await conn.rollback().catch(() => {});
+        throw error;
+    } finally {
+        if (conn) conn.release();
+    }
+}
+
+async function writeRound(round) {
+    const rows = round.flatMap((request) => request.rows);
+    const start = performance.now();
+    let result;
+    try {
+        result = await insertScanRows(rows);
+    } catch (error) {
+        if (round.length === 1) {
+            round[0].reject(error);
+            return;
+        }
+        for (const request of round) {
+            await writeRound([request]);
+        }
+        return;
+    }
+    ingestStats.rounds++;
+    ingestStats.rows += rows.length;
+    ingestStats.max_round_rows = Math.max(ingestStats.max_round_rows, rows.length);
+    ingestStats.round_ms.push(performance.now() - start);
+    if (ingestStats.round_ms.length > INGEST_SAMPLES) ingestStats.round_ms.shift();
+
+    try {
+        recordScans(result.inserted.map((row) => ({ location_id: row.facility_id, time: row.timestamp, inout: row.in_out })));
+        publishScans(result.inserted);
+    } catch (error) {
+        console.error('Error announcing stored scans:', error);
+    }
+
+    let offset = 0;
+    for (const request of round) {
+        const end = offset + request.rows.length;
+        const logged = result.stored.slice(offset, end).filter(Boolean).length;
+        const repeats = result.repeat.slice(offset, end).filter(Boolean).length;
+        offset = end;
+        request.resolve({ affectedRows: logged, repeats });
+    }
+}
+
+async function drainIngest() {
+    ingestRunning = true;
+    while (ingestQueue.length > 0) {
+        const round = [];
+        let count = 0;
+        while (ingestQueue.length > 0 && (round.length === 0 || count + ingestQueue[0].rows.length <= INGEST_MAX_ROWS)) {
+            const request = ingestQueue.shift();
+            round.push(request);
+            count += request.rows.length;
+        }
+        await writeRound(round);
+    }
+    ingestRunning = false;
+}
+
+function ingestScans(rows) {
+    ingestStats.requests++;
+    return new Promise((resolve, reject) => {
+        ingestQueue.push({ rows, resolve, reject });
+        if (!ingestRunning) drainIngest();
+    });
+}
+
+export function getIngestStats() {
+    const sorted = [...ingestStats.round_ms].sort((a, b) => a - b);
+    const at = (q) => sorted.length > 0 ? sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * q))] : null;
+    return {
+        requests: ingestStats.requests,
+        rows: ingestStats.rows,
+        rounds: ingestStats.rounds,
+        rows_per_round: ingestStats.rounds > 0 ? ingestStats.rows / ingestStats.rounds : 0,
+        max_round_rows: ingestStats.max_round_rows,
+        queued: ingestQueue.reduce((sum, request) => sum + request.rows.length, 0),
+        round_ms: { p50: at(0.5), p99: at(0.99), max: sorted.length > 0 ? sorted[sorted.length - 1] : null },
+    };
+}
+
+export async function logScan(tag_id, location_id, time, inout) {
+    try {
+        return await ingestScans([{ keyfob_id: tag_id, location_id, time, inout }]);
     } catch (error) {
         console.error('Error logging scan:', error);
         throw new Error('Error logging scan');
+    }
+}
+
+// scans: [{ keyfob_key, location_id, time, inout, seq }]; scans for unknown keyfobs are
+// skipped. With upload ({ device, epoch }) scans whose seq was stored before are too.
+export async function logScanBatch(scans, upload) {
+    try {
+        return await ingestScans(scans.map((scan) => ({
+            keyfob_key: scan.keyfob_key,
+            location_id: scan.location_id,
+            time: scan.time,
+            inout: scan.inout,
+            upload: upload && Number.isInteger(scan.seq) ? { ...upload, seq: scan.seq } : null,
+        })));
+    } catch (error) {
+        console.error('Error logging scan batch:', error);
+        throw new Error('Error logging scan batch');
+    }
+}
+
+// Created at startup when missing. The scan log only grows, so it is read newest
+// first through the indexes, never whole.
+const SCAN_SCHEMA = [
+    `CREATE TABLE IF NOT EXISTS scanner_uploads (
+        device VARCHAR(255) NOT NULL PRIMARY KEY,
+        epoch INT UNSIGNED NOT NULL,
+        last_seq INT UNSIGNED NOT NULL
+    )`,
+    "CREATE INDEX IF NOT EXISTS logs_timestamp_id ON logs (timestamp, id)",
+    "CREATE INDEX IF NOT EXISTS logs_facility_timestamp_id ON logs (facility_id, timestamp, id)",
+    "CREATE INDEX IF NOT EXISTS keyfobs_keyfob_key ON keyfobs (keyfob_key)",
+];
+
+export async function ensureScanSchema() {
+    const pool = getPool();
+    let conn;
+    try {
+        conn = await pool.getConnection();
+        for (const sql of SCAN_SCHEMA) {
+            await conn.query(sql);
+        }
+    } catch (error) {
+        console.error('Error creating scan tables and indexes:', error);
     } finally {
         if (conn) conn.release();
-        await pool.end();
     }
 }
 
-export async function getScans() {
-    const pool = mariadb.createPool(vpool);
+// One page of scans, newest first, yielded as the database sends them. 'before' is
+// the { timestamp, id } of the last scan of the previous page; 'from' and 'to' bound
+// the timestamp (from inclusive, to exclusive); 'facility' narrows to one location.
+export async function* streamScans({ limit, before, from, to, facility }) {
+    const where = [];
+    const params = [];
+    if (before) {
+        where.push("(timestamp < ? OR (timestamp = ? AND id < ?))");
+        params.push(before.timestamp, before.timestamp, before.id);
+    }
+    if (from != null) {
+        where.push("timestamp >= ?");
+        params.push(from);
+    }
+    if (to != null) {
+        where.push("timestamp < ?");
+        params.push(to);
+    }
+    if (facility != null) {
+        where.push("facility_id = ?");
+        params.push(facility);
+    }
+    params.push(limit);
+    const sql = `SELECT id, keyfob_id, facility_id, timestamp, in_out FROM logs
+        ${where.length > 0 ? 'WHERE ' + where.join(' AND ') : ''}
+        ORDER BY timestamp DESC, id DESC LIMIT ?`;
+
+    const pool = getPool();
     let conn;
+    let stream;
+    let done = false;
     try {
         conn = await pool.getConnection();
-        const rows = await conn.query("SELECT * FROM logs");
-        return rows;
+        stream = conn.queryStream(sql, params);
+        for await (const row of stream) {
+            yield row;
+        }
+        done = true;
     } catch (error) {
         console.error('Error retrieving scans:', error);
         throw new Error('Error retrieving scans');
     } finally {
+        // A reader that stopped early leaves rows on the wire; drain them before reuse
+        if (stream && !done) stream.close();
         if (conn) conn.release();
-        await pool.end();
     }
 }
 
 export async function attachUserToKeyfob(user_id, keyfob_id) {
-    const pool = mariadb.createPool(vpool);
+    const pool = getPool();
     let conn;
     try {
         conn = await pool.getConnection();
-        const result = await conn.query("UPDATE keyfobs SET attached_user_id = ? WHERE keyfob_id = ?", [user_id, keyfob_id]);
+        const result = await conn.execute("UPDATE keyfobs SET attached_user_id = ? WHERE keyfob_id = ?", [user_id, keyfob_id]);
         return result;
     } catch (error) {
         console.error('Error attaching user to keyfob:', error);
         throw new Error('Error attaching user to keyfob');
     } finally {
         if (conn) conn.release();
-        await pool.end();
     }
 }
 
 export async function detachUserFromKeyfob(keyfob_id) {
-    const pool = mariadb.createPool(vpool);
+    const pool = getPool();
     let conn;
     try {
         conn = await pool.getConnection();
-        const result = await conn.query("UPDATE keyfobs SET attached_user_id = NULL WHERE keyfob_id = ?", [keyfob_id]);
+        const result = await conn.execute("UPDATE keyfobs SET attached_user_id = NULL WHERE keyfob_id = ?", [keyfob_id]);
         return result;
     } catch (error) {
         console.error('Error detaching user from keyfob:', error);
         throw new Error('Error detaching user from keyfob');
     } finally {
         if (conn) conn.release();
-        await pool.end();
     }
 }
 
 export async function setKeyfobKey(keyfob_id, new_key) {
-    const pool = mariadb.createPool(vpool);
+    const pool = getPool();
     let conn;
     try {
         conn = await pool.getConnection();
-        const result = await conn.query("UPDATE keyfobs SET keyfob_key = ? WHERE keyfob_id = ?", [new_key, keyfob_id]);
+        const result = await conn.execute("UPDATE keyfobs SET keyfob_key = ? WHERE keyfob_id = ?", [new_key, keyfob_id]);
         return result;
     } catch (error) {
         console.error('Error setting keyfob key:', error);
         throw new Error('Error setting keyfob key');
     } finally {
         if (conn) conn.release();
-        await pool.end();
     }
 }
 
 export async function getKeyfobs() {
-    const pool = mariadb.createPool(vpool);
+    const pool = getPool();
     let conn;
     try {
         conn = await pool.getConnection();
-        const rows = await conn.query("SELECT * FROM keyfobs WHERE buitengebruik = 0");
+        const rows = await conn.execute("SELECT * FROM keyfobs WHERE buitengebruik = 0");
         return rows;
     } catch (error) {
         console.error('Error retrieving keyfobs:', error);
         throw new Error('Error retrieving keyfobs');
     } finally {
         if (conn) conn.release();
-        await pool.end();
     }
 }
 
 // initialize new keyfob before linking to individual person
 export async function initNewKeyfob(keyfob_key) {
-    const pool = mariadb.createPool(vpool);
+    const pool = getPool();
     let conn;
     try {
         conn = await pool.getConnection();
-        const result = await conn.query("INSERT INTO keyfobs (keyfob_key) VALUES (?)", keyfob_key);
+        const result = await conn.execute("INSERT INTO keyfobs (keyfob_key) VALUES (?)", [keyfob_key]);
         return result;
     } catch (error) {
         console.error('Error initializing keyfob: ', error)
         throw new Error('Error initializing keyfob')
     } finally {
         if (conn) {conn.release();}
-        await pool.end();
     }
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+// Latest telemetry snapshot per scanner, as pushed to /druppel/telemetry.
+// The push format is built by telemetry_render_push() in scanner/main/telemetry.c;
+// the counter and gauge order follows telemetry.h, keep the two in step.
+const COUNTERS = ['scans', 'scans_suppressed', 'http_requests', 'http_failures', 'wifi_disconnects', 'wifi_reconnects', 'telemetry_pushes', 'spi_clock_fallbacks', 'probes', 'field_on_ms', 'auth_failures'];
+const GAUGES = ['queue_depth', 'queue_high_water', 'queue_dropped', 'journal_pending', 'heap_min_free', 'heap_largest_free'];
+const MAX_DEVICES = 256;
+
+const snapshots = new Map();
+
+// Upper bound of the bucket holding quantile q, or null when it falls in +Inf
+function quantile(le, counts, total, q) {
+    const rank = Math.ceil(total * q);
+    let cumulative = 0;
+    for (let i = 0; i < counts.length; i++) {
+        cumulative += counts[i];
+        if (cumulative >= rank) return i < le.length ? le[i] : null;
+    }
+    return null;
+}
+
+function summarizeHistogram(hist) {
+    return hist.readers.map((counts, reader) => {
+        const total = counts.reduce((sum, n) => sum + n, 0);
+        if (total === 0) return null;
+        return {
+            reader,
+            count: total,
+            p50: quantile(hist.le, counts, total, 0.5),
+            p95: quantile(hist.le, counts, total, 0.95),
+            buckets: counts,
+        };
+    }).filter((series) => series !== null);
+}
+
+function isCountArray(value, length) {
+    return Array.isArray(value) && (length == null || value.length === length) &&
+        value.every((n) => Number.isInteger(n) && n >= 0);
+}
+
+// Validates and stores a push; throws on a malformed body
+export function storeTelemetry(body) {
+    const { device, uptime, counters, gauges, hist } = body || {};
+    if (typeof device !== 'string' || device.length === 0 || device.length > 64) {
+        throw new Error("'device' must be a non-empty string");
+    }
+    if (!Number.isInteger(uptime) || !isCountArray(counters) || !isCountArray(gauges)) {
+        throw new Error("'uptime', 'counters' and 'gauges' must be non-negative integers");
+    }
+    if (!hist || typeof hist !== 'object') {
+        throw new Error("'hist' must be an object");
+    }
+
+    const histograms = {};
+    for (const [name, value] of Object.entries(hist)) {
+        if (!value || !isCountArray(value.le) || !Array.isArray(value.readers)) {
+            throw new Error(`Histogram '${name}' needs 'le' and 'readers' arrays`);
+        }
+        for (const counts of value.readers) {
+            if (counts.length > 0 && !isCountArray(counts, value.le.length + 1)) {
+                throw new Error(`Histogram '${name}': each reader needs ${value.le.length + 1} bucket counts`);
+            }
+        }
+        histograms[name] = summarizeHistogram(value);
+    }
+
+    // Counters and gauges a newer firmware adds are kept under their index
+    const named = (names, values) => Object.fromEntries(values.map((n, i) => [names[i] ?? String(i), n]));
+    // Re-inserting keeps the Map in push order, so the quietest scanner goes first
+    snapshots.delete(device);
+    if (snapshots.size >= MAX_DEVICES) {
+        snapshots.delete(snapshots.keys().next().value);
+    }
+    snapshots.set(device, {
+        device,
+        received: Date.now(),
+        uptime,
+        counters: named(COUNTERS, counters),
+        gauges: named(GAUGES, gauges),
+        histograms,
+    });
+}
+
+export function getTelemetry(device) {
+    if (device != null) {
+        const snapshot = snapshots.get(device);
+        return snapshot ? [snapshot] : [];
+    }
+    return [...snapshots.values()];
+}
@@ -23,6 +23,17 @@ app.get('/', (req, res) => {
     res.status(200).json({ message: 'OK' });
 });
 
+// Database pool and scan ingestion, for load tests and monitoring
+const { getDbHealth, closePool } = require('./helpers/db.js');
+const { getIngestStats, ensureScanSchema } = require('./helpers/scans.js');
+const { initOccupancy } = require('./helpers/occupancy.js');
+const { getScanEventStats, closeScanStreams } = require('./helpers/scanEvents.js');
+
+app.get('/health', async (req, res) => {
+    const db = await getDbHealth();
+    res.status(db.ok ? 200 : 503).json({ db, ingest: getIngestStats(), events: getScanEventStats() });
+});
+
 const adminRoute = require('./routes/adminRoute');
 const authRoute = require('./routes/authRoute');
 const druppelRoute = require('./routes/druppelRoute');
@@ -40,6 +51,22 @@ app.use((req, res) => {
 
 const port = process.env.PORT;
 
-app.listen(port, () => {
-    console.log(`Server listening on port ${port}`);
+// Occupancy is counted from here on, so seed it before the first scan can arrive
+let server;
+ensureScanSchema()
+    .then(() => initOccupancy())
+    .then(() => {
+        server = app.listen(port, () => {
+            console.log(`Server listening on port ${port}`);
+        });
+    });
+
+// Let requests in flight finish, then close the pool's connections
+process.on('SIGTERM', async () => {
+    if (server) {
+        closeScanStreams();
+        await new Promise((resolve) => server.close(resolve));
+    }
+    await closePool();
+    process.exit(0);
 });
@@ -1,7 +1,11 @@
 const express = require('express');
 const router = express.Router();
-const { logScan, getScans, attachUserToKeyfob, detachUserFromKeyfob, getKeyfobs, setKeyfobKey, initNewKeyfob } = require('../helpers/scans.js');
+const { logScan, logScanBatch, streamScans, attachUserToKeyfob, detachUserFromKeyfob, getKeyfobs, setKeyfobKey, initNewKeyfob } = require('../helpers/scans.js');
+const { getAllowlistDelta } = require('../helpers/allowlist.js');
+const { decodeScanBatch } = require('../helpers/scanWire.js');
+const { storeTelemetry, getTelemetry } = require('../helpers/telemetry.js');
 const { toSerializable } = require('../helpers/serializable.js');
+const { subscribe } = require('../helpers/scanEvents.js');
 
 router.post('/scans', async (req, res) => {
     if (!req.body || Object.keys(req.body).length === 0) {
@@ -33,6 +37,9 @@ router.post('/scans', async (req, res) => {
     
     try {
         let result = await logScan(tag_id, location_id, time, inout);
+        if (result.affectedRows === 0) {
+            return res.status(400).json({ error: 'Failed to log scan', details: `Unknown keyfob ${tag_id}` });
+        }
         const safeResult = toSerializable(result);
         return res.status(201).json({ message: 'Scan logged successfully', result: safeResult });
     } catch (error) {
@@ -40,14 +47,173 @@ router.post('/scans', async (req, res) => {
     }
 });
 
-router.get('/scans', async (req, res) => {
+// Scanner uploads: several taps in one request
+const MAX_BATCH_SIZE = 100;
+
+// Shared by the JSON and binary uploads once the batch is validated
+async function storeScanBatch(res, device, epoch, now, scans) {
+    // 'time' is Unix ms from a scanner with a synced clock. Otherwise 'timestamp' is its
+    // uptime and 'now' the uptime at send, so the offset gives the tap time
+    const received = Date.now();
+    const toTime = (scan) => {
+        if (typeof scan.time === 'number') return scan.time;
+        if (typeof now === 'number' && typeof scan.timestamp === 'number' && scan.timestamp <= now) {
+            return received - (now - scan.timestamp);
+        }
+        return received;
+    };
+    // Repeats are recognised by sequence number within the scanner's epoch, in the same
+    // transaction as the insert; batches without one (older firmware) are stored as
+    // they come
+    const tracked = typeof device === 'string' && device.length > 0 && device.length <= 255 &&
+        Number.isInteger(epoch) && epoch > 0 && epoch <= 0xFFFFFFFF;
+    const rows = scans.map((scan) => ({
+        keyfob_key: scan.keyfob_key,
+        location_id: scan.location_id,
+        inout: scan.inout,
+        time: toTime(scan),
+        seq: scan.seq,
+    }));
+
     try {
-        let result = await getScans();
+        let result = await logScanBatch(rows, tracked ? { device, epoch } : null);
+        if (result.repeats === scans.length) {
+            return res.status(200).json({ message: 'Scans already logged', received: scans.length, logged: 0 });
+        }
         const safeResult = toSerializable(result);
-        return res.status(200).json({ scans: safeResult });
+        return res.status(201).json({ message: 'Scans logged successfully', received: scans.length, logged: safeResult.affectedRows });
+    } catch (error) {
+        return res.status(500).json({ error: 'Failed to log scans', details: error.message });
+    }
+}
+
+router.post('/scans/batch', async (req, res) => {
+    let { scans, now, device, epoch } = req.body || {};
+    if (!Array.isArray(scans) || scans.length === 0) {
+        return res.status(400).json({ error: "'scans' must be a non-empty array" });
+    }
+    if (scans.length > MAX_BATCH_SIZE) {
+        return res.status(400).json({ error: `A batch holds at most ${MAX_BATCH_SIZE} scans` });
+    }
+
+    for (const [index, scan] of scans.entries()) {
+        const { keyfob_key, location_id, inout } = scan || {};
+        if (typeof keyfob_key !== 'string' || typeof location_id !== 'number') {
+            return res.status(400).json({ error: `Scan ${index}: 'keyfob_key' must be a string and 'location_id' a number` });
+        }
+        if (inout !== 'in' && inout !== 'out') {
+            return res.status(400).json({ error: `Scan ${index}: invalid value for 'inout'. Must be 'in' or 'out'.` });
+        }
+    }
+
+    return storeScanBatch(res, device, epoch, now, scans);
+});
+
+// Same batch as /scans/batch in the compact encoding of helpers/scanWire.js
+router.post('/scans/binary', express.raw({ type: 'application/octet-stream', limit: '16kb' }), async (req, res) => {
+    if (!Buffer.isBuffer(req.body) || req.body.length === 0) {
+        return res.status(400).json({ error: "Body must be 'application/octet-stream'" });
+    }
+
+    let batch;
+    try {
+        batch = decodeScanBatch(req.body);
+    } catch (error) {
+        return res.status(400).json({ error: 'Invalid scan batch', details: error.message });
+    }
+    if (batch.scans.length === 0) {
+        return res.status(400).json({ error: 'Batch holds no scans' });
+    }
+    if (batch.scans.length > MAX_BATCH_SIZE) {
+        return res.status(400).json({ error: `A batch holds at most ${MAX_BATCH_SIZE} scans` });
+    }
+
+    return storeScanBatch(res, batch.device, batch.epoch, batch.now, batch.scans);
+});
+
+// Scans newest first, one page at a time. The response carries a 'next' cursor
+// (timestamp:id of the last scan) to pass back as 'before' for the page after it,
+// or null on the last page. Rows are written out as the database sends them, and
+// the query pauses while the client is slow to read.
+const SCANS_PAGE_DEFAULT = 100;
+const SCANS_PAGE_MAX = 5000;
+
+function parseCursor(value) {
+    const match = /^(\d+):(\d+)$/.exec(value);
+    return match ? { timestamp: Number(match[1]), id: Number(match[2]) } : null;
+}
+
+function optionalInt(value) {
+    if (value === undefined) return null;
+    return /^\d+$/.test(value) ? Number(value) : undefined;
+}
+
+function drained(res) {
+    return new Promise((resolve) => {
+        const done = () => {
+            res.off('drain', done);
+            res.off('close', done);
+            resolve();
+        };
+        res.on('drain', done);
+        res.on('close', done);
+    });
+}
+
+router.get('/scans', async (req, res) => {
+    const limit = req.query.limit === undefined ? SCANS_PAGE_DEFAULT : optionalInt(req.query.limit);
+    const from = optionalInt(req.query.from);
+    const to = optionalInt(req.query.to);
+    const facility = optionalInt(req.query.facility);
+    const before = req.query.before === undefined ? null : parseCursor(req.query.before);
+    if (limit === undefined || limit < 1 || limit > SCANS_PAGE_MAX) {
+        return res.status(400).json({ error: `limit must be between 1 and ${SCANS_PAGE_MAX}` });
+    }
+    if (from === undefined || to === undefined || facility === undefined || before === undefined) {
+        return res.status(400).json({ error: 'from, to and facility must be integers, before a cursor from a previous page' });
+    }
+
+    // Nothing is sent until the first row (or the end) arrives, so a failing query
+    // still gets a proper error response
+    const rows = streamScans({ limit, before, from, to, facility });
+    let next;
+    try {
+        next = await rows.next();
     } catch (error) {
         return res.status(500).json({ error: 'Failed to retrieve scans', details: error.message });
     }
+
+    res.status(200).type('application/json');
+    res.write('{"scans":[');
+    let count = 0;
+    let last = null;
+    try {
+        while (!next.done) {
+            last = next.value;
+            if (!res.write((count++ > 0 ? ',' : '') + JSON.stringify(toSerializable(last)))) {
+                await drained(res);
+            }
+            if (res.destroyed) {
+                await rows.return();
+                return;
+            }
+            next = await rows.next();
+        }
+    } catch (error) {
+        // Headers are gone; cut the response short so the client sees it failed
+        return res.destroy(error);
+    }
+    const cursor = count === limit ? `${last.timestamp}:${last.id}` : null;
+    res.end(`],"next":${JSON.stringify(cursor)}}`);
+});
+
+// Scans as they are stored, as Server-Sent Events; see helpers/scanEvents.js
+router.get('/scans/stream', (req, res) => {
+    const facility = optionalInt(req.query.facility);
+    if (facility === undefined) {
+        return res.status(400).json({ error: 'facility must be an integer' });
+    }
+    subscribe(res, { lastEventId: req.get('Last-Event-ID') ?? null, facility });
 });
 
 router.put('/attach-user', async (req, res) => {
@@ -138,6 +304,30 @@ router.get('/keyfobs', async (req, res) => {
     }
 });
 
+// Scanners keep a local copy of the active keyfobs and ask for what changed since their version
+router.get('/allowlist', async (req, res) => {
+    try {
+        let result = await getAllowlistDelta(req.query.since, req.query.epoch);
+        return res.status(200).json(result);
+    } catch (error) {
+        return res.status(500).json({ error: 'Failed to retrieve allowlist', details: error.message });
+    }
+});
+
+// Scanners push a snapshot of their counters and latency histograms every few minutes
+router.post('/telemetry', async (req, res) => {
+    try {
+        storeTelemetry(req.body);
+    } catch (error) {
+        return res.status(400).json({ error: 'Invalid telemetry', details: error.message });
+    }
+    return res.status(204).end();
+});
+
+router.get('/telemetry', async (req, res) => {
+    return res.status(200).json({ scanners: getTelemetry(req.query.device) });
+});
+
 router.put('/init-keyfob', async (req, res) => {
     try {
         if (!req.body || Object.keys(req.body).length === 0) {
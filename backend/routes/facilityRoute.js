@@ -2,6 +2,7 @@ const express = require('express');
 const router = express.Router();
 const { toSerializable } = require('../helpers/serializable.js');
 const { createFacility, getFacilities, deleteFacility } = require('../helpers/facility.js');
+const { getOccupancy } = require('../helpers/occupancy.js');
 
 router.put('/create-facility', async (req, res) => {
     if (!req.body || Object.keys(req.body).length === 0) {
@@ -41,6 +42,15 @@ router.get('/facilities', async (req, res) => {
     }
 });
 
+router.get('/occupancy', async (req, res) => {
+    try {
+        let result = await getOccupancy();
+        return res.status(200).json({ occupancy: result });
+    } catch (err) {
+        return res.status(500).json({ error: err.message || 'Internal Server Error' });
+    }
+});
+
 router.delete('/delete-facility/:id', async (req, res) => {
     const facilityId = req.params.id;
     if (!facilityId) {
@@ -0,0 +1,257 @@
+// Driver benchmark against the simulated RC522
+//
+// Runs detection plus a full scan (anticollision, select, halt for every tag) over
+// a set of tag populations, with the completion polled and with the IRQ line, and
+// reports per-scan SPI transactions, bytes, simulated bus time, simulated total time
+// (bus plus air time) and host wall time. Exits non-zero when a scan does not
+// return exactly the tags in the field. The "auth" scenarios also unlock and read
+// one protected block of every tag while it is selected, MIFARE Classic with
+// MFAuthent and NTAG with PWD_AUTH, as the scanner's authenticated mode does.
+//
+// With -c the simulated link corrupts reads above clean_hz, and each reader is
+// calibrated with rc522_spi_calibrate() before the run, as the scanner does at boot.
+//
+//   rc522_bench [-n iterations] [-s spi_hz] [-c clean_hz]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rc522.h"
+#include "rc522_sim.h"
+
+#define BENCH_DEFAULT_ITERATIONS  200
+#define BENCH_DEFAULT_SPI_HZ      500000
+#define BENCH_FRAME_OVERHEAD_NS   12000   // polled ESP32 transaction, measured on a board
+#define BENCH_CALL_OVERHEAD_NS    2000
+#define BENCH_CHECK_ROUNDS        5
+#define BENCH_AUTH_ADDR           4       // Classic sector 1 block 0, NTAG pages 4-7
+
+static const rc522_tag_key_t bench_key = {
+    .mf_key = {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5},
+    .ntag_pwd = {0x12, 0x34, 0x56, 0x78},
+    .ntag_pack = {0xBE, 0xEF},
+};
+
+// Same steps as the scanner's spi_tune.c
+static const uint32_t bench_rates[] = {500000, 1000000, 2000000, 4000000, 5000000, 8000000, 10000000};
+
+typedef struct {
+    uint8_t uid[10];
+    uint8_t len;
+    uint8_t sak;
+} bench_tag_t;
+
+typedef struct {
+    const char *name;
+    int count;
+    bench_tag_t tags[4];
+    bool auth;                  // read BENCH_AUTH_ADDR behind bench_key on every tag
+} bench_scenario_t;
+
+static const bench_scenario_t scenarios[] = {
+    {"single 4-byte", 1, {
+        {{0xDE, 0xAD, 0xBE, 0xEF}, 4, 0x08},
+    }, false},
+    {"single 7-byte", 1, {
+        {{0x04, 0x52, 0x19, 0xA2, 0x6B, 0x51, 0x80}, 7, 0x00},
+    }, false},
+    {"single 10-byte", 1, {
+        {{0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA}, 10, 0x20},
+    }, false},
+    {"two 4-byte", 2, {
+        {{0x12, 0x34, 0x56, 0x78}, 4, 0x08},
+        {{0x12, 0x34, 0xD6, 0x01}, 4, 0x08},
+    }, false},
+    {"three 7-byte", 3, {
+        {{0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66}, 7, 0x00},
+        {{0x04, 0x11, 0x22, 0x3A, 0x44, 0x55, 0x66}, 7, 0x00},
+        {{0x04, 0x91, 0x22, 0x33, 0x44, 0x55, 0x67}, 7, 0x00},
+    }, false},
+    {"4-byte + 7-byte", 2, {
+        {{0x88, 0x04, 0x10, 0x20}, 4, 0x08},
+        {{0x04, 0x04, 0x10, 0x20, 0x30, 0x40, 0x50}, 7, 0x00},
+    }, false},
+    {"auth classic 4B", 1, {
+        {{0xDE, 0xAD, 0xBE, 0xEF}, 4, 0x08},
+    }, true},
+    {"auth ntag 7B", 1, {
+        {{0x04, 0x52, 0x19, 0xA2, 0x6B, 0x51, 0x80}, 7, 0x00},
+    }, true},
+    {"auth both", 2, {
+        {{0x88, 0x04, 0x10, 0x20}, 4, 0x08},
+        {{0x04, 0x04, 0x10, 0x20, 0x30, 0x40, 0x50}, 7, 0x00},
+    }, true},
+};
+
+typedef struct {
+    int runs;
+    int failures;
+    double transactions;
+    double batches;
+    double bytes;
+    double bus_us;
+    double total_us;
+    double wall_us;
+    int64_t max_total_us;
+} bench_result_t;
+
+static int64_t wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool uids_match(const bench_scenario_t *sc, const rc522_uid_t *uids, int found) {
+    if (found != sc->count) return false;
+    for (int i = 0; i < sc->count; i++) {
+        bool seen = false;
+        for (int j = 0; j < found && !seen; j++) {
+            seen = uids[j].size == sc->tags[i].len && memcmp(uids[j].bytes, sc->tags[i].uid, uids[j].size) == 0;
+        }
+        if (!seen) return false;
+    }
+    return true;
+}
+
+// Protected block contents: anything that differs per tag
+static void bench_block(const uint8_t *uid, int len, uint8_t *out) {
+    for (int i = 0; i < RC522_BLOCK_SIZE; i++) {
+        out[i] = uid[i % len] ^ (uint8_t)(i * 17);
+    }
+}
+
+static void bench_provision(rc522_sim_tag_t *tag) {
+    uint8_t block[RC522_BLOCK_SIZE];
+    bench_block(tag->uid, tag->uid_len, block);
+    memcpy(tag->key, bench_key.mf_key, sizeof(tag->key));
+    memcpy(tag->pwd, bench_key.ntag_pwd, sizeof(tag->pwd));
+    memcpy(tag->pack, bench_key.ntag_pack, sizeof(tag->pack));
+    tag->auth0 = BENCH_AUTH_ADDR;
+    // Classic addresses 16-byte blocks, NTAG 4-byte pages
+    memcpy(&tag->mem[BENCH_AUTH_ADDR * (tag->sak == 0x08 ? 16 : 4)], block, sizeof(block));
+}
+
+// Counts the tags whose protected block read back as provisioned
+static void bench_visit(rc522_t *dev, const rc522_uid_t *uid, int index, void *arg) {
+    int *verified = arg;
+    uint8_t block[RC522_BLOCK_SIZE], expect[RC522_BLOCK_SIZE];
+    bench_block(uid->bytes, uid->size, expect);
+    if (rc522_read_protected(dev, uid, BENCH_AUTH_ADDR, &bench_key, block) == RC522_OK &&
+        memcmp(block, expect, sizeof(block)) == 0) {
+        (*verified)++;
+    }
+}
+
+static bench_result_t bench_run(rc522_t *dev, rc522_sim_t *sim, const bench_scenario_t *sc, int iterations) {
+    bench_result_t r = {0};
+
+    rc522_sim_clear_tags(sim);
+    for (int i = 0; i < sc->count; i++) {
+        rc522_sim_tag_t *tag = rc522_sim_add_tag(sim, sc->tags[i].uid, sc->tags[i].len, sc->tags[i].sak);
+        if (tag && sc->auth) bench_provision(tag);
+    }
+
+    for (int it = 0; it < iterations; it++) {
+        rc522_uid_t uids[RC522_MAX_TAGS];
+        rc522_sim_field_reset(sim);
+
+        rc522_spi_stats_t start = rc522_spi_stats_get(dev);
+        int64_t sim_start = rc522_sim_now_us(sim);
+        int64_t wall_start = wall_ns();
+
+        int found = 0, verified = 0;
+        if (rc522_is_card_present(dev)) {
+            found = rc522_scan_tags_visit(dev, uids, RC522_MAX_TAGS, sc->auth ? bench_visit : NULL, &verified);
+        }
+
+        int64_t wall = wall_ns() - wall_start;
+        int64_t total = rc522_sim_now_us(sim) - sim_start;
+        rc522_spi_stats_t used = rc522_spi_stats_since(dev, &start);
+
+        r.runs++;
+        if (!uids_match(sc, uids, found) || (sc->auth && verified != found)) r.failures++;
+        r.transactions += used.transactions;
+        r.batches += used.batches;
+        r.bytes += used.bytes;
+        r.bus_us += used.bus_time_us;
+        r.total_us += total;
+        r.wall_us += wall / 1000.0;
+        if (total > r.max_total_us) r.max_total_us = total;
+    }
+    return r;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n iterations] [-s spi_hz] [-c clean_hz]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    int spi_hz = BENCH_DEFAULT_SPI_HZ;
+    int clean_hz = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            spi_hz = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            clean_hz = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (iterations <= 0 || spi_hz <= 0 || clean_hz < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // One simulated reader per mode; init output comes before the table
+    static rc522_sim_t sims[2];
+    static rc522_t devs[2];
+    static const char *modes[2] = {"poll", "irq"};
+    for (int mode = 0; mode < 2; mode++) {
+        rc522_sim_config_t cfg = {
+            .spi_hz = spi_hz,
+            .frame_overhead_ns = BENCH_FRAME_OVERHEAD_NS,
+            .call_overhead_ns = BENCH_CALL_OVERHEAD_NS,
+            .irq_wired = mode == 1,
+            .max_clean_hz = clean_hz,
+        };
+        rc522_sim_init(&sims[mode], &cfg);
+        if (!rc522_init(&devs[mode], rc522_sim_hal(&sims[mode])) ||
+            (mode == 1 && !rc522_irq_enable(&devs[mode]))) {
+            fprintf(stderr, "driver init against the simulator failed\n");
+            return 1;
+        }
+        if (clean_hz) {
+            uint32_t hz = rc522_spi_calibrate(&devs[mode], bench_rates,
+                sizeof(bench_rates) / sizeof(bench_rates[0]), BENCH_CHECK_ROUNDS);
+            rc522_link_stats_t link = rc522_link_stats_get(&devs[mode]);
+            printf("%s: calibrated to %lu Hz (%lu checks, %lu failed)\n", modes[mode],
+                (unsigned long)hz, (unsigned long)link.checks, (unsigned long)link.errors);
+            if (hz == 0) return 1;
+        }
+    }
+
+    int failures = 0;
+    printf("\n%-16s %-5s %6s %8s %8s %8s %9s %9s %9s %9s\n", "scenario", "mode", "fail",
+        "txn", "batches", "bytes", "bus_us", "total_us", "max_us", "wall_us");
+    for (int mode = 0; mode < 2; mode++) {
+        for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+            bench_result_t r = bench_run(&devs[mode], &sims[mode], &scenarios[s], iterations);
+            failures += r.failures;
+            printf("%-16s %-5s %6d %8.1f %8.1f %8.1f %9.1f %9.1f %9lld %9.2f\n",
+                scenarios[s].name, modes[mode], r.failures,
+                r.transactions / r.runs, r.batches / r.runs, r.bytes / r.runs,
+                r.bus_us / r.runs, r.total_us / r.runs, (long long)r.max_total_us, r.wall_us / r.runs);
+        }
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d scans did not return the tags in the field\n", failures);
+        return 1;
+    }
+    return 0;
+}
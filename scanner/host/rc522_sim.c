@@ -0,0 +1,613 @@
+// MFRC522 simulator
+#include <string.h>
+#include "rc522_regs.h"
+#include "rc522_sim.h"
+
+#define SIM_FC_HZ             13560000LL
+#define SIM_BIT_NS            (128LL * 1000000000LL / SIM_FC_HZ)     // 106 kbit/s
+#define SIM_FDT_SHORT_NS      (1172LL * 1000000000LL / SIM_FC_HZ)    // REQA/WUPA
+#define SIM_FDT_NS            (1236LL * 1000000000LL / SIM_FC_HZ)
+#define SIM_VERSION           0x92
+#define RC522_SIM_NOISE_PERIOD 97     // read bytes per flipped bit above max_clean_hz
+#define SIM_ANSWER_MAX        (RC522_SIM_FIFO_SIZE / 2)    // a READ answer is 18 bytes
+#define SIM_CLASSIC_BLOCKS    64
+
+// Air time of a frame: data bits, one parity bit per full byte, start and end
+static int64_t air_time_ns(int bits) {
+    return (bits + bits / 8 + 2) * SIM_BIT_NS;
+}
+
+void rc522_sim_crc_a(const uint8_t *data, int len, uint8_t *crc_out) {
+    uint16_t crc = 0x6363;
+    for (int i = 0; i < len; i++) {
+        uint8_t b = data[i] ^ (crc & 0xFF);
+        b ^= b << 4;
+        crc = (crc >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+    }
+    crc_out[0] = crc & 0xFF;
+    crc_out[1] = crc >> 8;
+}
+
+// Carrier on: antenna drivers enabled and the chip not powered down
+static bool sim_field_on(const rc522_sim_t *sim) {
+    return (sim->regs[TxControlReg] & 0x03) && !(sim->regs[CommandReg] & PCD_POWERDOWN) && !sim->in_reset;
+}
+
+static bool crc_ok(const uint8_t *data, int len) {
+    uint8_t crc[2];
+    if (len < 3) return false;
+    rc522_sim_crc_a(data, len - 2, crc);
+    return crc[0] == data[len - 2] && crc[1] == data[len - 1];
+}
+
+static int get_bit(const uint8_t *buf, int i) {
+    return (buf[i / 8] >> (i % 8)) & 1;
+}
+
+static void put_bit(uint8_t *buf, int i, int v) {
+    if (v) buf[i / 8] |= 1 << (i % 8);
+    else buf[i / 8] &= ~(1 << (i % 8));
+}
+
+static void sim_soft_reset(rc522_sim_t *sim) {
+    memset(sim->regs, 0, sizeof(sim->regs));
+    sim->regs[CommandReg] = 0x20;
+    sim->regs[ComIEnReg] = 0x80;
+    sim->regs[ComIrqReg] = 0x14;
+    sim->regs[ControlReg] = 0x10;
+    sim->regs[CollReg] = 0xA0;      // ValuesAfterColl, CollPosNotValid
+    sim->regs[ModeReg] = 0x3F;
+    sim->regs[TxControlReg] = 0x80;
+    sim->fifo_len = 0;
+    sim->event_pending = false;
+    sim->irq_asserted = false;
+    sim->irq_edge = false;
+}
+
+// IRQ pin follows the enabled interrupt bits; IRqInv only changes the level
+static void sim_update_irq(rc522_sim_t *sim) {
+    bool asserted = (sim->regs[ComIEnReg] & sim->regs[ComIrqReg] & 0x7F) ||
+                    (sim->regs[DivIEnReg] & sim->regs[DivIrqReg] & 0x14);
+    if (asserted && !sim->irq_asserted) {
+        sim->irq_edge = true;
+        sim->irq_edge_ns = sim->now_ns;
+    }
+    sim->irq_asserted = asserted;
+}
+
+static uint8_t sim_command(const rc522_sim_t *sim) {
+    return sim->regs[CommandReg] & 0x0F;
+}
+
+// Apply the pending RF event; the clock has to be at its time already
+static void sim_run_event(rc522_sim_t *sim) {
+    sim->event_pending = false;
+
+    if (sim->event_timeout) {
+        sim->regs[ComIrqReg] |= RC522_IRQ_TIMER;
+        sim->stats.timeouts++;
+    } else if (sim_command(sim) == PCD_TRANSMIT) {
+        sim->regs[ComIrqReg] |= RC522_IRQ_TX | RC522_IRQ_IDLE;
+        sim->regs[CommandReg] &= 0xF0;
+    } else if (sim_command(sim) == PCD_AUTHENT) {
+        sim->regs[ComIrqReg] |= RC522_IRQ_IDLE;
+        sim->regs[Status2Reg] |= RC522_STATUS2_CRYPTO1_ON;
+        sim->regs[CommandReg] &= 0xF0;
+    } else {
+        int bytes = (sim->rx_bits + 7) / 8;
+        for (int i = 0; i < bytes && sim->fifo_len < RC522_SIM_FIFO_SIZE; i++) {
+            sim->fifo[sim->fifo_len++] = sim->rx[i];
+        }
+        sim->regs[ControlReg] = (sim->regs[ControlReg] & ~0x07) | (sim->rx_bits % 8);
+        uint8_t irq = RC522_IRQ_TX | RC522_IRQ_RX;
+        if (sim->coll_bit >= 0) {
+            // CollPos counts from bit 0 of the first FIFO byte, 32 encoded as 0
+            sim->regs[ErrorReg] |= 0x08;
+            int pos = sim->coll_bit + 1;
+            if (pos <= 32) {
+                sim->regs[CollReg] = (sim->regs[CollReg] & 0x80) | (pos & 0x1F);
+            }
+            irq |= RC522_IRQ_ERR;
+            sim->stats.collisions++;
+        }
+        sim->regs[ComIrqReg] |= irq;
+    }
+    sim_update_irq(sim);
+}
+
+static void sim_advance(rc522_sim_t *sim, int64_t ns) {
+    int64_t target = sim->now_ns + ns;
+    while (sim->event_pending && sim->event_ns <= target) {
+        sim->now_ns = sim->event_ns;
+        sim_run_event(sim);
+    }
+    sim->now_ns = target;
+}
+
+// Cascade level bytes of a tag: 4 UID (or cascade tag + 3 UID) bytes and BCC
+static void tag_level_bytes(const rc522_sim_tag_t *tag, int level, uint8_t *out) {
+    int levels = tag->uid_len == 4 ? 1 : tag->uid_len == 7 ? 2 : 3;
+    if (level < levels - 1) {
+        out[0] = PICC_CASCADE_TAG;
+        memcpy(&out[1], &tag->uid[level * 3], 3);
+    } else {
+        memcpy(out, &tag->uid[level * 3], 4);
+    }
+    out[4] = out[0] ^ out[1] ^ out[2] ^ out[3];
+}
+
+static bool tag_last_level(const rc522_sim_tag_t *tag, int level) {
+    int levels = tag->uid_len == 4 ? 1 : tag->uid_len == 7 ? 2 : 3;
+    return level == levels - 1;
+}
+
+// Anything a READY or ACTIVE tag does not expect sends it back
+static void tag_fall_back(rc522_sim_tag_t *tag) {
+    if (tag->state == RC522_SIM_TAG_READY || tag->state == RC522_SIM_TAG_ACTIVE) {
+        tag->state = tag->woken_from_halt ? RC522_SIM_TAG_HALT : RC522_SIM_TAG_IDLE;
+        tag->authenticated = false;
+    }
+}
+
+static bool tag_is_classic(const rc522_sim_tag_t *tag) {
+    return tag->sak == 0x08;
+}
+
+static bool tag_is_ntag(const rc522_sim_tag_t *tag) {
+    return tag->sak == 0x00;
+}
+
+// Refusal: the 4-bit NAK 0x0, and the tag falls back
+static int tag_nak(rc522_sim_tag_t *tag, uint8_t *resp) {
+    tag_fall_back(tag);
+    resp[0] = 0x00;
+    return 4;
+}
+
+// READ and PWD_AUTH on an ACTIVE tag, frames with their CRC_A checked already;
+// -1 for anything else
+static int tag_memory(rc522_sim_tag_t *tag, const uint8_t *data, int len, uint8_t *resp) {
+    if (len == 4 && data[0] == PICC_READ) {
+        uint8_t addr = data[1];
+        bool allowed = false;
+        if (tag_is_classic(tag)) {
+            allowed = addr < SIM_CLASSIC_BLOCKS && tag->authenticated && addr / 4 == tag->auth_sector;
+        } else if (tag_is_ntag(tag)) {
+            allowed = addr < RC522_SIM_NTAG_PAGES && (addr < tag->auth0 || tag->authenticated);
+        }
+        if (!allowed) {
+            return tag_nak(tag, resp);
+        }
+        for (int i = 0; i < 16; i++) {
+            // NTAG pages roll over at the end of memory
+            resp[i] = tag_is_classic(tag) ? tag->mem[addr * 16 + i]
+                                          : tag->mem[((addr + i / 4) % RC522_SIM_NTAG_PAGES) * 4 + i % 4];
+        }
+        rc522_sim_crc_a(resp, 16, &resp[16]);
+        return 18 * 8;
+    }
+
+    if (len == 7 && data[0] == PICC_NTAG_PWD_AUTH && tag_is_ntag(tag)) {
+        if (memcmp(&data[1], tag->pwd, sizeof(tag->pwd)) != 0) {
+            return tag_nak(tag, resp);
+        }
+        tag->authenticated = true;
+        memcpy(resp, tag->pack, sizeof(tag->pack));
+        rc522_sim_crc_a(resp, 2, &resp[2]);
+        return 32;
+    }
+    return -1;
+}
+
+// Feed one PCD frame to a tag; returns the number of answer bits written to resp
+static int tag_receive(rc522_sim_tag_t *tag, const uint8_t *data, int bits, uint8_t *resp) {
+    memset(resp, 0, SIM_ANSWER_MAX);
+
+    if (bits == 7) {
+        uint8_t cmd = data[0] & 0x7F;
+        bool wake = (cmd == PICC_REQA && tag->state == RC522_SIM_TAG_IDLE) ||
+                    (cmd == PICC_WUPA && (tag->state == RC522_SIM_TAG_IDLE || tag->state == RC522_SIM_TAG_HALT));
+        if (!wake) {
+            tag_fall_back(tag);
+            return 0;
+        }
+        tag->woken_from_halt = tag->state == RC522_SIM_TAG_HALT;
+        tag->state = RC522_SIM_TAG_READY;
+        tag->level = 0;
+        // ATQA: UID size in bits 7-6, bit frame anticollision supported
+        uint8_t size = tag->uid_len == 4 ? 0 : tag->uid_len == 7 ? 1 : 2;
+        resp[0] = (size << 6) | 0x04;
+        resp[1] = 0x00;
+        return 16;
+    }
+
+    if (bits >= 16 && (data[0] == PICC_SEL_CL1 || data[0] == PICC_SEL_CL2 || data[0] == PICC_SEL_CL3)) {
+        int level = (data[0] - PICC_SEL_CL1) / 2;
+        if (tag->state != RC522_SIM_TAG_READY || tag->level != level) {
+            tag_fall_back(tag);
+            return 0;
+        }
+        uint8_t cl[5];
+        tag_level_bytes(tag, level, cl);
+
+        if (data[1] == 0x70 && bits == 9 * 8) {
+            // SELECT: a tag that does not match leaves the round
+            if (!crc_ok(data, 9) || memcmp(&data[2], cl, 5) != 0) {
+                tag_fall_back(tag);
+                return 0;
+            }
+            uint8_t sak = tag_last_level(tag, level) ? tag->sak & ~PICC_SAK_CASCADE : PICC_SAK_CASCADE;
+            if (tag_last_level(tag, level)) tag->state = RC522_SIM_TAG_ACTIVE;
+            else tag->level++;
+            resp[0] = sak;
+            rc522_sim_crc_a(resp, 1, &resp[1]);
+            return 24;
+        }
+
+        // ANTICOLLISION: answer the rest of the level if the known bits match ours
+        int known = ((data[1] >> 4) - 2) * 8 + (data[1] & 0x0F);
+        if (known < 0 || known >= 40 || known != bits - 16) {
+            return 0;
+        }
+        for (int i = 0; i < known; i++) {
+            if (get_bit(&data[2], i) != get_bit(cl, i)) return 0;
+        }
+        for (int i = known; i < 40; i++) {
+            put_bit(resp, i - known, get_bit(cl, i));
+        }
+        return 40 - known;
+    }
+
+    if (bits == 32 && data[0] == PICC_HLTA && data[1] == 0x00 && crc_ok(data, 4)) {
+        if (tag->state == RC522_SIM_TAG_ACTIVE) {
+            tag->state = RC522_SIM_TAG_HALT;
+            tag->authenticated = false;
+            return 0;
+        }
+    }
+
+    if (tag->state == RC522_SIM_TAG_ACTIVE && bits % 8 == 0 && crc_ok(data, bits / 8)) {
+        int n = tag_memory(tag, data, bits / 8, resp);
+        if (n >= 0) return n;
+    }
+
+    tag_fall_back(tag);
+    return 0;
+}
+
+// TAuto: the timer starts when transmission ends; without it nothing ends the command
+static void sim_schedule_timeout(rc522_sim_t *sim, int64_t tx_end) {
+    if (!(sim->regs[TModeReg] & 0x80)) {
+        sim->event_pending = false;
+        return;
+    }
+    int prescaler = ((sim->regs[TModeReg] & 0x0F) << 8) | sim->regs[TPrescalerReg];
+    int reload = (sim->regs[TReloadRegH] << 8) | sim->regs[TReloadRegL];
+    int64_t tick_ns = (2LL * prescaler + 1) * 1000000000LL / SIM_FC_HZ;
+    sim->event_pending = true;
+    sim->event_timeout = true;
+    sim->event_ns = tx_end + (reload + 1) * tick_ns;
+}
+
+// Send the FIFO contents over the air and schedule what comes back
+static void sim_transmit(rc522_sim_t *sim) {
+    uint8_t framing = sim->regs[BitFramingReg];
+    int tx_last = framing & 0x07;
+    int rx_align = (framing >> 4) & 0x07;
+    int bits = sim->fifo_len * 8 - (tx_last ? 8 - tx_last : 0);
+    uint8_t data[RC522_SIM_FIFO_SIZE];
+    memcpy(data, sim->fifo, sim->fifo_len);
+    sim->fifo_len = 0;
+    sim->regs[ErrorReg] = 0;
+    sim->regs[CollReg] |= 0x20;
+    sim->stats.rf_frames++;
+
+    int64_t tx_end = sim->now_ns + air_time_ns(bits);
+    bool field_on = sim_field_on(sim);
+
+    // Every tag that answers drives the carrier at the same time; a bit where they
+    // disagree is a collision
+    int answer_bits = 0;
+    int coll = -1;
+    uint8_t answer[SIM_ANSWER_MAX] = {0};
+    for (int t = 0; field_on && t < sim->tag_count; t++) {
+        uint8_t resp[SIM_ANSWER_MAX];
+        int n = tag_receive(&sim->tags[t], data, bits, resp);
+        if (n == 0) continue;
+        for (int i = 0; i < n; i++) {
+            int v = get_bit(resp, i);
+            if (i < answer_bits && get_bit(answer, i) != v && (coll < 0 || i < coll)) {
+                coll = i;
+            }
+            if (v) put_bit(answer, i, 1);
+        }
+        if (n > answer_bits) answer_bits = n;
+    }
+
+    sim->event_pending = true;
+    if (sim_command(sim) == PCD_TRANSMIT) {
+        sim->event_timeout = false;
+        sim->event_ns = tx_end;
+        return;
+    }
+    if (answer_bits > 0) {
+        memset(sim->rx, 0, sizeof(sim->rx));
+        for (int i = 0; i < answer_bits; i++) {
+            put_bit(sim->rx, rx_align + i, get_bit(answer, i));
+        }
+        sim->rx_bits = rx_align + answer_bits;
+        sim->coll_bit = coll >= 0 ? rx_align + coll : -1;
+        sim->event_timeout = false;
+        sim->event_ns = tx_end + (bits == 7 ? SIM_FDT_SHORT_NS : SIM_FDT_NS) + air_time_ns(answer_bits);
+    } else {
+        sim_schedule_timeout(sim, tx_end);
+    }
+}
+
+// MFAuthent against the ACTIVE tag. Succeeds after the air time of the three
+// passes; with a wrong key the tag answers the first pass, goes quiet after the
+// second and the chip waits for the timer.
+static void sim_authent(rc522_sim_t *sim) {
+    uint8_t cmd[12];
+    int len = sim->fifo_len;
+    memcpy(cmd, sim->fifo, len < (int)sizeof(cmd) ? len : (int)sizeof(cmd));
+    sim->fifo_len = 0;
+    sim->regs[ErrorReg] = 0;
+    sim->stats.rf_frames++;
+
+    rc522_sim_tag_t *tag = NULL;
+    for (int t = 0; sim_field_on(sim) && t < sim->tag_count; t++) {
+        if (sim->tags[t].state == RC522_SIM_TAG_ACTIVE) tag = &sim->tags[t];
+    }
+    if (!tag) {
+        sim_schedule_timeout(sim, sim->now_ns + air_time_ns(32));
+        return;
+    }
+
+    // Auth request and tag nonce, then reader nonce and answer, then tag answer
+    int64_t pass1_ns = air_time_ns(32) + SIM_FDT_NS + air_time_ns(32);
+    int64_t pass2_ns = air_time_ns(64);
+    if (tag_is_classic(tag) && len == 12 && cmd[0] == PICC_MF_AUTH_KEY_A && cmd[1] < SIM_CLASSIC_BLOCKS &&
+        memcmp(&cmd[2], tag->key, sizeof(tag->key)) == 0 &&
+        memcmp(&cmd[8], &tag->uid[tag->uid_len - 4], 4) == 0) {
+        tag->authenticated = true;
+        tag->auth_sector = cmd[1] / 4;
+        sim->event_pending = true;
+        sim->event_timeout = false;
+        sim->event_ns = sim->now_ns + pass1_ns + pass2_ns + SIM_FDT_NS + air_time_ns(32);
+        return;
+    }
+    tag_fall_back(tag);
+    sim_schedule_timeout(sim, sim->now_ns + pass1_ns + pass2_ns);
+}
+
+static void sim_write_reg(rc522_sim_t *sim, uint8_t reg, uint8_t value) {
+    switch (reg) {
+    case CommandReg:
+        sim->regs[CommandReg] = (sim->regs[CommandReg] & 0xC0) | (value & 0x3F);
+        switch (value & 0x0F) {
+        case PCD_IDLE:
+            sim->event_pending = false;
+            break;
+        case PCD_RESETPHASE:
+            sim_soft_reset(sim);
+            break;
+        case PCD_CALCCRC: {
+            uint8_t crc[2];
+            rc522_sim_crc_a(sim->fifo, sim->fifo_len, crc);
+            sim->regs[CRCResultRegL] = crc[0];
+            sim->regs[CRCResultRegH] = crc[1];
+            sim->fifo_len = 0;
+            sim->regs[DivIrqReg] |= RC522_DIV_IRQ_CRC;
+            break;
+        }
+        case PCD_TRANSMIT:
+            sim_transmit(sim);
+            break;
+        case PCD_AUTHENT:
+            sim_authent(sim);
+            break;
+        default:
+            break;
+        }
+        break;
+    case BitFramingReg:
+        sim->regs[BitFramingReg] = value & 0x7F;
+        if ((value & 0x80) && sim_command(sim) == PCD_TRANSCEIVE) {
+            sim_transmit(sim);
+        }
+        break;
+    case ComIrqReg:
+    case DivIrqReg:
+        // Set1 picks whether the marked bits are set or cleared
+        if (value & 0x80) sim->regs[reg] |= value & 0x7F;
+        else sim->regs[reg] &= ~value;
+        break;
+    case FIFOLevelReg:
+        if (value & 0x80) {
+            sim->fifo_len = 0;
+            sim->regs[ErrorReg] &= ~0x10;
+        }
+        break;
+    case FIFODataReg:
+        if (sim->fifo_len < RC522_SIM_FIFO_SIZE) sim->fifo[sim->fifo_len++] = value;
+        else sim->regs[ErrorReg] |= 0x10;
+        break;
+    case VersionReg:
+    case ControlReg:
+        // TStopNow and TStartNow are strobes and RxLastBits is read-only
+        break;
+    default:
+        sim->regs[reg] = value;
+        break;
+    }
+    sim_update_irq(sim);
+}
+
+// Tags are powered by the field: when it goes off they lose their state
+static void sim_write(rc522_sim_t *sim, uint8_t reg, uint8_t value) {
+    bool was_on = sim_field_on(sim);
+    sim_write_reg(sim, reg, value);
+    if (was_on && !sim_field_on(sim)) {
+        rc522_sim_field_reset(sim);
+    }
+}
+
+static uint8_t sim_read(rc522_sim_t *sim, uint8_t reg) {
+    switch (reg) {
+    case FIFODataReg: {
+        if (sim->fifo_len == 0) return 0;
+        uint8_t v = sim->fifo[0];
+        memmove(sim->fifo, sim->fifo + 1, --sim->fifo_len);
+        return v;
+    }
+    case FIFOLevelReg:
+        return sim->fifo_len;
+    case VersionReg:
+        return SIM_VERSION;
+    default:
+        return sim->regs[reg];
+    }
+}
+
+// One CS assertion: the first byte picks register and direction
+static void sim_frame(rc522_sim_t *sim, const rc522_hal_frame_t *f) {
+    sim_advance(sim, sim->cfg.frame_overhead_ns + (int64_t)f->len * 8 * 1000000000LL / sim->cfg.spi_hz);
+    sim->stats.frames++;
+    sim->stats.bytes += f->len;
+    if (f->rx) memset(f->rx, 0, f->len);
+    if (sim->in_reset || f->len == 0) return;
+
+    if (f->tx[0] & 0x80) {
+        // Read: each byte carries the next address, the answer comes one byte later
+        for (int i = 0; i + 1 < f->len; i++) {
+            uint8_t v = sim_read(sim, (f->tx[i] >> 1) & 0x3F);
+            if (sim->cfg.max_clean_hz && sim->cfg.spi_hz > sim->cfg.max_clean_hz &&
+                ++sim->read_bytes % RC522_SIM_NOISE_PERIOD == 0) {
+                v ^= 0x10;
+            }
+            if (f->rx) f->rx[i + 1] = v;
+        }
+    } else {
+        uint8_t reg = (f->tx[0] >> 1) & 0x3F;
+        for (int i = 1; i < f->len; i++) {
+            sim_write(sim, reg, f->tx[i]);
+        }
+    }
+}
+
+static bool hal_transfer(void *ctx, const rc522_hal_frame_t *frames, int count) {
+    rc522_sim_t *sim = ctx;
+    sim_advance(sim, sim->cfg.call_overhead_ns);
+    for (int i = 0; i < count; i++) {
+        sim_frame(sim, &frames[i]);
+    }
+    return true;
+}
+
+static bool hal_set_clock(void *ctx, uint32_t hz) {
+    rc522_sim_t *sim = ctx;
+    if (hz == 0) return false;
+    sim->cfg.spi_hz = hz;
+    return true;
+}
+
+static void hal_reset(void *ctx, bool active) {
+    rc522_sim_t *sim = ctx;
+    sim->in_reset = active;
+    if (active) sim_soft_reset(sim);
+}
+
+static void hal_delay_ms(void *ctx, uint32_t ms) {
+    sim_advance(ctx, (int64_t)ms * 1000000);
+}
+
+static int64_t hal_now_us(void *ctx) {
+    return rc522_sim_now_us(ctx);
+}
+
+static bool hal_irq_enable(void *ctx) {
+    return true;
+}
+
+static void hal_irq_arm(void *ctx) {
+    rc522_sim_t *sim = ctx;
+    sim->irq_edge = false;
+}
+
+// Sleep until the next edge: jump straight to the pending event if it is in time
+static bool hal_irq_wait(void *ctx, int64_t timeout_us, int64_t *edge_us) {
+    rc522_sim_t *sim = ctx;
+    int64_t deadline = sim->now_ns + timeout_us * 1000;
+    while (!sim->irq_edge && sim->event_pending && sim->event_ns <= deadline) {
+        sim->now_ns = sim->event_ns;
+        sim_run_event(sim);
+    }
+    if (!sim->irq_edge) {
+        if (deadline > sim->now_ns) sim->now_ns = deadline;
+        return false;
+    }
+    sim->irq_edge = false;
+    *edge_us = sim->irq_edge_ns / 1000;
+    return true;
+}
+
+void rc522_sim_init(rc522_sim_t *sim, const rc522_sim_config_t *cfg) {
+    memset(sim, 0, sizeof(*sim));
+    sim->cfg = *cfg;
+    sim_soft_reset(sim);
+    sim->hal = (rc522_hal_t) {
+        .transfer = hal_transfer,
+        .reset = hal_reset,
+        .delay_ms = hal_delay_ms,
+        .now_us = hal_now_us,
+        .set_clock = hal_set_clock,
+        .ctx = sim,
+    };
+    if (cfg->irq_wired) {
+        sim->hal.irq_enable = hal_irq_enable;
+        sim->hal.irq_arm = hal_irq_arm;
+        sim->hal.irq_wait = hal_irq_wait;
+    }
+}
+
+const rc522_hal_t *rc522_sim_hal(rc522_sim_t *sim) {
+    return &sim->hal;
+}
+
+rc522_sim_tag_t *rc522_sim_add_tag(rc522_sim_t *sim, const uint8_t *uid, uint8_t uid_len, uint8_t sak) {
+    if (sim->tag_count >= RC522_SIM_MAX_TAGS || (uid_len != 4 && uid_len != 7 && uid_len != 10)) {
+        return NULL;
+    }
+    rc522_sim_tag_t *tag = &sim->tags[sim->tag_count++];
+    memset(tag, 0, sizeof(*tag));
+    memcpy(tag->uid, uid, uid_len);
+    tag->uid_len = uid_len;
+    tag->sak = sak;
+    // Factory defaults: transport key, password FF.., nothing protected
+    memset(tag->key, 0xFF, sizeof(tag->key));
+    memset(tag->pwd, 0xFF, sizeof(tag->pwd));
+    tag->auth0 = 0xFF;
+    return tag;
+}
+
+void rc522_sim_clear_tags(rc522_sim_t *sim) {
+    sim->tag_count = 0;
+}
+
+void rc522_sim_field_reset(rc522_sim_t *sim) {
+    for (int t = 0; t < sim->tag_count; t++) {
+        sim->tags[t].state = RC522_SIM_TAG_IDLE;
+        sim->tags[t].level = 0;
+        sim->tags[t].woken_from_halt = false;
+        sim->tags[t].authenticated = false;
+    }
+}
+
+int64_t rc522_sim_now_us(const rc522_sim_t *sim) {
+    return sim->now_ns / 1000;
+}
+
+void rc522_sim_idle(rc522_sim_t *sim, int64_t us) {
+    sim_advance(sim, us * 1000);
+}
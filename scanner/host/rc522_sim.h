@@ -0,0 +1,117 @@
+// Register-level MFRC522 simulator with a population of ISO 14443-A tags
+//
+// Implements the parts of the chip the driver uses: register file, 64-byte FIFO,
+// ComIrq/DivIrq bits and the IRQ pin, the TAuto timer, CalcCRC, Transmit,
+// Transceive with TxLastBits/RxAlign, MFAuthent, collision reporting in CollReg
+// and soft power-down. Tags follow the ISO 14443-3 state machine (IDLE, READY per cascade
+// level, ACTIVE, HALT), answer REQA, WUPA, anticollision, SELECT and HLTA, and drop
+// back to IDLE whenever the field goes off.
+//
+// Tags with memory: a SAK of 0x08 makes a MIFARE Classic 1K that takes MFAuthent
+// with key A and READ of the authenticated sector, a SAK of 0x00 an NTAG213 that
+// takes PWD_AUTH and READ, with pages from auth0 on behind the password. Crypto1
+// itself is not modelled: once MFAuthent succeeds the frames stay plain, which is
+// all the driver sees of them anyway.
+//
+// Above max_clean_hz the HAL's set_clock() lets a read byte come back with a bit
+// flipped every so often, the way a long cable does, so calibration has an edge
+// to find.
+//
+// Time is virtual: every SPI frame advances the clock by its bit time plus a fixed
+// overhead, and RF exchanges complete after their air time, so a benchmark run is
+// deterministic and independent of the host.
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "rc522_hal.h"
+
+#define RC522_SIM_MAX_TAGS    8
+#define RC522_SIM_FIFO_SIZE   64
+#define RC522_SIM_TAG_MEM     1024      // Classic 1K; an NTAG213 uses the first 180 bytes
+#define RC522_SIM_NTAG_PAGES  45
+
+typedef struct {
+    uint32_t spi_hz;                // SPI clock
+    uint32_t frame_overhead_ns;     // per CS assertion: driver and CS setup time
+    uint32_t call_overhead_ns;      // per transfer() call
+    bool irq_wired;                 // expose irq_* in the HAL
+    uint32_t max_clean_hz;          // faster clocks corrupt readback now and then; 0 never
+} rc522_sim_config_t;
+
+typedef enum {
+    RC522_SIM_TAG_IDLE = 0,
+    RC522_SIM_TAG_READY,
+    RC522_SIM_TAG_ACTIVE,
+    RC522_SIM_TAG_HALT,
+} rc522_sim_tag_state_t;
+
+typedef struct {
+    uint8_t uid[10];
+    uint8_t uid_len;                // 4, 7 or 10
+    uint8_t sak;                    // final SAK, e.g. 0x08 for MIFARE Classic 1K
+    rc522_sim_tag_state_t state;
+    uint8_t level;                  // cascade level while READY
+    bool woken_from_halt;           // falls back to HALT instead of IDLE
+    // Memory, filled in by the caller after rc522_sim_add_tag()
+    uint8_t mem[RC522_SIM_TAG_MEM]; // Classic blocks or NTAG pages
+    uint8_t key[6];                 // Classic key A of every sector, FF.. by default
+    uint8_t pwd[4];                 // NTAG password, FF.. by default
+    uint8_t pack[2];
+    uint8_t auth0;                  // first NTAG page behind the password, 0xFF none
+    bool authenticated;
+    uint8_t auth_sector;            // Classic sector MFAuthent opened
+} rc522_sim_tag_t;
+
+typedef struct {
+    uint32_t frames;                // SPI frames seen
+    uint32_t bytes;
+    uint32_t rf_frames;             // frames sent to the tags
+    uint32_t collisions;
+    uint32_t timeouts;              // chip timer expiries
+} rc522_sim_stats_t;
+
+typedef struct {
+    rc522_sim_config_t cfg;
+    rc522_hal_t hal;
+    int64_t now_ns;
+
+    uint8_t regs[64];
+    uint8_t fifo[RC522_SIM_FIFO_SIZE];
+    int fifo_len;
+    bool in_reset;
+    uint32_t read_bytes;            // bytes read back, paces the corruption
+
+    // RF exchange in progress: what lands in the chip at event_ns
+    bool event_pending;
+    int64_t event_ns;
+    bool event_timeout;             // timer expiry rather than a reception
+    uint8_t rx[RC522_SIM_FIFO_SIZE];
+    int rx_bits;                    // received bits, RxAlign included
+    int coll_bit;                   // FIFO bit of the first collision, -1 if none
+
+    bool irq_asserted;
+    bool irq_edge;                  // edge not yet consumed by irq_wait()
+    int64_t irq_edge_ns;
+
+    rc522_sim_tag_t tags[RC522_SIM_MAX_TAGS];
+    int tag_count;
+
+    rc522_sim_stats_t stats;
+} rc522_sim_t;
+
+void rc522_sim_init(rc522_sim_t *sim, const rc522_sim_config_t *cfg);
+const rc522_hal_t *rc522_sim_hal(rc522_sim_t *sim);
+
+// NULL when the population is full or the UID length is not 4, 7 or 10
+rc522_sim_tag_t *rc522_sim_add_tag(rc522_sim_t *sim, const uint8_t *uid, uint8_t uid_len, uint8_t sak);
+void rc522_sim_clear_tags(rc522_sim_t *sim);
+// Every tag leaves and re-enters the field: power-on, back to IDLE
+void rc522_sim_field_reset(rc522_sim_t *sim);
+
+int64_t rc522_sim_now_us(const rc522_sim_t *sim);
+// Let time pass with the bus idle, as a sleeping host would
+void rc522_sim_idle(rc522_sim_t *sim, int64_t us);
+
+// CRC_A as defined in ISO 14443-3, low byte first
+void rc522_sim_crc_a(const uint8_t *data, int len, uint8_t *crc_out);
@@ -0,0 +1,11 @@
+// Host stand-in for the firmware log ring: messages are printed as they come
+#include <stdarg.h>
+#include <stdio.h>
+#include "scan_log.h"
+
+void scan_log_write(int level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
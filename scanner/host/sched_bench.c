@@ -0,0 +1,248 @@
+// Probe schedule benchmark against the simulated RC522
+//
+// Replays one tap trace against a simulated reader with its IRQ line wired, once per
+// schedule: keyfobs arrive at random, some in quick succession as a queue of people
+// would, stay in the field for a while and leave. Each run reports probes per
+// second, the share of time the RF field is on, the detect latency (card in the
+// field to the end of the probe that saw it) and the reader's average current from
+// nominal datasheet figures. Exits non-zero when an adaptive schedule misses a tap;
+// the fixed ones are there for reference and 500 ms does miss the quickest taps.
+//
+//   sched_bench [-t seconds] [-r taps_per_hour] [-i idle_ms]
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rc522.h"
+#include "rc522_sim.h"
+#include "scan_sched.h"
+
+#define BENCH_DEFAULT_SECONDS     3600
+#define BENCH_DEFAULT_TAPS_HOUR   120
+#define BENCH_DEFAULT_IDLE_MS     250
+#define BENCH_SPI_HZ              4000000
+#define BENCH_FRAME_OVERHEAD_NS   12000
+#define BENCH_CALL_OVERHEAD_NS    2000
+#define BENCH_MAX_TAPS            4096
+#define BENCH_DWELL_MIN_US        300000  // shortest time a keyfob is held up
+#define BENCH_DWELL_SPREAD_US     1200000
+#define BENCH_QUEUE_CHANCE        30      // % of taps followed by another within seconds
+
+// Nominal MFRC522 supply current: digital, analog and transmitter with the field
+// on; soft power-down
+#define BENCH_FIELD_ON_MA         75.0
+#define BENCH_POWER_DOWN_MA       0.01
+
+typedef struct {
+    int64_t arrive_us;
+    int64_t leave_us;
+} bench_tap_t;
+
+typedef struct {
+    const char *name;
+    bool reference;             // misses do not fail the run
+    scan_sched_config_t cfg;
+} bench_schedule_t;
+
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Uniform in [0, 1)
+static double rng_unit(void) {
+    return (rng() >> 8) / 16777216.0;
+}
+
+static int make_trace(bench_tap_t *taps, int64_t duration_us, int per_hour) {
+    double mean_gap_us = 3600e6 / per_hour;
+    int64_t t = 0;
+    int n = 0;
+
+    while (n < BENCH_MAX_TAPS) {
+        if (n > 0 && (int)(rng() % 100) < BENCH_QUEUE_CHANCE) {
+            t = taps[n - 1].leave_us + 500000 + rng() % 3000000;
+        } else {
+            // Exponential gaps; the 1 - u keeps log() away from zero
+            t += (int64_t)(-mean_gap_us * log(1.0 - rng_unit()));
+            if (n > 0 && t < taps[n - 1].leave_us + 500000) t = taps[n - 1].leave_us + 500000;
+        }
+        if (t >= duration_us) break;
+        taps[n].arrive_us = t;
+        taps[n].leave_us = t + BENCH_DWELL_MIN_US + rng() % BENCH_DWELL_SPREAD_US;
+        n++;
+    }
+    return n;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    rc522_sim_t sim;
+    rc522_t dev;
+} bench_reader_t;
+
+static bool reader_init(bench_reader_t *r) {
+    rc522_sim_config_t cfg = {
+        .spi_hz = BENCH_SPI_HZ,
+        .frame_overhead_ns = BENCH_FRAME_OVERHEAD_NS,
+        .call_overhead_ns = BENCH_CALL_OVERHEAD_NS,
+        .irq_wired = true,
+    };
+    rc522_sim_init(&r->sim, &cfg);
+    return rc522_init(&r->dev, rc522_sim_hal(&r->sim)) && rc522_irq_enable(&r->dev);
+}
+
+// Returns the number of taps no probe saw
+static int run(bench_reader_t *r, const bench_schedule_t *sch, const bench_tap_t *taps, int tap_count,
+               int64_t duration_us) {
+    static int64_t latency[BENCH_MAX_TAPS];
+    static bool seen_tap[BENCH_MAX_TAPS];
+    rc522_sim_t *sim = &r->sim;
+    rc522_t *devs[1] = {&r->dev};
+    int64_t t0 = rc522_sim_now_us(sim);
+    scan_sched_t s;
+
+#define NOW() (rc522_sim_now_us(sim) - t0)
+    memset(seen_tap, 0, sizeof(seen_tap));
+    scan_sched_init(&s, &sch->cfg, 0);
+
+    int next = 0, in_field = -1, seen = 0;
+    int64_t now = 0;
+    while (now < duration_us) {
+        // Move keyfobs in and out of the field up to now
+        if (in_field >= 0 && taps[in_field].leave_us <= now) {
+            rc522_sim_clear_tags(sim);
+            in_field = -1;
+        }
+        while (next < tap_count && taps[next].arrive_us <= now) {
+            if (in_field < 0 && taps[next].leave_us > now) {
+                uint8_t uid[4] = {0x04, next >> 8, next & 0xFF, 0x5A};
+                rc522_sim_add_tag(sim, uid, sizeof(uid), 0x08);
+                in_field = next;
+            }
+            next++;
+        }
+
+        bool present;
+        scan_sched_probe(&s, now);
+        rc522_probe_all(devs, 1, &present);
+        now = NOW();
+        if (present && in_field >= 0 && !seen_tap[in_field]) {
+            rc522_uid_t uids[RC522_MAX_TAGS];
+            seen_tap[in_field] = true;
+            latency[seen++] = now - taps[in_field].arrive_us;
+            rc522_scan_tags(&r->dev, uids, RC522_MAX_TAGS);
+            now = NOW();
+        }
+
+        int64_t wait = scan_sched_next(&s, present, now);
+        if (scan_sched_should_sleep(&s, wait)) {
+            rc522_power_down(&r->dev, true);
+            scan_sched_power(&s, false, NOW());
+            rc522_sim_idle(sim, wait - s.cfg.settle_us);
+            rc522_power_down(&r->dev, false);
+            scan_sched_power(&s, true, NOW());
+            rc522_sim_idle(sim, s.cfg.settle_us);
+        } else {
+            rc522_sim_idle(sim, wait);
+        }
+        now = NOW();
+    }
+#undef NOW
+    rc522_sim_clear_tags(sim);
+
+    // Taps still in the field at the end count neither way
+    int missed = 0;
+    for (int i = 0; i < tap_count && taps[i].leave_us < duration_us; i++) {
+        if (!seen_tap[i]) missed++;
+    }
+
+    scan_sched_stats_t st = scan_sched_stats(&s, now);
+    double duty = (double)st.awake_us / (st.awake_us + st.asleep_us);
+    double ma = duty * BENCH_FIELD_ON_MA + (1 - duty) * BENCH_POWER_DOWN_MA;
+    qsort(latency, seen, sizeof(latency[0]), cmp_i64);
+    int64_t sum = 0;
+    for (int i = 0; i < seen; i++) sum += latency[i];
+
+    printf("%-20s %6d %6d %8.2f %7.2f %8.2f %9.1f %9.1f %9.1f\n", sch->name, seen, missed,
+        st.probes / (now / 1e6), duty * 100, ma,
+        seen ? sum / seen / 1000.0 : 0.0,
+        seen ? latency[(seen * 99) / 100] / 1000.0 : 0.0,
+        seen ? latency[seen - 1] / 1000.0 : 0.0);
+    return missed;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-t seconds] [-r taps_per_hour] [-i idle_ms]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int seconds = BENCH_DEFAULT_SECONDS;
+    int per_hour = BENCH_DEFAULT_TAPS_HOUR;
+    int idle_ms = BENCH_DEFAULT_IDLE_MS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            per_hour = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            idle_ms = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (seconds <= 0 || per_hour <= 0 || idle_ms < 50) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // What the firmware did before, polled and with the IRQ line, then adaptive
+    const bench_schedule_t schedules[] = {
+        {"fixed 500 ms", true, {.fast_us = 500000, .idle_us = 500000}},
+        {"fixed 50 ms", true, {.fast_us = 50000, .idle_us = 50000}},
+        {"adaptive, field on", false, {.fast_us = 50000, .idle_us = idle_ms * 1000, .hold_us = 10000000}},
+        {"adaptive, power-down", false, {
+            .fast_us = 50000, .idle_us = idle_ms * 1000, .hold_us = 10000000,
+            .sleep_min_us = 20000, .settle_us = RC522_FIELD_SETTLE_US,
+        }},
+    };
+
+    static bench_tap_t taps[BENCH_MAX_TAPS];
+    int64_t duration_us = (int64_t)seconds * 1000000;
+    int tap_count = make_trace(taps, duration_us, per_hour);
+
+    // One simulated reader per schedule; init output comes before the table
+    #define SCHEDULE_COUNT (sizeof(schedules) / sizeof(schedules[0]))
+    static bench_reader_t readers[SCHEDULE_COUNT];
+    for (size_t i = 0; i < SCHEDULE_COUNT; i++) {
+        if (!reader_init(&readers[i])) {
+            fprintf(stderr, "driver init against the simulator failed\n");
+            return 1;
+        }
+    }
+
+    int failures = 0;
+    printf("\n%d taps over %d s\n", tap_count, seconds);
+    printf("%-20s %6s %6s %8s %7s %8s %9s %9s %9s\n", "schedule", "seen", "missed",
+        "probe/s", "field%", "rc522_mA", "lat_ms", "p99_ms", "max_ms");
+    for (size_t i = 0; i < SCHEDULE_COUNT; i++) {
+        int missed = run(&readers[i], &schedules[i], taps, tap_count, duration_us);
+        if (!schedules[i].reference) failures += missed;
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d taps were not seen\n", failures);
+        return 1;
+    }
+    return 0;
+}
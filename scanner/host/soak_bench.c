@@ -0,0 +1,959 @@
+// Scan-to-backend soak benchmark
+//
+// Runs the scanner's scan and upload paths as two threads against simulated
+// readers and a stand-in backend on a local socket. Keyfobs tap the readers at
+// random; the scan thread probes, selects, debounces and queues them through the
+// same rc522, scan_sched, scan_debounce and scan_queue code the firmware runs, and
+// the upload thread batches, encodes and sends them the way upload_task() in
+// main.c does. The stand-in answers /api/druppel/init-keyfob,
+// /api/druppel/scans/batch and /api/druppel/scans/binary after an injected
+// latency, and answers 503 to or drops the connection of a share of the requests.
+// With -u the uploads go to a real backend instead.
+//
+// Unlike the other benches this one runs on the wall clock: the simulated bus and
+// air time of every probe is slept out, so taps, probes and HTTP round trips
+// interleave the way they do on a board.
+//
+// Reports acknowledged scans per second, tap-to-queue and tap-to-ack latency, HTTP
+// round trips, heap allocations per scan on the scan thread and per request on the
+// upload thread, the allocator's arena (in use and free inside it, as a measure of
+// fragmentation) and the stack each thread used (painted stacks, TLS included).
+// With -j the report is one JSON object on stdout, to diff across versions. Exits
+// non-zero when a tap that passed the debounce was never acknowledged although no
+// failure was injected, when the stand-in stored a different number of scans than
+// were acknowledged, or when the scan thread allocated from the heap at all (the
+// firmware's CONFIG_SCANNER_HEAP_CHECK).
+//
+//   soak_bench [-t seconds] [-r taps_per_s] [-k keyfobs] [-m single|json|binary]
+//              [-l latency_ms] [-J jitter_ms] [-f fail_pct] [-x drop_pct]
+//              [-u host:port] [-j]
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "rc522.h"
+#include "rc522_sim.h"
+#include "scan_debounce.h"
+#include "scan_queue.h"
+#include "scan_sched.h"
+#include "scan_wire.h"
+
+#ifndef SCANNER_VERSION
+#define SCANNER_VERSION           "unknown"
+#endif
+
+#define BENCH_DEFAULT_SECONDS     30
+#define BENCH_DEFAULT_TAPS_S      4
+#define BENCH_DEFAULT_KEYFOBS     200
+#define BENCH_DEFAULT_LATENCY_MS  20
+#define BENCH_READERS             2           // an "in" and an "out" reader, like a door
+#define BENCH_SPI_HZ              4000000
+#define BENCH_FRAME_OVERHEAD_NS   12000
+#define BENCH_CALL_OVERHEAD_NS    2000
+#define BENCH_DWELL_MIN_US        200000      // shortest time a keyfob is held up
+#define BENCH_DWELL_SPREAD_US     400000
+#define BENCH_GAP_MIN_US          100000      // between one keyfob leaving and the next
+#define BENCH_REPEAT_CHANCE       20          // % of taps by the keyfob that just left
+// A reader sees at most one keyfob every dwell plus gap, so about 2 taps/s, and -r
+// saturates at twice that
+#define BENCH_DRAIN_S             30          // after the last tap, for the backlog to clear
+#define BENCH_STACK_SIZE          (256 * 1024)
+#define BENCH_STACK_PAINT         0xA5
+#define BENCH_RTT_MAX             65536       // round trips kept for percentiles
+#define BENCH_DEVICE              "esp32-rfid-reader-soak"
+
+// As the firmware is configured by default
+#define BENCH_DEBOUNCE_MS         5000        // CONFIG_SCANNER_DEBOUNCE_MS
+#define BENCH_BATCH_MAX           8           // CONFIG_SCANNER_UPLOAD_BATCH_MAX
+#define BENCH_PROBE_FAST_US       50000       // CONFIG_SCANNER_IRQ_PROBE_INTERVAL_MS
+#define BENCH_PROBE_IDLE_US       250000      // CONFIG_SCANNER_PROBE_IDLE_MS
+#define BENCH_PROBE_HOLD_US       10000000    // CONFIG_SCANNER_PROBE_ACTIVE_S
+#define BENCH_SLEEP_MIN_US        20000       // PROBE_SLEEP_MIN_US
+#define HTTP_TIMEOUT_MS           5000        // main.c
+#define UPLOAD_RETRY_MS           1000        // main.c
+#define UID_HEX_LEN               (SCAN_UID_MAX * 3)
+
+typedef enum {
+    MODE_SINGLE = 0,            // PUT /api/druppel/init-keyfob per scan, no retry
+    MODE_JSON,                  // CONFIG_SCANNER_UPLOAD_BATCH
+    MODE_BINARY,                // ... with CONFIG_SCANNER_UPLOAD_BINARY
+} upload_mode_t;
+
+static const char *mode_names[] = {"single", "json", "binary"};
+
+typedef struct {
+    int seconds;
+    int taps_per_s;
+    int keyfobs;
+    upload_mode_t mode;
+    int latency_ms;
+    int jitter_ms;
+    int fail_pct;
+    int drop_pct;
+    char host[128];
+    uint16_t port;
+    bool remote;                // -u: no stand-in
+    bool json;
+} bench_config_t;
+
+static bench_config_t cfg = {
+    .seconds = BENCH_DEFAULT_SECONDS,
+    .taps_per_s = BENCH_DEFAULT_TAPS_S,
+    .keyfobs = BENCH_DEFAULT_KEYFOBS,
+    .mode = MODE_BINARY,
+    .latency_ms = BENCH_DEFAULT_LATENCY_MS,
+    .host = "127.0.0.1",
+};
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_us(int64_t us) {
+    if (us <= 0) return;
+    struct timespec ts = {us / 1000000, (us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static uint32_t rng(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    int64_t p50, p99, max;
+} bench_pct_t;
+
+// Sorts samples in place
+static bench_pct_t percentiles(int64_t *samples, int n) {
+    bench_pct_t p = {0};
+    if (n == 0) return p;
+    qsort(samples, n, sizeof(samples[0]), cmp_i64);
+    p.p50 = samples[n / 2];
+    p.p99 = samples[(n * 99) / 100];
+    p.max = samples[n - 1];
+    return p;
+}
+
+// Heap allocations per thread, counted by wrapping the allocator at link time
+static _Thread_local uint32_t thread_allocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    thread_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    thread_allocs++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    thread_allocs++;
+    return __real_realloc(p, size);
+}
+
+// Threads on painted stacks, so the deepest use can be read back afterwards
+typedef struct {
+    const char *name;
+    uint8_t *stack;
+    pthread_t thread;
+} bench_thread_t;
+
+static bool thread_start(bench_thread_t *t, const char *name, void *(*fn)(void *), void *arg) {
+    pthread_attr_t attr;
+    t->name = name;
+    t->stack = aligned_alloc(4096, BENCH_STACK_SIZE);
+    if (!t->stack) return false;
+    memset(t->stack, BENCH_STACK_PAINT, BENCH_STACK_SIZE);
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, t->stack, BENCH_STACK_SIZE);
+    bool ok = pthread_create(&t->thread, &attr, fn, arg) == 0;
+    pthread_attr_destroy(&attr);
+    return ok;
+}
+
+// The stack grows down, so the untouched paint is at the low end
+static size_t thread_stack_used(const bench_thread_t *t) {
+    size_t untouched = 0;
+    while (untouched < BENCH_STACK_SIZE && t->stack[untouched] == BENCH_STACK_PAINT) {
+        untouched++;
+    }
+    return BENCH_STACK_SIZE - untouched;
+}
+
+// Stand-in backend
+//
+// One keep-alive connection at a time, as the firmware has one HTTP client.
+// "Stored" counts the scans in every request that got a 2xx.
+
+typedef struct {
+    int listen_fd;
+    uint16_t port;
+    atomic_bool stop;
+    uint32_t rng_state;
+    uint32_t requests;
+    uint32_t stored;
+    uint32_t failed;            // answered 503 on purpose
+    uint32_t dropped;           // closed without an answer on purpose
+} stub_server_t;
+
+static stub_server_t server;
+
+static bool stub_listen(stub_server_t *s) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(addr);
+    int one = 1;
+
+    s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->listen_fd < 0) return false;
+    setsockopt(s->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(s->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(s->listen_fd, 4) != 0 ||
+        getsockname(s->listen_fd, (struct sockaddr *)&addr, &len) != 0) {
+        close(s->listen_fd);
+        return false;
+    }
+    s->port = ntohs(addr.sin_port);
+    return true;
+}
+
+static bool send_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Read one request or response head into buf and as much of the body as came with
+// it; returns the head length, 0 on EOF or error
+static size_t read_head(int fd, char *buf, size_t cap, size_t *have) {
+    *have = 0;
+    while (*have < cap - 1) {
+        ssize_t n = recv(fd, buf + *have, cap - 1 - *have, 0);
+        if (n <= 0) return 0;
+        *have += n;
+        buf[*have] = '\0';
+        char *end = strstr(buf, "\r\n\r\n");
+        if (end) return end + 4 - buf;
+    }
+    return 0;
+}
+
+static long header_long(const char *head, const char *name) {
+    const char *p = strcasestr(head, name);
+    return p ? strtol(p + strlen(name), NULL, 10) : 0;
+}
+
+static bool read_body(int fd, char *buf, size_t cap, size_t head_len, size_t have, long body_len) {
+    if (body_len < 0 || head_len + body_len >= cap) return false;
+    while ((long)(have - head_len) < body_len) {
+        ssize_t n = recv(fd, buf + have, head_len + body_len - have, 0);
+        if (n <= 0) return false;
+        have += n;
+    }
+    buf[head_len + body_len] = '\0';
+    return true;
+}
+
+static uint32_t count_scans(const char *path, const char *body, long len) {
+    if (strcmp(path, "/api/druppel/scans/binary") == 0) {
+        return len >= 2 && (uint8_t)body[0] == SCAN_WIRE_VERSION ? (uint8_t)body[1] : 0;
+    }
+    uint32_t n = 0;
+    for (const char *p = body; (p = strstr(p, "\"keyfob_key\"")) != NULL; p++) {
+        n++;
+    }
+    return n;
+}
+
+static bool stub_serve_one(stub_server_t *s, int fd) {
+    static char buf[64 * 1024];
+    char method[8], path[128], resp[256];
+    size_t have;
+
+    size_t head_len = read_head(fd, buf, sizeof(buf), &have);
+    if (head_len == 0 || sscanf(buf, "%7s %127s", method, path) != 2) return false;
+    long body_len = header_long(buf, "Content-Length:");
+    if (!read_body(fd, buf, sizeof(buf), head_len, have, body_len)) return false;
+    s->requests++;
+
+    int roll = rng(&s->rng_state) % 100;
+    if (roll < cfg.drop_pct) {
+        s->dropped++;
+        return false;
+    }
+    int64_t delay_ms = cfg.latency_ms;
+    if (cfg.jitter_ms > 0) delay_ms += (int)(rng(&s->rng_state) % (2 * cfg.jitter_ms + 1)) - cfg.jitter_ms;
+    sleep_us(delay_ms * 1000);
+
+    int status = 200;
+    uint32_t scans = 0;
+    if (roll < cfg.drop_pct + cfg.fail_pct) {
+        status = 503;
+        s->failed++;
+    } else if (strcmp(path, "/api/druppel/init-keyfob") == 0 ||
+               strcmp(path, "/api/druppel/scans/batch") == 0 ||
+               strcmp(path, "/api/druppel/scans/binary") == 0) {
+        scans = count_scans(path, buf + head_len, body_len);
+        s->stored += scans;
+    } else {
+        status = 404;
+    }
+
+    char body[64];
+    int blen = snprintf(body, sizeof(body), "{\"stored\":%lu}", (unsigned long)scans);
+    int len = snprintf(resp, sizeof(resp),
+        "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n"
+        "Connection: keep-alive\r\n\r\n%s",
+        status, status == 200 ? "OK" : status == 503 ? "Service Unavailable" : "Not Found", blen, body);
+    return send_all(fd, resp, len);
+}
+
+static void *stub_main(void *arg) {
+    stub_server_t *s = arg;
+    while (!atomic_load(&s->stop)) {
+        struct pollfd pfd = {.fd = s->listen_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 100) <= 0) continue;
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        while (!atomic_load(&s->stop)) {
+            pfd = (struct pollfd) {.fd = fd, .events = POLLIN};
+            int ready = poll(&pfd, 1, 100);
+            if (ready < 0 || (ready > 0 && !stub_serve_one(s, fd))) break;
+        }
+        close(fd);
+    }
+    close(s->listen_fd);
+    return NULL;
+}
+
+// Keep-alive HTTP/1.1 client, reconnecting after any error like esp_http_client
+typedef struct {
+    int fd;
+    uint32_t requests;
+    uint32_t failures;          // transport errors
+    int rtt_count;
+    int64_t rtt_us[BENCH_RTT_MAX];
+} http_client_t;
+
+static bool http_connect(http_client_t *c) {
+    char port[8];
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM}, *res;
+    snprintf(port, sizeof(port), "%u", cfg.port);
+    if (getaddrinfo(cfg.host, port, &hints, &res) != 0) return false;
+
+    c->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (c->fd >= 0) {
+        struct timeval tv = {HTTP_TIMEOUT_MS / 1000, (HTTP_TIMEOUT_MS % 1000) * 1000};
+        int one = 1;
+        setsockopt(c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(c->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(c->fd, res->ai_addr, res->ai_addrlen) != 0) {
+            close(c->fd);
+            c->fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return c->fd >= 0;
+}
+
+// Returns the status code, or -1 on a transport error
+static int http_send(http_client_t *c, const char *method, const char *path, const char *type,
+                     const void *body, size_t len) {
+    static char buf[8192];
+    int64_t start = now_us();
+    size_t have;
+
+    c->requests++;
+    int head = snprintf(buf, sizeof(buf),
+        "%s %s HTTP/1.1\r\nHost: %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+        method, path, cfg.host, type, len);
+    bool ok = (c->fd >= 0 || http_connect(c)) && send_all(c->fd, buf, head) && send_all(c->fd, body, len);
+
+    int status = -1;
+    size_t head_len = ok ? read_head(c->fd, buf, sizeof(buf), &have) : 0;
+    if (head_len > 0 && sscanf(buf, "HTTP/1.%*d %d", &status) == 1 &&
+        read_body(c->fd, buf, sizeof(buf), head_len, have, header_long(buf, "Content-Length:"))) {
+        if (strcasestr(buf, "Connection: close")) {
+            close(c->fd);
+            c->fd = -1;
+        }
+    } else {
+        status = -1;
+        c->failures++;
+        if (c->fd >= 0) close(c->fd);
+        c->fd = -1;
+    }
+    if (c->rtt_count < BENCH_RTT_MAX) c->rtt_us[c->rtt_count++] = now_us() - start;
+    return status;
+}
+
+// Taps, by scan sequence number
+typedef struct {
+    int64_t tap_us;             // keyfob entered the field
+    int64_t queued_us;
+    int64_t acked_us;           // 0 until the backend took it
+} bench_tap_t;
+
+static bench_tap_t *taps;
+static int taps_cap;
+static sem_t upload_sem;
+static atomic_bool scan_done;
+static int64_t bench_start_us;
+// Sequence numbers start at 0 every run, like a scanner without the journal after a
+// boot; a fresh epoch keeps a real backend from dropping them as repeats
+static uint32_t bench_epoch;
+
+typedef struct {
+    rc522_sim_t sim;
+    rc522_t dev;
+    bool card_present;
+    // Traffic
+    bool in_field;
+    int fob;
+    int64_t arrive_us;
+    int64_t leave_us;
+    int64_t next_arrive_us;
+    bool detected;              // a scan has seen the keyfob in the field
+} bench_reader_t;
+
+typedef struct {
+    uint32_t arrivals;
+    uint32_t detected;
+    uint32_t queued;
+    uint32_t queue_full;
+    uint32_t probes;
+    uint32_t allocs;
+} scan_stats_t;
+
+typedef struct {
+    uint32_t acked;
+    uint32_t rejected;          // 4xx: the firmware drops the batch
+    uint32_t lost;              // single mode drops a scan whose request failed
+    uint32_t batches;
+    uint32_t allocs;
+    int64_t encode_us;
+} upload_stats_t;
+
+static bench_reader_t readers[BENCH_READERS];
+static scan_stats_t scan_stats;
+static upload_stats_t upload_stats;
+static http_client_t http = {.fd = -1};
+
+static void fob_uid(int fob, uint8_t *uid, uint8_t *len, uint8_t *sak) {
+    // Every fourth keyfob has a double size UID
+    if (fob % 4 == 3) {
+        uint8_t u[7] = {0x04, 0xB0, fob >> 8, fob & 0xFF, 0x5A, 0x21, 0x80};
+        memcpy(uid, u, sizeof(u));
+        *len = 7;
+        *sak = 0x00;
+    } else {
+        uint8_t u[4] = {0xB0, fob >> 8, fob & 0xFF, 0x5A};
+        memcpy(uid, u, sizeof(u));
+        *len = 4;
+        *sak = 0x08;
+    }
+}
+
+// Move keyfobs in and out of the field up to now
+static void traffic_update(bench_reader_t *r, int64_t now, uint32_t *rng_state) {
+    int64_t mean_gap_us = (int64_t)1000000 * BENCH_READERS / cfg.taps_per_s;
+
+    if (r->in_field && r->leave_us <= now) {
+        rc522_sim_clear_tags(&r->sim);
+        r->in_field = false;
+        r->next_arrive_us = r->arrive_us + rng(rng_state) % (2 * mean_gap_us);
+        if (r->next_arrive_us < r->leave_us + BENCH_GAP_MIN_US) {
+            r->next_arrive_us = r->leave_us + BENCH_GAP_MIN_US;
+        }
+    }
+    if (!r->in_field && r->next_arrive_us <= now) {
+        uint8_t uid[SCAN_UID_MAX], len, sak;
+        if ((int)(rng(rng_state) % 100) >= BENCH_REPEAT_CHANCE) {
+            r->fob = rng(rng_state) % cfg.keyfobs;
+        }
+        fob_uid(r->fob, uid, &len, &sak);
+        rc522_sim_add_tag(&r->sim, uid, len, sak);
+        r->in_field = true;
+        r->detected = false;
+        // Taps land between probes; the latency counts from when the keyfob arrived
+        r->arrive_us = r->next_arrive_us;
+        r->leave_us = r->arrive_us + BENCH_DWELL_MIN_US + rng(rng_state) % BENCH_DWELL_SPREAD_US;
+        scan_stats.arrivals++;
+    }
+}
+
+// Mirrors reader_scan() in main.c, minus logging and telemetry
+static void reader_scan(bench_reader_t *r, int index, uint32_t *scan_seq) {
+    rc522_uid_t tags[RC522_MAX_TAGS];
+    int tag_count = rc522_scan_tags(&r->dev, tags, RC522_MAX_TAGS);
+
+    for (int t = 0; t < tag_count; t++) {
+        int64_t now = now_us();
+        if (r->in_field && !r->detected) {
+            r->detected = true;
+            scan_stats.detected++;
+        }
+        if (!scan_debounce_check(index, tags[t].bytes, tags[t].size, now, NULL)) {
+            continue;
+        }
+        if ((int)*scan_seq >= taps_cap) {
+            continue;
+        }
+        scan_record_t rec = {
+            .seq = (*scan_seq)++,
+            .timestamp_ms = (now - bench_start_us) / 1000,
+            .direction = index == 0 ? SCAN_DIR_IN : SCAN_DIR_OUT,
+            .facility_id = 1,
+            .reader = index,
+            .uid_len = tags[t].size,
+        };
+        memcpy(rec.uid, tags[t].bytes, tags[t].size);
+        taps[rec.seq].tap_us = r->arrive_us;
+        taps[rec.seq].queued_us = now_us();
+        if (scan_queue_push(&rec)) {
+            scan_stats.queued++;
+            sem_post(&upload_sem);
+        } else {
+            scan_stats.queue_full++;
+        }
+    }
+}
+
+static void *scan_main(void *arg) {
+    rc522_t *devs[BENCH_READERS];
+    bool present[BENCH_READERS];
+    uint32_t rng_state = 0x2545F491;
+    uint32_t scan_seq = 0;
+    scan_sched_t sched;
+    scan_sched_config_t sched_cfg = {
+        .fast_us = BENCH_PROBE_FAST_US,
+        .idle_us = BENCH_PROBE_IDLE_US,
+        .hold_us = BENCH_PROBE_HOLD_US,
+        .sleep_min_us = BENCH_SLEEP_MIN_US,
+        .settle_us = RC522_FIELD_SETTLE_US,
+    };
+    int64_t end_us = bench_start_us + (int64_t)cfg.seconds * 1000000;
+
+    for (int i = 0; i < BENCH_READERS; i++) {
+        devs[i] = &readers[i].dev;
+        readers[i].next_arrive_us = bench_start_us + rng(&rng_state) % 1000000;
+    }
+    scan_debounce_init((int64_t)BENCH_DEBOUNCE_MS * 1000);
+    scan_sched_init(&sched, &sched_cfg, now_us());
+
+    int64_t now = now_us();
+    while (now < end_us) {
+        int64_t sim_start[BENCH_READERS], sim_wall[BENCH_READERS];
+        for (int i = 0; i < BENCH_READERS; i++) {
+            traffic_update(&readers[i], now, &rng_state);
+            sim_start[i] = rc522_sim_now_us(&readers[i].sim);
+            sim_wall[i] = now;
+        }
+
+        scan_sched_probe(&sched, now);
+        rc522_probe_all(devs, BENCH_READERS, present);
+        scan_stats.probes++;
+
+        bool any_present = false;
+        for (int i = 0; i < BENCH_READERS; i++) {
+            bench_reader_t *r = &readers[i];
+            any_present |= present[i];
+            if (present[i] && !r->card_present) {
+                r->card_present = true;
+                reader_scan(r, i, &scan_seq);
+            } else if (!present[i]) {
+                r->card_present = false;
+            }
+        }
+
+        // The simulated readers took no wall time; sleep out what they would have
+        int64_t busy_us = 0;
+        for (int i = 0; i < BENCH_READERS; i++) {
+            int64_t used = rc522_sim_now_us(&readers[i].sim) - sim_start[i];
+            if (used > busy_us) busy_us = used;
+        }
+        sleep_us(busy_us);
+
+        now = now_us();
+        int64_t wait_us = scan_sched_next(&sched, any_present, now);
+        if (scan_sched_should_sleep(&sched, wait_us)) {
+            for (int i = 0; i < BENCH_READERS; i++) rc522_power_down(devs[i], true);
+            scan_sched_power(&sched, false, now_us());
+            sleep_us(wait_us - RC522_FIELD_SETTLE_US);
+            for (int i = 0; i < BENCH_READERS; i++) rc522_power_down(devs[i], false);
+            scan_sched_power(&sched, true, now_us());
+            sleep_us(RC522_FIELD_SETTLE_US);
+        } else {
+            sleep_us(wait_us);
+        }
+        now = now_us();
+        // ... and move their clocks on by the wall time that passed without them
+        for (int i = 0; i < BENCH_READERS; i++) {
+            int64_t idle_us = now - sim_wall[i] - (rc522_sim_now_us(&readers[i].sim) - sim_start[i]);
+            if (idle_us > 0) rc522_sim_idle(&readers[i].sim, idle_us);
+        }
+    }
+
+    scan_stats.allocs = thread_allocs;
+    atomic_store(&scan_done, true);
+    sem_post(&upload_sem);
+    return NULL;
+}
+
+static void uid_to_hex(const uint8_t *uid, uint8_t len, char *out) {
+    static const char hex[] = "0123456789ABCDEF";
+    char *p = out;
+    for (int i = 0; i < len; i++) {
+        if (i) *p++ = ':';
+        *p++ = hex[uid[i] >> 4];
+        *p++ = hex[uid[i] & 0x0F];
+    }
+    *p = '\0';
+}
+
+// The request send_scan_to_backend() or send_batch_to_backend() makes; returns the
+// status, or -1 on a transport error
+static int upload_send(const scan_record_t *recs, int count) {
+    static char payload[96 + BENCH_BATCH_MAX * 128];
+    char uid_hex[UID_HEX_LEN];
+    int64_t encode_start = now_us();
+    int64_t now_ms = (encode_start - bench_start_us) / 1000;
+    const char *method = "POST", *path, *type = "application/json";
+    int len;
+
+    switch (cfg.mode) {
+    case MODE_SINGLE:
+        uid_to_hex(recs[0].uid, recs[0].uid_len, uid_hex);
+        len = snprintf(payload, sizeof(payload), "{\"keyfob_key\":\"%s\",\"device\":\"%s\",\"timestamp\":%lld}",
+            uid_hex, BENCH_DEVICE, (long long)recs[0].timestamp_ms);
+        method = "PUT";
+        path = "/api/druppel/init-keyfob";
+        break;
+    case MODE_JSON:
+        len = snprintf(payload, sizeof(payload), "{\"device\":\"%s\",\"epoch\":%lu,\"now\":%lld,\"scans\":[",
+            BENCH_DEVICE, (unsigned long)bench_epoch, (long long)now_ms);
+        for (int i = 0; i < count; i++) {
+            uid_to_hex(recs[i].uid, recs[i].uid_len, uid_hex);
+            len += snprintf(payload + len, sizeof(payload) - len,
+                "%s{\"keyfob_key\":\"%s\",\"location_id\":%d,\"inout\":\"%s\",\"timestamp\":%lld,\"seq\":%lu}",
+                i ? "," : "", uid_hex, recs[i].facility_id,
+                recs[i].direction == SCAN_DIR_OUT ? "out" : "in",
+                (long long)recs[i].timestamp_ms, (unsigned long)recs[i].seq);
+        }
+        len += snprintf(payload + len, sizeof(payload) - len, "]}");
+        path = "/api/druppel/scans/batch";
+        break;
+    default:
+        len = scan_wire_encode_batch((uint8_t *)payload, sizeof(payload), BENCH_DEVICE, bench_epoch,
+            now_ms, recs, count);
+        path = "/api/druppel/scans/binary";
+        type = "application/octet-stream";
+        break;
+    }
+    upload_stats.encode_us += now_us() - encode_start;
+    upload_stats.batches++;
+    return http_send(&http, method, path, type, payload, len);
+}
+
+static void upload_ack(const scan_record_t *recs, int count) {
+    int64_t now = now_us();
+    for (int i = 0; i < count; i++) {
+        taps[recs[i].seq].acked_us = now;
+    }
+    upload_stats.acked += count;
+}
+
+// Mirrors upload_task() in main.c without the journal: keep the batch while the
+// backend fails, top it up with whatever the reader queued meanwhile
+static void *upload_main(void *arg) {
+    scan_record_t pending[BENCH_BATCH_MAX];
+    int batch_max = cfg.mode == MODE_SINGLE ? 1 : BENCH_BATCH_MAX;
+    int count = 0;
+    int64_t give_up_us = bench_start_us + (int64_t)(cfg.seconds + BENCH_DRAIN_S) * 1000000;
+
+    while (now_us() < give_up_us) {
+        while (count < batch_max && scan_queue_pop(&pending[count])) {
+            count++;
+        }
+        if (count == 0) {
+            if (atomic_load(&scan_done)) break;
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100000000;
+            if (ts.tv_nsec >= 1000000000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000;
+            }
+            sem_timedwait(&upload_sem, &ts);
+            continue;
+        }
+
+        int status = upload_send(pending, count);
+        if (status >= 200 && status < 300) {
+            upload_ack(pending, count);
+            count = 0;
+        } else if (cfg.mode == MODE_SINGLE) {
+            // send_scan_to_backend() logs the failure and moves on
+            upload_stats.lost += count;
+            count = 0;
+        } else if (status >= 400 && status < 500) {
+            upload_stats.rejected += count;
+            count = 0;
+        } else {
+            sleep_us((int64_t)UPLOAD_RETRY_MS * 1000);
+        }
+    }
+    upload_stats.allocs = thread_allocs;
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-t seconds] [-r taps_per_s] [-k keyfobs] [-m single|json|binary]\n"
+        "       [-l latency_ms] [-J jitter_ms] [-f fail_pct] [-x drop_pct] [-u host:port] [-j]\n", prog);
+}
+
+static bool parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(a, "-j") == 0) {
+            cfg.json = true;
+            continue;
+        }
+        if (!v) return false;
+        i++;
+        if (strcmp(a, "-t") == 0) cfg.seconds = atoi(v);
+        else if (strcmp(a, "-r") == 0) cfg.taps_per_s = atoi(v);
+        else if (strcmp(a, "-k") == 0) cfg.keyfobs = atoi(v);
+        else if (strcmp(a, "-l") == 0) cfg.latency_ms = atoi(v);
+        else if (strcmp(a, "-J") == 0) cfg.jitter_ms = atoi(v);
+        else if (strcmp(a, "-f") == 0) cfg.fail_pct = atoi(v);
+        else if (strcmp(a, "-x") == 0) cfg.drop_pct = atoi(v);
+        else if (strcmp(a, "-m") == 0) {
+            int m = 0;
+            while (m < 3 && strcmp(v, mode_names[m]) != 0) m++;
+            if (m == 3) return false;
+            cfg.mode = m;
+        } else if (strcmp(a, "-u") == 0) {
+            const char *colon = strrchr(v, ':');
+            if (!colon || colon == v || (size_t)(colon - v) >= sizeof(cfg.host)) return false;
+            memcpy(cfg.host, v, colon - v);
+            cfg.host[colon - v] = '\0';
+            cfg.port = atoi(colon + 1);
+            cfg.remote = true;
+        } else {
+            return false;
+        }
+    }
+    return cfg.seconds > 0 && cfg.taps_per_s > 0 && cfg.keyfobs > 0 && cfg.keyfobs <= 0xFFFF &&
+        cfg.latency_ms >= 0 && cfg.jitter_ms >= 0 && cfg.jitter_ms <= cfg.latency_ms &&
+        cfg.fail_pct >= 0 && cfg.drop_pct >= 0 && cfg.fail_pct + cfg.drop_pct <= 100;
+}
+
+int main(int argc, char **argv) {
+    if (!parse_args(argc, argv)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    taps_cap = cfg.taps_per_s * cfg.seconds * 2 + 1024;
+    taps = calloc(taps_cap, sizeof(bench_tap_t));
+    if (!taps) return 1;
+    sem_init(&upload_sem, 0, 0);
+
+    // The driver logs to stdout; keep it out of the JSON
+    int saved_stdout = -1;
+    if (cfg.json) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        fflush(stdout);
+        saved_stdout = dup(STDOUT_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
+    for (int i = 0; i < BENCH_READERS; i++) {
+        rc522_sim_config_t sim_cfg = {
+            .spi_hz = BENCH_SPI_HZ,
+            .frame_overhead_ns = BENCH_FRAME_OVERHEAD_NS,
+            .call_overhead_ns = BENCH_CALL_OVERHEAD_NS,
+            .irq_wired = true,
+        };
+        rc522_sim_init(&readers[i].sim, &sim_cfg);
+        if (!rc522_init(&readers[i].dev, rc522_sim_hal(&readers[i].sim))) {
+            fprintf(stderr, "driver init against the simulator failed\n");
+            return 1;
+        }
+    }
+
+    bench_thread_t server_thread = {0}, scan_thread, upload_thread;
+    if (!cfg.remote) {
+        server.rng_state = 0x9E3779B9;
+        if (!stub_listen(&server) || !thread_start(&server_thread, "server", stub_main, &server)) {
+            fprintf(stderr, "stand-in backend did not start\n");
+            return 1;
+        }
+        cfg.port = server.port;
+    }
+
+    bench_start_us = now_us();
+    bench_epoch = (uint32_t)(bench_start_us ^ getpid()) | 1;
+    if (!thread_start(&upload_thread, "upload", upload_main, NULL) ||
+        !thread_start(&scan_thread, "scan", scan_main, NULL)) {
+        fprintf(stderr, "threads did not start\n");
+        return 1;
+    }
+    pthread_join(scan_thread.thread, NULL);
+    pthread_join(upload_thread.thread, NULL);
+    int64_t elapsed_us = now_us() - bench_start_us;
+    if (!cfg.remote) {
+        atomic_store(&server.stop, true);
+        pthread_join(server_thread.thread, NULL);
+    }
+
+    // Latencies of the queued taps
+    int queued = scan_stats.queued;
+    int64_t *to_queue = malloc(sizeof(int64_t) * (queued + 1));
+    int64_t *to_ack = malloc(sizeof(int64_t) * (queued + 1));
+    int acked = 0, queued_n = 0;
+    int64_t last_ack_us = bench_start_us;
+    for (int s = 0; s < taps_cap && taps[s].queued_us; s++) {
+        to_queue[queued_n++] = taps[s].queued_us - taps[s].tap_us;
+        if (taps[s].acked_us) {
+            to_ack[acked++] = taps[s].acked_us - taps[s].tap_us;
+            if (taps[s].acked_us > last_ack_us) last_ack_us = taps[s].acked_us;
+        }
+    }
+    bench_pct_t pq = percentiles(to_queue, queued_n);
+    bench_pct_t pa = percentiles(to_ack, acked);
+    bench_pct_t pr = percentiles(http.rtt_us, http.rtt_count);
+    // Over the tap period plus however long the last acknowledgement took
+    double active_s = (last_ack_us - bench_start_us) / 1e6;
+    double scans_per_s = active_s > 0 ? upload_stats.acked / active_s : 0;
+    int unacked = scan_stats.queued - upload_stats.acked - upload_stats.rejected - upload_stats.lost;
+    scan_queue_stats_t qs = scan_queue_stats();
+    scan_debounce_stats_t ds = scan_debounce_stats();
+
+    long arena = -1, in_use = -1, free_in_arena = -1;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 mi = mallinfo2();
+    arena = mi.arena;
+    in_use = mi.uordblks;
+    free_in_arena = mi.fordblks;
+#endif
+    double allocs_per_scan = scan_stats.queued ? (double)scan_stats.allocs / scan_stats.queued : 0;
+    double allocs_per_request = http.requests ? (double)upload_stats.allocs / http.requests : 0;
+    size_t stack_scan = thread_stack_used(&scan_thread);
+    size_t stack_upload = thread_stack_used(&upload_thread);
+    size_t stack_server = cfg.remote ? 0 : thread_stack_used(&server_thread);
+
+    if (cfg.json) {
+        fflush(stdout);
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        printf("{\"bench\":\"soak\",\"version\":\"%s\",\"mode\":\"%s\",\"seconds\":%d,\"readers\":%d,"
+            "\"taps_per_s\":%d,\"keyfobs\":%d,"
+            "\"inject\":{\"latency_ms\":%d,\"jitter_ms\":%d,\"fail_pct\":%d,\"drop_pct\":%d,\"remote\":%s},"
+            "\"taps\":%lu,\"detected\":%lu,\"suppressed\":%lu,\"queued\":%lu,\"queue_full\":%lu,"
+            "\"queue_high_water\":%lu,\"acked\":%lu,\"rejected\":%lu,\"lost\":%lu,\"unacked\":%d,"
+            "\"scans_per_s\":%.3f,\"probes_per_s\":%.2f,"
+            "\"tap_to_queue_ms\":{\"p50\":%.2f,\"p99\":%.2f,\"max\":%.2f},"
+            "\"tap_to_ack_ms\":{\"p50\":%.2f,\"p99\":%.2f,\"max\":%.2f},"
+            "\"http\":{\"requests\":%lu,\"failures\":%lu,\"rtt_ms\":{\"p50\":%.2f,\"p99\":%.2f,\"max\":%.2f},"
+            "\"encode_us\":%.2f},"
+            "\"heap\":{\"allocs_per_scan\":%.3f,\"allocs_per_request\":%.3f,\"arena_bytes\":%ld,"
+            "\"in_use_bytes\":%ld,\"free_in_arena_bytes\":%ld},"
+            "\"stack_used_bytes\":{\"scan\":%zu,\"upload\":%zu,\"server\":%zu},"
+            "\"server\":{\"requests\":%lu,\"stored\":%lu,\"failed\":%lu,\"dropped\":%lu}}\n",
+            SCANNER_VERSION, mode_names[cfg.mode], cfg.seconds, BENCH_READERS, cfg.taps_per_s, cfg.keyfobs,
+            cfg.latency_ms, cfg.jitter_ms, cfg.fail_pct, cfg.drop_pct, cfg.remote ? "true" : "false",
+            (unsigned long)scan_stats.arrivals, (unsigned long)scan_stats.detected,
+            (unsigned long)ds.suppressed, (unsigned long)scan_stats.queued,
+            (unsigned long)scan_stats.queue_full, (unsigned long)qs.high_water,
+            (unsigned long)upload_stats.acked, (unsigned long)upload_stats.rejected,
+            (unsigned long)upload_stats.lost, unacked,
+            scans_per_s, scan_stats.probes / (cfg.seconds * 1.0),
+            pq.p50 / 1e3, pq.p99 / 1e3, pq.max / 1e3, pa.p50 / 1e3, pa.p99 / 1e3, pa.max / 1e3,
+            (unsigned long)http.requests, (unsigned long)http.failures,
+            pr.p50 / 1e3, pr.p99 / 1e3, pr.max / 1e3,
+            upload_stats.batches ? (double)upload_stats.encode_us / upload_stats.batches : 0.0,
+            allocs_per_scan, allocs_per_request, arena, in_use, free_in_arena,
+            stack_scan, stack_upload, stack_server,
+            (unsigned long)server.requests, (unsigned long)server.stored,
+            (unsigned long)server.failed, (unsigned long)server.dropped);
+    } else {
+        printf("\nsoak %s: %d s, %d readers, %d taps/s over %d keyfobs, %s uploads\n", SCANNER_VERSION,
+            cfg.seconds, BENCH_READERS, cfg.taps_per_s, cfg.keyfobs, mode_names[cfg.mode]);
+        if (cfg.remote) {
+            printf("backend %s:%u\n", cfg.host, cfg.port);
+        } else {
+            printf("stand-in: %d +- %d ms, %d%% 503, %d%% dropped\n", cfg.latency_ms, cfg.jitter_ms,
+                cfg.fail_pct, cfg.drop_pct);
+        }
+        printf("taps %lu, detected %lu, suppressed %lu, queued %lu (high-water %lu, %lu full)\n",
+            (unsigned long)scan_stats.arrivals, (unsigned long)scan_stats.detected,
+            (unsigned long)ds.suppressed, (unsigned long)scan_stats.queued,
+            (unsigned long)qs.high_water, (unsigned long)scan_stats.queue_full);
+        printf("acked %lu, rejected %lu, lost %lu, unacked %d: %.2f scans/s over %.1f s\n",
+            (unsigned long)upload_stats.acked, (unsigned long)upload_stats.rejected,
+            (unsigned long)upload_stats.lost, unacked, scans_per_s, elapsed_us / 1e6);
+        printf("%-14s %9s %9s %9s\n", "ms", "p50", "p99", "max");
+        printf("%-14s %9.2f %9.2f %9.2f\n", "tap to queue", pq.p50 / 1e3, pq.p99 / 1e3, pq.max / 1e3);
+        printf("%-14s %9.2f %9.2f %9.2f\n", "tap to ack", pa.p50 / 1e3, pa.p99 / 1e3, pa.max / 1e3);
+        printf("%-14s %9.2f %9.2f %9.2f\n", "http rtt", pr.p50 / 1e3, pr.p99 / 1e3, pr.max / 1e3);
+        printf("http: %lu requests, %lu transport failures; server stored %lu, 503 %lu, dropped %lu\n",
+            (unsigned long)http.requests, (unsigned long)http.failures, (unsigned long)server.stored,
+            (unsigned long)server.failed, (unsigned long)server.dropped);
+        printf("heap: %.3f allocs per scan (scan), %.3f per request (upload); arena %ld, in use %ld, free in arena %ld\n",
+            allocs_per_scan, allocs_per_request, arena, in_use, free_in_arena);
+        printf("stack used: scan %zu, upload %zu, server %zu bytes\n", stack_scan, stack_upload, stack_server);
+    }
+
+    int failures = 0;
+    if (unacked > 0 && !cfg.remote && cfg.fail_pct == 0 && cfg.drop_pct == 0) {
+        fprintf(stderr, "%d scans were never acknowledged\n", unacked);
+        failures++;
+    }
+    if (scan_stats.allocs > 0) {
+        fprintf(stderr, "scan thread made %lu heap allocations\n", (unsigned long)scan_stats.allocs);
+        failures++;
+    }
+    if (!cfg.remote && server.stored != upload_stats.acked) {
+        fprintf(stderr, "stand-in stored %lu scans, %lu were acknowledged\n",
+            (unsigned long)server.stored, (unsigned long)upload_stats.acked);
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,132 @@
+// Upload encoding benchmark: JSON batch vs the binary format in scan_wire.h
+//
+// Encodes the same batches both ways and reports bytes per scan and host time per
+// scan. The JSON side repeats what send_batch_to_backend() in main.c builds.
+//
+//   wire_bench [-n iterations]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "scan_wire.h"
+
+#define BENCH_DEFAULT_ITERATIONS  20000
+#define BENCH_DEVICE              "esp32-rfid-reader-246f28a1b2c3"
+#define BENCH_EPOCH               0x5eed0001u
+#define BENCH_BUF_LEN             8192
+#define UID_HEX_LEN               (SCAN_UID_MAX * 3)
+
+typedef struct {
+    const char *name;
+    int count;
+    int uid_len;
+} bench_scenario_t;
+
+static const bench_scenario_t scenarios[] = {
+    {"1 x 4-byte", 1, 4},
+    {"8 x 4-byte", 8, 4},
+    {"8 x 7-byte", 8, 7},
+    {"32 x 4-byte", 32, 4},
+};
+
+static int64_t wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void uid_to_hex(const uint8_t *uid, uint8_t len, char *out) {
+    static const char hex[] = "0123456789ABCDEF";
+    char *p = out;
+    for (int i = 0; i < len; i++) {
+        if (i) *p++ = ':';
+        *p++ = hex[uid[i] >> 4];
+        *p++ = hex[uid[i] & 0x0F];
+    }
+    *p = '\0';
+}
+
+static int encode_json(char *payload, size_t cap, const scan_record_t *recs, int count, int64_t now_ms) {
+    char uid_hex[UID_HEX_LEN];
+    int len = snprintf(payload, cap, "{\"device\":\"%s\",\"epoch\":%lu,\"now\":%lld,\"scans\":[",
+        BENCH_DEVICE, (unsigned long)BENCH_EPOCH, (long long)now_ms);
+    for (int i = 0; i < count; i++) {
+        uid_to_hex(recs[i].uid, recs[i].uid_len, uid_hex);
+        len += snprintf(payload + len, cap - len,
+            "%s{\"keyfob_key\":\"%s\",\"location_id\":%d,\"inout\":\"%s\",\"%s\":%lld,\"seq\":%lu%s}",
+            i ? "," : "", uid_hex, recs[i].facility_id,
+            recs[i].direction == SCAN_DIR_OUT ? "out" : "in",
+            (recs[i].flags & SCAN_FLAG_UNIX_TIME) ? "time" : "timestamp",
+            (long long)recs[i].timestamp_ms, (unsigned long)recs[i].seq,
+            !(recs[i].flags & SCAN_FLAG_DECIDED) ? "" :
+            (recs[i].flags & SCAN_FLAG_GRANTED) ? ",\"granted\":true" : ",\"granted\":false");
+    }
+    len += snprintf(payload + len, cap - len, "]}");
+    return len < (int)cap ? len : 0;
+}
+
+static void make_batch(scan_record_t *recs, const bench_scenario_t *sc) {
+    for (int i = 0; i < sc->count; i++) {
+        scan_record_t *rec = &recs[i];
+        memset(rec, 0, sizeof(*rec));
+        rec->seq = 100000 + i;
+        rec->timestamp_ms = 1761000000000LL + i * 1500;
+        rec->flags = SCAN_FLAG_UNIX_TIME | SCAN_FLAG_DECIDED | (i % 3 ? SCAN_FLAG_GRANTED : 0);
+        rec->direction = i % 2 ? SCAN_DIR_OUT : SCAN_DIR_IN;
+        rec->facility_id = 3;
+        rec->reader = i % 2;
+        rec->uid_len = sc->uid_len;
+        for (int b = 0; b < sc->uid_len; b++) {
+            rec->uid[b] = (uint8_t)(0x11 * (b + 1) + i);
+        }
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n iterations]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    static uint8_t buf[BENCH_BUF_LEN];
+    static scan_record_t recs[32];
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (iterations <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("%-12s %-6s %8s %10s %12s\n", "batch", "format", "bytes", "bytes/scan", "ns/scan");
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        const bench_scenario_t *sc = &scenarios[s];
+        make_batch(recs, sc);
+
+        for (int binary = 0; binary < 2; binary++) {
+            int len = 0;
+            int64_t start = wall_ns();
+            for (int it = 0; it < iterations; it++) {
+                if (binary) {
+                    len = scan_wire_encode_batch(buf, sizeof(buf), BENCH_DEVICE, BENCH_EPOCH, it, recs, sc->count);
+                } else {
+                    len = encode_json((char *)buf, sizeof(buf), recs, sc->count, it);
+                }
+            }
+            int64_t elapsed = wall_ns() - start;
+            if (len == 0) {
+                fprintf(stderr, "%s did not fit in %d bytes\n", sc->name, BENCH_BUF_LEN);
+                return 1;
+            }
+            printf("%-12s %-6s %8d %10.1f %12.1f\n", sc->name, binary ? "binary" : "json",
+                len, (double)len / sc->count, (double)elapsed / iterations / sc->count);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,324 @@
+// Allowlist cache
+//
+// The active keyfobs are kept as a sorted array of fixed-size UID entries, so a tap
+// is decided with one binary search in RAM. The upload task refreshes the table from
+// /api/druppel/allowlist: the backend answers with the changes since our version, or
+// the whole list when we are too far behind or it has restarted (new epoch). After
+// every applied response the table is written to NVS, so a reboot without network
+// still opens the gate for everyone who was allowed before.
+//
+// Lookups may come from any task; only one task may call access_cache_apply().
+#include "sdkconfig.h"
+#ifdef CONFIG_SCANNER_ACCESS_CACHE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "access_cache.h"
+#include "mem_budget.h"
+#include "scan_log.h"
+
+#define ACCESS_MAX            CONFIG_SCANNER_ACCESS_CACHE_MAX
+#define ACCESS_UID_MAX        10          // triple size UID
+#define ACCESS_EPOCH_LEN      24
+#define ACCESS_NVS_NAMESPACE  "access"
+#define ACCESS_NVS_UIDS       "uids"
+#define ACCESS_NVS_VERSION    "version"
+#define ACCESS_NVS_EPOCH      "epoch"
+
+// Zero-padded so entries compare with memcmp; shorter UIDs sort first
+typedef struct {
+    uint8_t len;
+    uint8_t uid[ACCESS_UID_MAX];
+} access_entry_t;
+
+static access_entry_t table[ACCESS_MAX];
+static uint32_t count;
+static uint32_t version;
+static char epoch[ACCESS_EPOCH_LEN];
+static bool synced;
+static bool truncated;          // last response had more keys than fit
+
+static SemaphoreHandle_t lock;
+static StaticSemaphore_t lock_buf;
+static nvs_handle_t nvs;
+static bool nvs_open_ok;
+
+static access_cache_stats_t stats;
+
+static int entry_cmp(const void *a, const void *b) {
+    return memcmp(a, b, sizeof(access_entry_t));
+}
+
+// Index of the entry, or of where it would go, in *pos; true when found
+static bool table_find(const access_entry_t *e, uint32_t *pos) {
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int c = entry_cmp(&table[mid], e);
+        if (c == 0) {
+            *pos = mid;
+            return true;
+        }
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *pos = lo;
+    return false;
+}
+
+static void table_insert(const access_entry_t *e) {
+    uint32_t pos;
+    if (table_find(e, &pos)) return;
+    if (count >= ACCESS_MAX) {
+        truncated = true;
+        return;
+    }
+    memmove(&table[pos + 1], &table[pos], (count - pos) * sizeof(access_entry_t));
+    table[pos] = *e;
+    count++;
+}
+
+static void table_remove(const access_entry_t *e) {
+    uint32_t pos;
+    if (!table_find(e, &pos)) return;
+    memmove(&table[pos], &table[pos + 1], (count - pos - 1) * sizeof(access_entry_t));
+    count--;
+}
+
+// "AA:BB:CC:DD" or "AABBCCDD"; only 4, 7 and 10 byte UIDs exist
+static bool parse_uid(const char *s, size_t len, access_entry_t *e) {
+    memset(e, 0, sizeof(*e));
+    int nibbles = 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = s[i];
+        int v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c == ':' || c == '-' || c == ' ') continue;
+        else return false;
+        if (nibbles / 2 >= ACCESS_UID_MAX) return false;
+        e->uid[nibbles / 2] = (e->uid[nibbles / 2] << 4) | v;
+        nibbles++;
+    }
+    e->len = nibbles / 2;
+    return (nibbles % 2) == 0 && (e->len == 4 || e->len == 7 || e->len == 10);
+}
+
+// Minimal readers for the flat allowlist response. The backend builds it, so there
+// are no nested objects and no escapes in the strings we care about.
+static const char *json_value(const char *body, const char *key) {
+    char pattern[24];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    const char *p = strstr(body, pattern);
+    if (!p) return NULL;
+    p += strlen(pattern);
+    while (*p == ' ') p++;
+    if (*p++ != ':') return NULL;
+    while (*p == ' ') p++;
+    return p;
+}
+
+static bool json_u32(const char *body, const char *key, uint32_t *out) {
+    const char *p = json_value(body, key);
+    if (!p || *p < '0' || *p > '9') return false;
+    *out = strtoul(p, NULL, 10);
+    return true;
+}
+
+static bool json_str(const char *body, const char *key, char *out, size_t len) {
+    const char *p = json_value(body, key);
+    if (!p || *p++ != '"') return false;
+    const char *end = strchr(p, '"');
+    if (!end || (size_t)(end - p) >= len) return false;
+    memcpy(out, p, end - p);
+    out[end - p] = '\0';
+    return true;
+}
+
+static bool json_true(const char *body, const char *key) {
+    const char *p = json_value(body, key);
+    return p && strncmp(p, "true", 4) == 0;
+}
+
+// Feed every string of an array to fn; false when the array is missing or malformed
+static bool json_each_uid(const char *body, const char *key, void (*fn)(const access_entry_t *)) {
+    const char *p = json_value(body, key);
+    if (!p || *p++ != '[') return false;
+    while (1) {
+        while (*p == ' ' || *p == ',') p++;
+        if (*p == ']') return true;
+        if (*p++ != '"') return false;
+        const char *end = strchr(p, '"');
+        if (!end) return false;
+        access_entry_t e;
+        if (parse_uid(p, end - p, &e)) {
+            fn(&e);
+        } else {
+            SCAN_LOGW("ACCESS", "Ignoring key \"%.*s\"\n", (int)(end - p), p);
+        }
+        p = end + 1;
+    }
+}
+
+// Full lists are appended unsorted and sorted once at the end
+static void table_append(const access_entry_t *e) {
+    if (count >= ACCESS_MAX) {
+        truncated = true;
+        return;
+    }
+    table[count++] = *e;
+}
+
+static void table_sort(void) {
+    qsort(table, count, sizeof(access_entry_t), entry_cmp);
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (out == 0 || entry_cmp(&table[out - 1], &table[i]) != 0) {
+            table[out++] = table[i];
+        }
+    }
+    count = out;
+}
+
+static void cache_persist(void) {
+    if (!nvs_open_ok) return;
+    esp_err_t ret = nvs_set_blob(nvs, ACCESS_NVS_UIDS, table, count * sizeof(access_entry_t));
+    if (ret == ESP_OK) ret = nvs_set_u32(nvs, ACCESS_NVS_VERSION, version);
+    if (ret == ESP_OK) ret = nvs_set_str(nvs, ACCESS_NVS_EPOCH, epoch);
+    if (ret == ESP_OK) ret = nvs_commit(nvs);
+    if (ret != ESP_OK) {
+        SCAN_LOGE("ACCESS", "Failed to store allowlist in NVS: %s\n", esp_err_to_name(ret));
+    }
+}
+
+esp_err_t access_cache_init(void) {
+    lock = xSemaphoreCreateMutexStatic(&lock_buf);
+    stats.capacity = ACCESS_MAX;
+    mem_budget_add("allowlist", sizeof(table));
+
+    esp_err_t ret = nvs_open(ACCESS_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        SCAN_LOGW("ACCESS", "NVS unavailable (%s), allowlist starts empty\n", esp_err_to_name(ret));
+        return ret;
+    }
+    nvs_open_ok = true;
+
+    size_t size = sizeof(table);
+    size_t epoch_len = sizeof(epoch);
+    if (nvs_get_blob(nvs, ACCESS_NVS_UIDS, table, &size) == ESP_OK &&
+        nvs_get_u32(nvs, ACCESS_NVS_VERSION, &version) == ESP_OK &&
+        nvs_get_str(nvs, ACCESS_NVS_EPOCH, epoch, &epoch_len) == ESP_OK) {
+        count = size / sizeof(access_entry_t);
+        synced = true;
+        SCAN_LOGI("ACCESS", "%lu keyfobs loaded from NVS (version %lu)\n",
+            (unsigned long)count, (unsigned long)version);
+    } else {
+        count = 0;
+        version = 0;
+        epoch[0] = '\0';
+        SCAN_LOGW("ACCESS", "No stored allowlist, every tap is denied until the first sync\n");
+    }
+    return ESP_OK;
+}
+
+bool access_cache_synced(void) {
+    return synced;
+}
+
+bool access_cache_lookup(const uint8_t *uid, uint8_t len) {
+    int64_t start = esp_timer_get_time();
+    access_entry_t e;
+    memset(&e, 0, sizeof(e));
+    if (len > ACCESS_UID_MAX) len = ACCESS_UID_MAX;
+    e.len = len;
+    memcpy(e.uid, uid, len);
+
+    uint32_t pos;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool granted = table_find(&e, &pos);
+    xSemaphoreGive(lock);
+
+    int64_t elapsed = esp_timer_get_time() - start;
+    stats.lookups++;
+    if (granted) stats.granted++;
+    else stats.denied++;
+    stats.last_lookup_us = elapsed;
+    if (elapsed > stats.max_lookup_us) stats.max_lookup_us = elapsed;
+    return granted;
+}
+
+void access_cache_sync_query(char *out, size_t len) {
+    snprintf(out, len, "since=%lu&epoch=%s", (unsigned long)version, epoch);
+}
+
+esp_err_t access_cache_apply(const char *body) {
+    uint32_t new_version;
+    char new_epoch[ACCESS_EPOCH_LEN];
+    if (!json_u32(body, "version", &new_version) ||
+        !json_str(body, "epoch", new_epoch, sizeof(new_epoch))) {
+        stats.sync_failures++;
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    bool full = json_true(body, "full");
+    if (!full && (!synced || strcmp(new_epoch, epoch) != 0)) {
+        // A delta only makes sense on top of the list it was computed from
+        stats.sync_failures++;
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!full && new_version == version) {
+        stats.syncs++;
+        return ESP_OK;
+    }
+
+    uint32_t old_count = count;
+    truncated = false;
+    xSemaphoreTake(lock, portMAX_DELAY);
+    bool ok;
+    if (full) {
+        count = 0;
+        ok = json_each_uid(body, "keys", table_append);
+        table_sort();
+    } else {
+        ok = json_each_uid(body, "removed", table_remove) &&
+             json_each_uid(body, "added", table_insert);
+    }
+    xSemaphoreGive(lock);
+
+    if (!ok) {
+        // Half-applied; start over from a full list
+        SCAN_LOGW("ACCESS", "Malformed allowlist response, requesting a full list next time\n");
+        version = 0;
+        epoch[0] = '\0';
+        stats.sync_failures++;
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (truncated) {
+        SCAN_LOGW("ACCESS", "Allowlist has more keyfobs than the %d that fit, some will be denied\n", ACCESS_MAX);
+        stats.sync_failures++;
+    }
+
+    version = new_version;
+    strcpy(epoch, new_epoch);
+    synced = true;
+    stats.syncs++;
+    if (full) stats.full_syncs++;
+    SCAN_LOGI("ACCESS", "%s sync to version %lu: %lu -> %lu keyfobs\n", full ? "Full" : "Delta",
+        (unsigned long)version, (unsigned long)old_count, (unsigned long)count);
+
+    cache_persist();
+    return ESP_OK;
+}
+
+access_cache_stats_t access_cache_stats(void) {
+    access_cache_stats_t s = stats;
+    s.entries = count;
+    s.version = version;
+    return s;
+}
+
+#endif  // CONFIG_SCANNER_ACCESS_CACHE
@@ -0,0 +1,38 @@
+// Local allowlist of keyfob UIDs, so the gate decision never waits on the network
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t entries;           // UIDs currently allowed
+    uint32_t capacity;
+    uint32_t version;           // backend allowlist version the table matches
+    uint32_t lookups;
+    uint32_t granted;
+    uint32_t denied;
+    uint32_t syncs;             // responses applied, full or delta
+    uint32_t full_syncs;
+    uint32_t sync_failures;     // responses that could not be parsed or did not fit
+    int64_t  last_lookup_us;
+    int64_t  max_lookup_us;
+} access_cache_stats_t;
+
+// Load the table mirrored in NVS; needs NVS
+esp_err_t access_cache_init(void);
+
+// True once the table holds a list from the backend, now or before a reboot
+bool access_cache_synced(void);
+
+// Decide a tap from the local table only; safe to call from any task
+bool access_cache_lookup(const uint8_t *uid, uint8_t len);
+
+// Query string for the next /api/druppel/allowlist request ("since=..&epoch=..")
+void access_cache_sync_query(char *out, size_t len);
+
+// Apply an allowlist response body and mirror the result to NVS
+esp_err_t access_cache_apply(const char *body);
+
+access_cache_stats_t access_cache_stats(void);
@@ -1,12 +1,15 @@
     // main.c for ESP-IDF framework
     #include <stdio.h>
+    #include <stdlib.h>
     #include <string.h>
     #include <stdbool.h>
+    #include <stdint.h>
+    #include <sys/time.h>
     #include "driver/gpio.h"
     #include "driver/spi_master.h"
-    #include "esp_log.h"
     #include "freertos/FreeRTOS.h"
     #include "freertos/task.h"
+    #include "freertos/event_groups.h"
     #include "soc/gpio_struct.h"
     #include "esp_timer.h"
     #include "esp_wifi.h"
@@ -14,11 +17,45 @@
     #include "nvs_flash.h"
     #include "esp_http_client.h"
     #include "esp_netif.h"
+    #include "esp_netif_sntp.h"
+    #include "esp_mac.h"
+    #include "esp_random.h"
+    #ifdef CONFIG_PM_ENABLE
+    #include "esp_pm.h"
+    #endif
+    #include "scan_queue.h"
+    #include "scan_journal.h"
+    #include "scan_wire.h"
+    #include "scan_debounce.h"
+    #include "scan_log.h"
+    #include "access_cache.h"
+    #include "telemetry.h"
+    #include "spi_tune.h"
+    #include "scan_sched.h"
+    #include "tag_auth.h"
+    #include "mem_budget.h"
+    #include "rc522.h"
+    #include "rc522_hal_esp.h"
 
     // Wifi/API variables
     #define WIFI_SSID "Hamburger"
     #define WIFI_PASS "minediamonds"
-    #define BACKEND_URL "http://192.168.250.242:3000/api/druppel/init-keyfob"
+    #define BACKEND_HOST "http://192.168.250.242:3000"
+    #define BACKEND_URL BACKEND_HOST "/api/druppel/init-keyfob"
+    #define BACKEND_BATCH_URL BACKEND_HOST "/api/druppel/scans/batch"
+    #define BACKEND_BINARY_URL BACKEND_HOST "/api/druppel/scans/binary"
+    #define BACKEND_ALLOWLIST_URL BACKEND_HOST "/api/druppel/allowlist"
+    #define BACKEND_TELEMETRY_URL BACKEND_HOST "/api/druppel/telemetry"
+    #define DEVICE_NAME "esp32-rfid-reader"
+    #define SNTP_SERVER "pool.ntp.org"
+    #define CLOCK_VALID_AFTER 1700000000   // seconds; earlier means SNTP has not synced yet
+
+    // Where this reader stands
+    #ifdef CONFIG_SCANNER_DIRECTION_OUT
+    #define SCANNER_DIRECTION SCAN_DIR_OUT
+    #else
+    #define SCANNER_DIRECTION SCAN_DIR_IN
+    #endif
 
     // Pin definitions
     #define PIN_NUM_MISO 19
@@ -26,411 +63,647 @@
     #define PIN_NUM_CLK  18
     #define PIN_NUM_CS   21
     #define PIN_NUM_RST  22
+    #ifdef CONFIG_SCANNER_DETECT_IRQ
+    #define PIN_NUM_IRQ  CONFIG_SCANNER_PIN_IRQ
+    #else
+    #define PIN_NUM_IRQ  -1
+    #endif
+    #if defined(CONFIG_SCANNER_ACCESS_CACHE) && CONFIG_SCANNER_GATE_GPIO >= 0
+    #define PIN_NUM_GATE CONFIG_SCANNER_GATE_GPIO
+    #endif
+
+    #define RC522_CLOCK_HZ        500000  // start with 500 kHz, spi_tune raises it
+    #define UID_HEX_LEN           (RC522_UID_MAX * 3)   // "AA:BB:..." plus terminator
+
+    // Readers on SPI2_HOST
+    //
+    // Each row gets its own device handle (CS) on the shared bus and its own reset
+    // and IRQ lines. The usual door has an "in" and an "out" reader; add rows for
+    // more, up to RC522_PROBE_MAX.
+    typedef struct {
+        int pin_cs;
+        int pin_rst;
+        int pin_irq;                // -1 when not wired
+        uint8_t direction;          // SCAN_DIR_*
+        uint16_t facility_id;       // sent as location_id
+    } reader_config_t;
+
+    static const reader_config_t reader_table[] = {
+        {
+            .pin_cs = PIN_NUM_CS,
+            .pin_rst = PIN_NUM_RST,
+            .pin_irq = PIN_NUM_IRQ,
+            .direction = SCANNER_DIRECTION,
+            .facility_id = CONFIG_SCANNER_FACILITY_ID,
+        },
+    #ifdef CONFIG_SCANNER_READER2
+        {
+            .pin_cs = CONFIG_SCANNER_READER2_PIN_CS,
+            .pin_rst = CONFIG_SCANNER_READER2_PIN_RST,
+    #ifdef CONFIG_SCANNER_DETECT_IRQ
+            .pin_irq = CONFIG_SCANNER_READER2_PIN_IRQ,
+    #else
+            .pin_irq = -1,
+    #endif
+    #ifdef CONFIG_SCANNER_READER2_DIRECTION_OUT
+            .direction = SCAN_DIR_OUT,
+    #else
+            .direction = SCAN_DIR_IN,
+    #endif
+            .facility_id = CONFIG_SCANNER_FACILITY_ID,
+        },
+    #endif
+    };
+
+    #define READER_COUNT ((int)(sizeof(reader_table) / sizeof(reader_table[0])))
+    _Static_assert(READER_COUNT <= RC522_PROBE_MAX, "too many readers for rc522_probe_all()");
+
+    typedef struct {
+        const reader_config_t *cfg;
+        rc522_t dev;
+        rc522_hal_esp_t hal;
+        spi_tune_t tune;
+        bool ready;                 // initialised and answering
+        bool card_present;
+    } reader_t;
+
+    static reader_t readers[READER_COUNT];
+
+    // Task layout: the reader owns core 1, the uploader shares core 0 with Wi-Fi/lwIP
+    #define SCAN_TASK_CORE        1
+    #define SCAN_TASK_PRIO        10
+    #define SCAN_TASK_STACK       4096
+    #define UPLOAD_TASK_CORE      0
+    #define UPLOAD_TASK_PRIO      5
+    #define UPLOAD_TASK_STACK     6144
+
+    // Stacks are set aside at boot like every other steady-state buffer
+    static StackType_t scan_task_stack[SCAN_TASK_STACK];
+    static StaticTask_t scan_task_tcb;
+    static StackType_t upload_task_stack[UPLOAD_TASK_STACK];
+    static StaticTask_t upload_task_tcb;
+
+    // Power saving between taps
+    //
+    // The scan task follows scan_sched: fast probes after a card, slower ones once it
+    // has been quiet, with the readers in soft power-down between them. A PM lock
+    // keeps the CPU out of light sleep only while a probe round runs, since a
+    // light-sleeping CPU would miss the IRQ edge; the gaps are slept through.
+    #define PROBE_POLL_MS         500     // without the IRQ line
+    #define PROBE_SLEEP_MIN_US    20000   // shorter gaps leave the field on
+    #define WIFI_LISTEN_INTERVAL  3       // beacon intervals between wakeups in modem sleep
+    #define PM_MIN_FREQ_MHZ       40      // the crystal on ESP32 modules
+
+    #ifdef CONFIG_PM_ENABLE
+    static esp_pm_lock_handle_t scan_pm_lock = NULL;
+    #endif
+
+    static TaskHandle_t upload_task_handle = NULL;
+    static volatile bool wifi_connected = false;
+    static char device_id[32] = DEVICE_NAME;
+    // Without the journal, upload sequence numbers start at 0 on every boot; a fresh
+    // epoch per boot keeps the backend from taking them for repeats of the last run
+    static uint32_t boot_epoch;
+
+    // WiFi connection state
+    //
+    // Nothing at boot waits for the network: the reader starts right away and whoever
+    // needs a link waits on WIFI_CONNECTED_BIT. The AP's BSSID and channel are kept in
+    // NVS so the next boot connects without a full scan (the lease itself is restored
+    // by CONFIG_LWIP_DHCP_RESTORE_LAST_IP). Reconnects back off exponentially from a
+    // timer so the event loop task is never blocked.
+    #define WIFI_CONNECTED_BIT    BIT0
+    #define WIFI_RETRY_MIN_MS     250
+    #define WIFI_RETRY_MAX_MS     30000
+    #define WIFI_BOOT_WAIT_MS     15000
+    #define WIFI_NVS_NAMESPACE    "wifi"
+    #define WIFI_NVS_AP           "ap"
+
+    typedef struct {
+        uint8_t bssid[6];
+        uint8_t channel;
+    } wifi_ap_cache_t;
+
+    static EventGroupHandle_t wifi_events = NULL;
+    static StaticEventGroup_t wifi_events_buf;
+    static esp_timer_handle_t wifi_retry_timer = NULL;
+    static wifi_ap_cache_t wifi_ap;
+    static bool wifi_ap_valid = false;      // wifi_ap matches what is in NVS
+    static bool wifi_ap_pinned = false;     // station config is locked to wifi_ap
+    static int wifi_retries = 0;
+    static int64_t wifi_lost_us = 0;        // when the link dropped; 0 while up
+    static bool wifi_ever_connected = false;
+
+    static void wifi_retry(void *arg) {
+        esp_wifi_connect();
+    }
+
+    // Remember the AP we got onto; only written when it changed
+    static void wifi_ap_store(const wifi_event_sta_connected_t *ev) {
+        if (wifi_ap_valid && ev->channel == wifi_ap.channel &&
+            memcmp(ev->bssid, wifi_ap.bssid, sizeof(wifi_ap.bssid)) == 0) {
+            return;
+        }
+        memcpy(wifi_ap.bssid, ev->bssid, sizeof(wifi_ap.bssid));
+        wifi_ap.channel = ev->channel;
+        wifi_ap_valid = true;
+        
+        nvs_handle_t nvs;
+        if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK) {
+            if (nvs_set_blob(nvs, WIFI_NVS_AP, &wifi_ap, sizeof(wifi_ap)) == ESP_OK) {
+                nvs_commit(nvs);
+            }
+            nvs_close(nvs);
+        }
+        SCAN_LOGI("WiFi", "AP " MACSTR " on channel %d stored for fast reconnect\n",
+            MAC2STR(wifi_ap.bssid), wifi_ap.channel);
+    }
 
-    // RC522 Commands
-    #define PCD_IDLE              0x00
-    #define PCD_AUTHENT           0x0E
-    #define PCD_RECEIVE           0x08
-    #define PCD_TRANSMIT          0x04
-    #define PCD_TRANSCEIVE        0x0C
-    #define PCD_RESETPHASE        0x0F
-    #define PCD_CALCCRC           0x03
-
-    // RC522 Registers
-    #define CommandReg            0x01
-    #define ComIEnReg             0x02
-    #define DivIEnReg             0x03
-    #define ComIrqReg             0x04
-    #define DivIrqReg             0x05
-    #define ErrorReg              0x06
-    #define Status1Reg            0x07
-    #define Status2Reg            0x08
-    #define FIFODataReg           0x09
-    #define FIFOLevelReg          0x0A
-    #define WaterLevelReg         0x0B
-    #define ControlReg            0x0C
-    #define BitFramingReg         0x0D
-    #define CollReg               0x0E
-    #define ModeReg               0x11
-    #define TxModeReg             0x12
-    #define RxModeReg             0x13
-    #define TxControlReg          0x14
-    #define TxASKReg              0x15
-    #define TxSelReg              0x16
-    #define RxSelReg              0x17
-    #define RxThresholdReg        0x18
-    #define DemodReg              0x19
-    #define MfTxReg               0x1C
-    #define MfRxReg               0x1D
-    #define SerialSpeedReg        0x1F
-    #define CRCResultRegH         0x21
-    #define CRCResultRegL         0x22
-    #define ModWidthReg           0x24
-    #define RFCfgReg              0x26
-    #define GsNReg                0x27
-    #define CWGsPReg              0x28
-    #define ModGsPReg             0x29
-    #define TModeReg              0x2A
-    #define TPrescalerReg         0x2B
-    #define TReloadRegH           0x2C
-    #define TReloadRegL           0x2D
-    #define TCounterValueRegH     0x2E
-    #define TCounterValueRegL     0x2F
-    #define TestSel1Reg           0x31
-    #define TestSel2Reg           0x32
-    #define TestPinEnReg          0x33
-    #define TestPinValueReg       0x34
-    #define TestBusReg            0x35
-    #define AutoTestReg           0x36
-    #define VersionReg            0x37
-    #define AnalogTestReg         0x38
-    #define TestDAC1Reg           0x39
-    #define TestDAC2Reg           0x3A
-    #define TestADCReg            0x3B
-
-    static const char *TAG = "RC522";
-    static spi_device_handle_t spi;
-
-    // Global variables for UID tracking
-    static char last_uid[20] = {0};
+    // The stored AP did not answer; fall back to a normal scan. NVS is left alone and
+    // overwritten by whichever AP we end up on.
+    static void wifi_ap_unpin(void) {
+        wifi_config_t config;
+        if (esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK) {
+            config.sta.bssid_set = false;
+            config.sta.channel = 0;
+            esp_wifi_set_config(WIFI_IF_STA, &config);
+        }
+        wifi_ap_pinned = false;
+        SCAN_LOGI("WiFi", "Stored AP not reachable, scanning all channels\n");
+    }
 
     // WiFi event handler
     static void wifi_event_handler(void* arg, esp_event_base_t event_base, 
                                 int32_t event_id, void* event_data) {
         if (event_base == WIFI_EVENT) {
             if (event_id == WIFI_EVENT_STA_START) {
-                printf("[WiFi] Station started\n");
+                SCAN_LOGI("WiFi", "Station started\n");
                 esp_wifi_connect();
             } else if (event_id == WIFI_EVENT_STA_CONNECTED) {
-                printf("[WiFi] Connected to AP\n");
+                wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *) event_data;
+                SCAN_LOGI("WiFi", "Connected to AP\n");
+                wifi_ap_store(event);
             } else if (event_id == WIFI_EVENT_STA_DISCONNECTED) {
-                printf("[WiFi] Disconnected from AP\n");
-                // Try to reconnect after a delay
-                vTaskDelay(pdMS_TO_TICKS(2000));
-                esp_wifi_connect();
+                wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *) event_data;
+                wifi_connected = false;
+                xEventGroupClearBits(wifi_events, WIFI_CONNECTED_BIT);
+                if (wifi_lost_us == 0) {
+                    wifi_lost_us = esp_timer_get_time();
+                    if (wifi_ever_connected) {
+                        telemetry_count(TM_WIFI_DISCONNECTS);
+                    }
+                }
+                // One retry on the stored AP, then look further
+                if (wifi_ap_pinned && wifi_retries >= 1) {
+                    wifi_ap_unpin();
+                }
+                
+                // Back off from a timer instead of sleeping in the event loop
+                int shift = wifi_retries < 8 ? wifi_retries : 8;
+                int delay_ms = WIFI_RETRY_MIN_MS << shift;
+                if (delay_ms > WIFI_RETRY_MAX_MS) {
+                    delay_ms = WIFI_RETRY_MAX_MS;
+                }
+                wifi_retries++;
+                SCAN_LOGW("WiFi", "Disconnected from AP (reason %d), retry %d in %d ms\n",
+                    event->reason, wifi_retries, delay_ms);
+                esp_timer_stop(wifi_retry_timer);
+                esp_timer_start_once(wifi_retry_timer, (uint64_t)delay_ms * 1000);
             }
         } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
             ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-            printf("[WiFi] Got IP: " IPSTR "\n", IP2STR(&event->ip_info.ip));
+            int64_t now = esp_timer_get_time();
+            if (!wifi_ever_connected) {
+                SCAN_LOGI("WiFi", "Got IP: " IPSTR " %lld ms after boot\n",
+                    IP2STR(&event->ip_info.ip), (long long)(now / 1000));
+            } else {
+                telemetry_count(TM_WIFI_RECONNECTS);
+                SCAN_LOGI("WiFi", "Got IP: " IPSTR ", reconnected %lld ms after the link dropped (%d retries)\n",
+                    IP2STR(&event->ip_info.ip), (long long)((now - wifi_lost_us) / 1000), wifi_retries);
+            }
+            wifi_ever_connected = true;
+            wifi_retries = 0;
+            wifi_lost_us = 0;
+            wifi_connected = true;
+            xEventGroupSetBits(wifi_events, WIFI_CONNECTED_BIT);
+            // Start replaying whatever piled up while offline
+            if (upload_task_handle) {
+                xTaskNotifyGive(upload_task_handle);
+            }
+        }
+    }
+
+    // Modem sleep while idle; fully awake while a request is in flight, so the
+    // backend's answer is not held at the AP until the next listen interval
+    static void wifi_set_busy(bool busy) {
+    #ifdef CONFIG_SCANNER_POWER_SAVE
+        static int current = -1;
+        if (current == busy) {
+            return;
         }
+        current = busy;
+        esp_wifi_set_ps(busy ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM);
+    #endif
     }
 
     // Test GPIO pins
-    void test_gpio_pins(void) {
-        printf("\n=== Testing GPIO Pins ===\n");
+    void test_gpio_pins(const reader_config_t *cfg) {
+        SCAN_LOGD("GPIO", "Testing CS %d, RST %d\n", cfg->pin_cs, cfg->pin_rst);
         
         // Test RST pin
-        gpio_reset_pin(PIN_NUM_RST);
-        gpio_set_direction(PIN_NUM_RST, GPIO_MODE_OUTPUT);
-        gpio_set_level(PIN_NUM_RST, 0);
-        printf("RST pin set to LOW\n");
+        gpio_reset_pin(cfg->pin_rst);
+        gpio_set_direction(cfg->pin_rst, GPIO_MODE_OUTPUT);
+        gpio_set_level(cfg->pin_rst, 0);
+        SCAN_LOGD("GPIO", "RST pin set to LOW\n");
         vTaskDelay(pdMS_TO_TICKS(100));
-        gpio_set_level(PIN_NUM_RST, 1);
-        printf("RST pin set to HIGH\n");
+        gpio_set_level(cfg->pin_rst, 1);
+        SCAN_LOGD("GPIO", "RST pin set to HIGH\n");
         
         // Test CS pin
-        gpio_reset_pin(PIN_NUM_CS);
-        gpio_set_direction(PIN_NUM_CS, GPIO_MODE_OUTPUT);
-        gpio_set_level(PIN_NUM_CS, 0);
-        printf("CS pin set to LOW (active)\n");
+        gpio_reset_pin(cfg->pin_cs);
+        gpio_set_direction(cfg->pin_cs, GPIO_MODE_OUTPUT);
+        gpio_set_level(cfg->pin_cs, 0);
+        SCAN_LOGD("GPIO", "CS pin set to LOW (active)\n");
         vTaskDelay(pdMS_TO_TICKS(100));
-        gpio_set_level(PIN_NUM_CS, 1);
-        printf("CS pin set to HIGH (inactive)\n");
-        
-        printf("=== GPIO Test Complete ===\n\n");
+        gpio_set_level(cfg->pin_cs, 1);
+        SCAN_LOGD("GPIO", "CS pin set to HIGH (inactive)\n");
     }
 
-    // Hard reset RC522
-    void rc522_hard_reset(void) {
-        printf("Performing hard reset...\n");
-        
-        gpio_reset_pin(PIN_NUM_RST);
-        gpio_set_direction(PIN_NUM_RST, GPIO_MODE_OUTPUT);
-        
-        // Reset sequence
-        gpio_set_level(PIN_NUM_RST, 0);
-        vTaskDelay(pdMS_TO_TICKS(100));
-        gpio_set_level(PIN_NUM_RST, 1);
-        vTaskDelay(pdMS_TO_TICKS(50));
-        
-        printf("Hard reset completed\n");
+    // Format a UID as "AA:BB:CC:DD"; out must hold UID_HEX_LEN bytes
+    void uid_to_hex(const uint8_t *uid, uint8_t len, char *out) {
+        static const char hex[] = "0123456789ABCDEF";
+        char *p = out;
+        for (int i = 0; i < len; i++) {
+            if (i) *p++ = ':';
+            *p++ = hex[uid[i] >> 4];
+            *p++ = hex[uid[i] & 0x0F];
+        }
+        *p = '\0';
     }
 
-    // Write a byte to the specified register
-    esp_err_t rc522_write(uint8_t reg, uint8_t value) {
-        uint8_t tx_data[2] = {(reg << 1) & 0x7E, value};
-        
-        spi_transaction_t t = {
-            .length = 16,
-            .tx_buffer = tx_data,
-            .rx_buffer = NULL,
-            .flags = 0,
-        };
-        
-        return spi_device_transmit(spi, &t);
+    void rc522_uid_to_hex(const rc522_uid_t *uid, char *out) {
+        uid_to_hex(uid->bytes, uid->size, out);
     }
 
-    // Read a byte from the specified register
-    uint8_t rc522_read(uint8_t reg) {
-        uint8_t tx_data[2] = {((reg << 1) & 0x7E) | 0x80, 0x00};
-        uint8_t rx_data[2] = {0, 0};
-        
-        spi_transaction_t t = {
-            .length = 16,
-            .tx_buffer = tx_data,
-            .rx_buffer = rx_data,
-            .flags = 0,
-        };
-        
-        esp_err_t ret = spi_device_transmit(spi, &t);
-        if (ret != ESP_OK) {
-            printf("SPI read error for reg 0x%02X: %s\n", reg, esp_err_to_name(ret));
-            return 0xFF;
+    // Shared HTTP client
+    //
+    // One handle with keep-alive lives across uploads so taps reuse the TCP connection.
+    // A failed request closes the socket (perform() reconnects next time); after
+    // HTTP_MAX_FAILURES in a row the handle itself is rebuilt. Its buffers are sized
+    // here and allocated once with the handle, and the URL is only set again when it
+    // changes, since the client reallocates its parsed parts on every set_url().
+    // Response bodies nobody asked for land in a fixed buffer and are cut there.
+    #define HTTP_TIMEOUT_MS       5000
+    #define HTTP_MAX_FAILURES     3
+    #define HTTP_RX_BUF_LEN       1024
+    #define HTTP_TX_BUF_LEN       512     // request line and headers; bodies are sent from our buffers
+    #define HTTP_URL_MAX          160
+    #define HTTP_RESPONSE_MAX     256     // error bodies kept for the log
+    #define UPLOAD_RETRY_MS       1000
+
+    static esp_http_client_handle_t http_client = NULL;
+    static int http_failures = 0;
+    static char http_url[HTTP_URL_MAX];     // what http_client points at
+
+    // Where the body of the current response goes; NULL discards it
+    typedef struct {
+        char *buf;
+        int cap;
+        int len;
+        bool truncated;
+    } http_sink_t;
+
+    static http_sink_t *http_sink = NULL;
+
+    static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
+        if (evt->event_id == HTTP_EVENT_ON_DATA && http_sink) {
+            int n = evt->data_len;
+            if (n > http_sink->cap - 1 - http_sink->len) {
+                n = http_sink->cap - 1 - http_sink->len;
+                http_sink->truncated = true;
+            }
+            memcpy(http_sink->buf + http_sink->len, evt->data, n);
+            http_sink->len += n;
+            http_sink->buf[http_sink->len] = '\0';
         }
-        
-        return rx_data[1];
+        return ESP_OK;
+    }
+
+    static esp_http_client_handle_t http_client_acquire(const char *url, esp_http_client_method_t method) {
+        if (!http_client) {
+            esp_http_client_config_t config = {
+                .url = url,
+                .method = method,
+                .timeout_ms = HTTP_TIMEOUT_MS,
+                .keep_alive_enable = true,
+                .buffer_size = HTTP_RX_BUF_LEN,
+                .buffer_size_tx = HTTP_TX_BUF_LEN,
+                .event_handler = http_event_handler,
+            };
+            http_client = esp_http_client_init(&config);
+            if (!http_client) {
+                SCAN_LOGE("HTTP", "Failed to initialize HTTP client\n");
+                return NULL;
+            }
+            esp_http_client_set_header(http_client, "Content-Type", "application/json");
+        } else {
+            if (strcmp(url, http_url) != 0) {
+                esp_http_client_set_url(http_client, url);
+            }
+            esp_http_client_set_method(http_client, method);
+        }
+        snprintf(http_url, sizeof(http_url), "%s", url);
+        return http_client;
     }
 
-    // Test SPI communication
-    bool test_spi_communication(void) {
-        printf("\n=== Testing SPI Communication ===\n");
+    // Perform the prepared request and record its round trip
+    static esp_err_t http_perform(esp_http_client_handle_t client, int64_t *elapsed_us) {
+        wifi_set_busy(true);
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = esp_http_client_perform(client);
+        int64_t elapsed = esp_timer_get_time() - start;
+        telemetry_count(TM_HTTP_REQUESTS);
+        telemetry_observe(TM_HTTP_RTT_US, 0, (uint32_t)elapsed);
+        if (elapsed_us) {
+            *elapsed_us = elapsed;
+        }
+        return err;
+    }
+
+    static void http_client_failed(void) {
+        telemetry_count(TM_HTTP_FAILURES);
+        esp_http_client_close(http_client);
+        if (++http_failures >= HTTP_MAX_FAILURES) {
+            SCAN_LOGW("HTTP", "%d failures in a row, recreating client\n", http_failures);
+            esp_http_client_cleanup(http_client);
+            http_client = NULL;
+            http_url[0] = '\0';
+            http_failures = 0;
+        }
+    }
+
+    // Function to send HTTP POST request to backend
+    void send_scan_to_backend(const scan_record_t *rec) {
+        static char response[HTTP_RESPONSE_MAX];
+        char uid_hex[UID_HEX_LEN];
+        uid_to_hex(rec->uid, rec->uid_len, uid_hex);
+        SCAN_LOGD("HTTP", "Preparing to send UID: %s\n", uid_hex);
+        
+        esp_http_client_handle_t client = http_client_acquire(BACKEND_URL, HTTP_METHOD_PUT);
+        if (!client) {
+            return;
+        }
         
-        // Test 1: Write to version register (should always respond)
-        printf("Test 1: Reading Version Register...\n");
-        uint8_t version = rc522_read(VersionReg);
-        printf("Version register (0x37): 0x%02X\n", version);
+        // Create JSON payload
+        char payload[200];
+        snprintf(payload, sizeof(payload), 
+        "{\"keyfob_key\":\"%s\",\"device\":\"%s\",\"timestamp\":%lld}", uid_hex, device_id, (long long)rec->timestamp_ms);
         
-        // Test 2: Write and read back from a test register
-        printf("\nTest 2: Write/Read test...\n");
-        rc522_write(TModeReg, 0x8D);
-        vTaskDelay(pdMS_TO_TICKS(10));
-        uint8_t readback = rc522_read(TModeReg);
-        printf("Wrote 0x8D to TModeReg, read back 0x%02X\n", readback);
+        SCAN_LOGD("HTTP", "Sending payload: %s\n", payload);
         
-        if (readback == 0x8D) {
-            printf("✓ SPI communication working!\n");
-            return true;
+        // Set POST data
+        esp_http_client_set_post_field(client, payload, strlen(payload));
+        
+        // Execute request; whatever the backend says back is cut at HTTP_RESPONSE_MAX
+        http_sink_t sink = { .buf = response, .cap = sizeof(response) };
+        response[0] = '\0';
+        http_sink = &sink;
+        esp_err_t err = http_perform(client, NULL);
+        http_sink = NULL;
+        
+        if (err == ESP_OK) {
+            http_failures = 0;
+            int status_code = esp_http_client_get_status_code(client);
+            if (status_code == 200 || status_code == 201) {
+                SCAN_LOGD("HTTP", "POST successful (Status: %d)\n", status_code);
+            } else {
+                SCAN_LOGW("HTTP", "POST failed (Status: %d)\n", status_code);
+                if (sink.len > 0) {
+                    SCAN_LOGW("HTTP", "Response: %s%s\n", response, sink.truncated ? "..." : "");
+                }
+            }
         } else {
-            printf("✗ SPI communication failed!\n");
-            return false;
+            SCAN_LOGE("HTTP", "Request failed: %s\n", esp_err_to_name(err));
+            http_client_failed();
         }
     }
 
-    // Initialize RC522
-    bool rc522_init(void) {
-        printf("\n=== Initializing RC522 ===\n");
-        
-        // Perform hard reset
-        rc522_hard_reset();
-        
-        // Initialize SPI bus
-        spi_bus_config_t buscfg = {
-            .miso_io_num = PIN_NUM_MISO,
-            .mosi_io_num = PIN_NUM_MOSI,
-            .sclk_io_num = PIN_NUM_CLK,
-            .quadwp_io_num = -1,
-            .quadhd_io_num = -1,
-            .max_transfer_sz = 32,
-            .flags = 0,
-        };
-        
-        spi_device_interface_config_t devcfg = {
-            .clock_speed_hz = 500000,      // Start with 500 kHz
-            .mode = 0,                     // SPI Mode 0
-            .spics_io_num = PIN_NUM_CS,
-            .queue_size = 7,
-            .flags = 0,
-        };
+    #ifdef CONFIG_SCANNER_UPLOAD_BATCH
+    #define UPLOAD_BATCH_MAX      CONFIG_SCANNER_UPLOAD_BATCH_MAX
+    #ifdef CONFIG_SCANNER_UPLOAD_BINARY
+    #define UPLOAD_BUF_LEN        (SCAN_WIRE_HEADER_LEN + sizeof(device_id) + UPLOAD_BATCH_MAX * SCAN_WIRE_RECORD_MAX)
+    #else
+    #define UPLOAD_ITEM_LEN       128     // one JSON scan object, longest UID
+    #define UPLOAD_BUF_LEN        (96 + UPLOAD_BATCH_MAX * UPLOAD_ITEM_LEN)
+    #endif
+    #ifdef CONFIG_SCANNER_JOURNAL
+    #define JOURNAL_REPLAY_INTERVAL_MS CONFIG_SCANNER_JOURNAL_REPLAY_INTERVAL_MS
+    #else
+    #define JOURNAL_REPLAY_INTERVAL_MS 0    // the journal is never mounted
+    #endif
+
+    // Upload several records in one request. Returns false only when it is worth
+    // retrying (transport error or 5xx); a 4xx means the batch itself is bad.
+    bool send_batch_to_backend(const scan_record_t *recs, int count, uint32_t epoch) {
+        static char payload[UPLOAD_BUF_LEN];
+        int64_t encode_start = esp_timer_get_time();
+    #ifdef CONFIG_SCANNER_UPLOAD_BINARY
+        // Fixed little-endian records, see scan_wire.h
+        int len = scan_wire_encode_batch((uint8_t *)payload, sizeof(payload), device_id,
+            epoch, encode_start / 1000, recs, count);
+        if (len == 0) {
+            SCAN_LOGE("HTTP", "Batch of %d does not fit in %d bytes\n", count, (int)sizeof(payload));
+            return true;
+        }
+        const char *url = BACKEND_BINARY_URL;
+    #else
+        char uid_hex[UID_HEX_LEN];
         
-        // Initialize SPI
-        esp_err_t ret = spi_bus_initialize(SPI2_HOST, &buscfg, 0);
-        if (ret != ESP_OK) {
-            printf("SPI bus init failed: %s\n", esp_err_to_name(ret));
-            return false;
+        // 'now' lets the backend turn uptime timestamps into wall-clock time;
+        // records stamped after SNTP sync carry Unix time as 'time' instead
+        int len = snprintf(payload, sizeof(payload), "{\"device\":\"%s\",\"epoch\":%lu,\"now\":%lld,\"scans\":[",
+            device_id, (unsigned long)epoch, (long long)(esp_timer_get_time() / 1000));
+        for (int i = 0; i < count; i++) {
+            uid_to_hex(recs[i].uid, recs[i].uid_len, uid_hex);
+            len += snprintf(payload + len, sizeof(payload) - len,
+                "%s{\"keyfob_key\":\"%s\",\"location_id\":%d,\"inout\":\"%s\",\"%s\":%lld,\"seq\":%lu%s}",
+                i ? "," : "", uid_hex, recs[i].facility_id,
+                recs[i].direction == SCAN_DIR_OUT ? "out" : "in",
+                (recs[i].flags & SCAN_FLAG_UNIX_TIME) ? "time" : "timestamp",
+                (long long)recs[i].timestamp_ms, (unsigned long)recs[i].seq,
+                !(recs[i].flags & SCAN_FLAG_DECIDED) ? "" :
+                (recs[i].flags & SCAN_FLAG_GRANTED) ? ",\"granted\":true" : ",\"granted\":false");
+        }
+        len += snprintf(payload + len, sizeof(payload) - len, "]}");
+        if (len >= (int)sizeof(payload)) {
+            SCAN_LOGE("HTTP", "Batch of %d does not fit in %d bytes\n", count, (int)sizeof(payload));
+            return true;
         }
+        const char *url = BACKEND_BATCH_URL;
+    #endif
+        int64_t encode_time = esp_timer_get_time() - encode_start;
         
-        ret = spi_bus_add_device(SPI2_HOST, &devcfg, &spi);
-        if (ret != ESP_OK) {
-            printf("SPI device add failed: %s\n", esp_err_to_name(ret));
+        esp_http_client_handle_t client = http_client_acquire(url, HTTP_METHOD_POST);
+        if (!client) {
             return false;
         }
+    #ifdef CONFIG_SCANNER_UPLOAD_BINARY
+        esp_http_client_set_header(client, "Content-Type", "application/octet-stream");
+    #endif
+        esp_http_client_set_post_field(client, payload, len);
         
-        printf("SPI initialized successfully\n");
-        
-        // Test SPI communication first
-        if (!test_spi_communication()) {
-            printf("SPI communication test failed!\n");
+        int64_t elapsed;
+        esp_err_t err = http_perform(client, &elapsed);
+        if (err != ESP_OK) {
+            SCAN_LOGE("HTTP", "Batch request failed: %s\n", esp_err_to_name(err));
+            http_client_failed();
             return false;
         }
+        http_failures = 0;
         
-        // Now try to initialize RC522
-        printf("\nConfiguring RC522 registers...\n");
-        
-        // Soft reset
-        rc522_write(CommandReg, PCD_RESETPHASE);
-        vTaskDelay(pdMS_TO_TICKS(50));
-        
-        // Check if chip is responding
-        uint8_t version = rc522_read(VersionReg);
-        printf("RC522 Version: 0x%02X\n", version);
-        
-        if (version == 0x00 || version == 0xFF) {
-            printf("ERROR: RC522 not responding!\n");
-            printf("Check:\n");
-            printf("1. Wiring (MISO, MOSI, CLK, CS, RST, 3.3V, GND)\n");
-            printf("2. Power supply (RC522 needs 3.3V, not 5V!)\n");
-            printf("3. CS pin is connected and pulled high correctly\n");
+        int status_code = esp_http_client_get_status_code(client);
+        SCAN_LOGI("HTTP", "Batch of %d scans (%d bytes, encoded in %lld us): status %d in %lld ms\n",
+            count, len, (long long)encode_time, status_code, (long long)(elapsed / 1000));
+        if (status_code >= 500) {
             return false;
         }
-        
-        // Configure RC522
-        rc522_write(TModeReg, 0x8D);
-        rc522_write(TPrescalerReg, 0x3E);
-        rc522_write(TReloadRegL, 30);
-        rc522_write(TReloadRegH, 0x00);
-        rc522_write(TxASKReg, 0x40);
-        rc522_write(ModeReg, 0x3D);
-        
-        // Enable antenna
-        uint8_t tx_control = rc522_read(TxControlReg);
-        rc522_write(TxControlReg, tx_control | 0x03);
-        
-        printf("RC522 initialized successfully!\n");
+        if (status_code != 200 && status_code != 201) {
+            SCAN_LOGW("HTTP", "Batch rejected, dropping %d scans\n", count);
+        }
         return true;
     }
+    #endif
 
-    // Simple card detection (for testing)
-    bool rc522_is_card_present(void) {
-        // Clear interrupts
-        rc522_write(ComIrqReg, 0x7F);
+    #ifdef CONFIG_SCANNER_ACCESS_CACHE
+    // Allowlist sync
+    //
+    // Runs on the upload task, which owns the HTTP client. A full list of
+    // CONFIG_SCANNER_ACCESS_CACHE_MAX ten-byte UIDs has to fit in the body buffer.
+    #define ACCESS_SYNC_INTERVAL_US ((int64_t)CONFIG_SCANNER_ACCESS_SYNC_INTERVAL_S * 1000000)
+    #define ACCESS_SYNC_RETRY_US    5000000
+    #define ACCESS_SYNC_BUF_LEN     (256 + CONFIG_SCANNER_ACCESS_CACHE_MAX * 24)
+
+    static int64_t access_next_sync_us = 0;
+
+    static void access_cache_sync(void) {
+        static char body[ACCESS_SYNC_BUF_LEN];
+        char url[sizeof(BACKEND_ALLOWLIST_URL) + 64];
+        char query[48];
         
-        // Send REQA command
-        rc522_write(BitFramingReg, 0x07);
-        rc522_write(FIFODataReg, 0x26);
-        rc522_write(CommandReg, PCD_TRANSCEIVE);
-        rc522_write(BitFramingReg, 0x87);
+        access_next_sync_us = esp_timer_get_time() + ACCESS_SYNC_RETRY_US;
+        access_cache_sync_query(query, sizeof(query));
+        snprintf(url, sizeof(url), BACKEND_ALLOWLIST_URL "?%s", query);
         
-        // Wait a bit
-        vTaskDelay(pdMS_TO_TICKS(25));
+        esp_http_client_handle_t client = http_client_acquire(url, HTTP_METHOD_GET);
+        if (!client) {
+            return;
+        }
+        esp_http_client_set_post_field(client, NULL, 0);
         
-        // Check if data received
-        uint8_t com_irq = rc522_read(ComIrqReg);
-        rc522_write(CommandReg, PCD_IDLE);
+        http_sink_t sink = { .buf = body, .cap = sizeof(body) };
+        body[0] = '\0';
+        http_sink = &sink;
+        int64_t elapsed;
+        esp_err_t err = http_perform(client, &elapsed);
+        http_sink = NULL;
         
-        return (com_irq & 0x20) != 0;
-    }
-
-    // Read UID (simplified for testing)
-    bool rc522_read_uid(uint8_t *uid_out) {
-        uint8_t irq;
-        uint8_t fifo_level;
-
-        // Clear IRQs and FIFO
-        rc522_write(ComIrqReg, 0x7F);
-        rc522_write(FIFOLevelReg, 0x80);
-
-        // ANTICOLLISION CL1
-        rc522_write(BitFramingReg, 0x00);
-        rc522_write(FIFODataReg, 0x93);
-        rc522_write(FIFODataReg, 0x20);
-
-        rc522_write(CommandReg, PCD_TRANSCEIVE);
-        rc522_write(BitFramingReg, 0x80);
-
-        // Wait for RX or timeout
-        for (int i = 0; i < 100; i++) {
-            irq = rc522_read(ComIrqReg);
-            if (irq & 0x20) break; // RxIRq
-            if (irq & 0x01) return false; // Timer
-            vTaskDelay(pdMS_TO_TICKS(1));
+        if (err != ESP_OK) {
+            SCAN_LOGE("ACCESS", "Allowlist request failed: %s\n", esp_err_to_name(err));
+            http_client_failed();
+            return;
         }
-
-        rc522_write(CommandReg, PCD_IDLE);
-
-        // Error check
-        if (rc522_read(ErrorReg) & 0x13) {
-            return false;
+        http_failures = 0;
+        
+        int status_code = esp_http_client_get_status_code(client);
+        if (status_code != 200) {
+            SCAN_LOGW("ACCESS", "Allowlist request failed (Status: %d)\n", status_code);
+            return;
         }
-
-        fifo_level = rc522_read(FIFOLevelReg);
-        if (fifo_level < 5) {
-            return false;
+        if (sink.truncated) {
+            SCAN_LOGW("ACCESS", "Allowlist response larger than %d bytes, ignored\n", (int)sizeof(body));
+            return;
         }
-
-        // Read UID (4 bytes)
-        uint8_t bcc = 0;
-        for (int i = 0; i < 4; i++) {
-            uid_out[i] = rc522_read(FIFODataReg);
-            bcc ^= uid_out[i];
+        if (access_cache_apply(body) == ESP_OK) {
+            access_next_sync_us = esp_timer_get_time() + ACCESS_SYNC_INTERVAL_US;
         }
+        SCAN_LOGD("ACCESS", "Sync of %d bytes took %lld ms\n", sink.len, (long long)(elapsed / 1000));
+    }
+    #endif
 
-        uint8_t received_bcc = rc522_read(FIFODataReg);
-        if (bcc != received_bcc) {
-            return false;
-        }
+    #if CONFIG_SCANNER_TELEMETRY_PUSH_INTERVAL_S > 0
+    // Telemetry push
+    //
+    // Also on the upload task. A full snapshot (every reader with samples) stays
+    // under 3.5 KB.
+    #define TELEMETRY_PUSH_INTERVAL_US ((int64_t)CONFIG_SCANNER_TELEMETRY_PUSH_INTERVAL_S * 1000000)
+    #define TELEMETRY_PUSH_BUF_LEN     4096
 
-        return true;
-    }
+    static int64_t telemetry_next_push_us = 0;
 
-    // Function to send HTTP POST request to backend
-    void send_scan_to_backend(const char* uid_hex) {
-        printf("[HTTP] Preparing to send UID: %s\n", uid_hex);
+    static void telemetry_push(void) {
+        static char body[TELEMETRY_PUSH_BUF_LEN];
         
-        esp_http_client_config_t config = {
-            .url = BACKEND_URL,
-            .method = HTTP_METHOD_PUT,
-            .timeout_ms = 5000,
-        };
-        
-        esp_http_client_handle_t client = esp_http_client_init(&config);
+        telemetry_next_push_us = esp_timer_get_time() + TELEMETRY_PUSH_INTERVAL_US;
+        size_t len = telemetry_render_push(body, sizeof(body), device_id);
+        if (len == 0) {
+            SCAN_LOGE("TELEMETRY", "Snapshot does not fit in %d bytes\n", (int)sizeof(body));
+            return;
+        }
         
+        esp_http_client_handle_t client = http_client_acquire(BACKEND_TELEMETRY_URL, HTTP_METHOD_POST);
         if (!client) {
-            printf("[HTTP] Failed to initialize HTTP client\n");
             return;
         }
-        
-        // Set content type header
         esp_http_client_set_header(client, "Content-Type", "application/json");
+        esp_http_client_set_post_field(client, body, len);
         
-        // Create JSON payload
-        char payload[200];
-        int64_t timestamp = esp_timer_get_time() / 1000; // Convert to milliseconds
-        snprintf(payload, sizeof(payload), 
-        "{\"keyfob_key\":\"%s\",\"device\":\"esp32-rfid-reader\",\"timestamp\":%lld}", uid_hex, timestamp);
-        
-        printf("[HTTP] Sending payload: %s\n", payload);
-        
-        // Set POST data
-        esp_http_client_set_post_field(client, payload, strlen(payload));
-        
-        // Execute request
-        esp_err_t err = esp_http_client_perform(client);
-        
-        if (err == ESP_OK) {
-            int status_code = esp_http_client_get_status_code(client);
-            if (status_code == 200 || status_code == 201) {
-                printf("[HTTP] POST successful (Status: %d)\n", status_code);
-            } else {
-                printf("[HTTP] POST failed (Status: %d)\n", status_code);
-                // Print response body if available
-                int content_len = esp_http_client_get_content_length(client);
-                if (content_len > 0) {
-                    char *buffer = malloc(content_len + 1);
-                    if (buffer) {
-                        esp_http_client_read(client, buffer, content_len);
-                        buffer[content_len] = '\0';
-                        printf("[HTTP] Response: %s\n", buffer);
-                        free(buffer);
-                    }
-                }
-            }
-        } else {
-            printf("[HTTP] Request failed: %s\n", esp_err_to_name(err));
+        int64_t elapsed;
+        esp_err_t err = http_perform(client, &elapsed);
+        if (err != ESP_OK) {
+            SCAN_LOGE("TELEMETRY", "Push failed: %s\n", esp_err_to_name(err));
+            http_client_failed();
+            return;
         }
+        http_failures = 0;
+        telemetry_count(TM_TELEMETRY_PUSHES);
+        SCAN_LOGD("TELEMETRY", "Pushed %d bytes: status %d in %lld ms\n", (int)len,
+            esp_http_client_get_status_code(client), (long long)(elapsed / 1000));
+    }
+    #endif
+
+    #ifdef PIN_NUM_GATE
+    // Gate relay: opened on a granted tap, closed again by a one-shot timer
+    static esp_timer_handle_t gate_timer = NULL;
+
+    static void gate_close(void *arg) {
+        gpio_set_level(PIN_NUM_GATE, 0);
+    }
+
+    static void gate_init(void) {
+        gpio_config_t io = {
+            .pin_bit_mask = 1ULL << PIN_NUM_GATE,
+            .mode = GPIO_MODE_OUTPUT,
+            .pull_up_en = GPIO_PULLUP_DISABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_DISABLE,
+        };
+        ESP_ERROR_CHECK(gpio_config(&io));
+        gpio_set_level(PIN_NUM_GATE, 0);
         
-        esp_http_client_cleanup(client);
+        esp_timer_create_args_t args = {
+            .callback = gate_close,
+            .name = "gate",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&args, &gate_timer));
     }
 
+    static void gate_open(void) {
+        gpio_set_level(PIN_NUM_GATE, 1);
+        esp_timer_stop(gate_timer);
+        esp_timer_start_once(gate_timer, (uint64_t)CONFIG_SCANNER_GATE_OPEN_MS * 1000);
+    }
+    #endif
+
     // Function to initialize WiFi
     static void wifi_init_sta(void) {
         // Initialize NVS
@@ -447,6 +720,17 @@
         // Create default event loop
         ESP_ERROR_CHECK(esp_event_loop_create_default());
         
+        wifi_events = xEventGroupCreateStatic(&wifi_events_buf);
+        esp_timer_create_args_t retry_args = {
+            .callback = wifi_retry,
+            .name = "wifi_retry",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&retry_args, &wifi_retry_timer));
+        
+        // Wall-clock time for scans that outlive a reboot in the journal
+        esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(SNTP_SERVER);
+        ESP_ERROR_CHECK(esp_netif_sntp_init(&sntp_config));
+        
         // Create default WiFi station
         esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
         assert(sta_netif);
@@ -477,14 +761,440 @@
                     .capable = true,
                     .required = false
                 },
+    #ifdef CONFIG_SCANNER_POWER_SAVE
+                .listen_interval = WIFI_LISTEN_INTERVAL,
+    #endif
             },
         };
         
+        // Go straight to the AP we used last time; forgotten again if it does not answer
+        nvs_handle_t nvs;
+        size_t ap_len = sizeof(wifi_ap);
+        if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+            if (nvs_get_blob(nvs, WIFI_NVS_AP, &wifi_ap, &ap_len) == ESP_OK && ap_len == sizeof(wifi_ap)) {
+                memcpy(wifi_config.sta.bssid, wifi_ap.bssid, sizeof(wifi_ap.bssid));
+                wifi_config.sta.bssid_set = true;
+                wifi_config.sta.channel = wifi_ap.channel;
+                wifi_ap_valid = true;
+                wifi_ap_pinned = true;
+                SCAN_LOGI("WiFi", "Using stored AP " MACSTR " on channel %d\n",
+                    MAC2STR(wifi_ap.bssid), wifi_ap.channel);
+            }
+            nvs_close(nvs);
+        }
+        
         ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
         ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
         ESP_ERROR_CHECK(esp_wifi_start());
         
-        printf("[WiFi] WiFi initialization complete. Connecting to %s...\n", WIFI_SSID);
+        SCAN_LOGI("WiFi", "WiFi initialization complete. Connecting to %s...\n", WIFI_SSID);
+    }
+
+    // Swap an uptime timestamp for Unix time once SNTP has set the clock
+    static void scan_record_set_wallclock(scan_record_t *rec) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        if (tv.tv_sec < CLOCK_VALID_AFTER || (rec->flags & SCAN_FLAG_UNIX_TIME)) {
+            return;
+        }
+        int64_t now_ms = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        rec->timestamp_ms = now_ms - (esp_timer_get_time() / 1000 - rec->timestamp_ms);
+        rec->flags |= SCAN_FLAG_UNIX_TIME;
+    }
+
+    // Periodic backend calls between uploads
+    static void upload_housekeeping(void) {
+        if (!wifi_connected) {
+            return;
+        }
+    #ifdef CONFIG_SCANNER_ACCESS_CACHE
+        if (esp_timer_get_time() >= access_next_sync_us) {
+            access_cache_sync();
+        }
+    #endif
+    #if CONFIG_SCANNER_TELEMETRY_PUSH_INTERVAL_S > 0
+        if (esp_timer_get_time() >= telemetry_next_push_us) {
+            telemetry_push();
+        }
+    #endif
+    }
+
+    // How long the upload task may sleep with nothing to send
+    static TickType_t upload_idle_ticks(void) {
+        // Offline there is nothing to sync or push; GOT_IP wakes the task
+        if (!wifi_connected) {
+            return portMAX_DELAY;
+        }
+        int64_t next_us = INT64_MAX;
+    #ifdef CONFIG_SCANNER_ACCESS_CACHE
+        next_us = access_next_sync_us;
+    #endif
+    #if CONFIG_SCANNER_TELEMETRY_PUSH_INTERVAL_S > 0
+        if (telemetry_next_push_us < next_us) {
+            next_us = telemetry_next_push_us;
+        }
+    #endif
+        if (next_us == INT64_MAX) {
+            return portMAX_DELAY;
+        }
+        int64_t wait_us = next_us - esp_timer_get_time();
+        return wait_us > 0 ? pdMS_TO_TICKS(wait_us / 1000) + 1 : 1;
+    }
+
+    // Consumer: drain the scan queue to the backend at whatever pace the network allows
+    static void upload_task(void *arg) {
+    #ifdef CONFIG_SCANNER_UPLOAD_BATCH
+        static scan_record_t pending[UPLOAD_BATCH_MAX];
+        int count = 0;
+        bool journal = scan_journal_ready();
+        // Journal records carry the journal's sequence numbers, queued ones the scan task's
+        uint32_t epoch = journal ? scan_journal_epoch() : boot_epoch;
+        
+        while (1) {
+            upload_housekeeping();
+            if (journal) {
+                // Persist whatever the reader queued before touching the network
+                scan_record_t rec;
+                while (scan_queue_pop(&rec)) {
+                    scan_record_set_wallclock(&rec);
+                    if (scan_journal_append(&rec) == ESP_OK) {
+                        scan_journal_stats_t js = scan_journal_stats();
+                        SCAN_LOGD("JOURNAL", "Scan %lu stored in %lld us (avg %lld, max %lld), %lu pending\n",
+                            (unsigned long)rec.seq, (long long)js.last_append_us,
+                            (long long)(js.total_append_us / js.appended), (long long)js.max_append_us,
+                            (unsigned long)js.pending);
+                    }
+                }
+                count = wifi_connected ? scan_journal_peek(pending, UPLOAD_BATCH_MAX) : 0;
+            } else {
+                // Top up the batch with whatever the reader queued meanwhile
+                while (count < UPLOAD_BATCH_MAX && scan_queue_pop(&pending[count])) {
+                    scan_record_set_wallclock(&pending[count]);
+                    count++;
+                }
+            }
+            if (count == 0) {
+                wifi_set_busy(false);
+                ulTaskNotifyTake(pdTRUE, upload_idle_ticks());
+                continue;
+            }
+            
+            if (send_batch_to_backend(pending, count, epoch)) {
+                count = 0;
+                if (journal) {
+                    scan_journal_ack();
+                    // Draining a backlog: pace the batches so the backend is not flooded
+                    if (scan_journal_pending() > 0) {
+                        vTaskDelay(pdMS_TO_TICKS(JOURNAL_REPLAY_INTERVAL_MS));
+                    }
+                }
+            } else if (journal) {
+                // The records stay in flash; peek them again on the next round
+                count = 0;
+                vTaskDelay(pdMS_TO_TICKS(UPLOAD_RETRY_MS));
+            } else {
+                // Keep the batch; new taps wait in the ring until the backend is back
+                vTaskDelay(pdMS_TO_TICKS(UPLOAD_RETRY_MS));
+            }
+    #else
+        scan_record_t rec;
+        
+        while (1) {
+            upload_housekeeping();
+            if (!scan_queue_pop(&rec)) {
+                wifi_set_busy(false);
+                ulTaskNotifyTake(pdTRUE, upload_idle_ticks());
+                continue;
+            }
+            
+            send_scan_to_backend(&rec);
+    #endif
+            
+            scan_queue_stats_t qs = scan_queue_stats();
+            SCAN_LOGD("QUEUE", "depth %lu, high-water %lu, dropped %lu, sent %lu\n",
+                (unsigned long)qs.depth, (unsigned long)qs.high_water,
+                (unsigned long)qs.dropped, (unsigned long)qs.dequeued);
+        }
+    }
+
+    // Read every tag on one reader that just saw a card and enqueue the new ones
+    static void reader_scan(reader_t *r, int index, uint32_t *scan_seq) {
+        rc522_uid_t tags[RC522_MAX_TAGS];
+        rc522_spi_stats_t spi_start = rc522_spi_stats_get(&r->dev);
+        int64_t scan_start = esp_timer_get_time();
+    #ifdef CONFIG_SCANNER_TAG_AUTH
+        // Each tag's credential is read while it is still selected
+        tag_auth_verdict_t verdicts[RC522_MAX_TAGS];
+        int tag_count = rc522_scan_tags_visit(&r->dev, tags, RC522_MAX_TAGS, tag_auth_visit, verdicts);
+    #else
+        int tag_count = rc522_scan_tags(&r->dev, tags, RC522_MAX_TAGS);
+    #endif
+        int64_t scan_time = esp_timer_get_time() - scan_start;
+        rc522_spi_stats_t spi_used = rc522_spi_stats_since(&r->dev, &spi_start);
+        telemetry_observe(TM_ANTICOLL_US, index, (uint32_t)scan_time);
+        telemetry_observe(TM_SPI_TXN, index, spi_used.transactions);
+        SCAN_LOGD("SPI", "reader %d scan: %d tag(s) in %lld us, %lu transactions in %lu batches, %lu bytes, %lld us on the bus\n",
+            index, tag_count, (long long)scan_time, (unsigned long)spi_used.transactions,
+            (unsigned long)spi_used.batches, (unsigned long)spi_used.bytes,
+            (long long)spi_used.bus_time_us);
+
+        for (int t = 0; t < tag_count; t++) {
+            // Hex only for the log; everything else works on the raw bytes
+            char uid_hex[UID_HEX_LEN];
+            rc522_uid_to_hex(&tags[t], uid_hex);
+            SCAN_LOGI("UID", "%s (SAK 0x%02X)\n", uid_hex, tags[t].sak);
+            
+    #ifdef CONFIG_SCANNER_TAG_AUTH
+            // A UID alone is not enough; a tap that did not authenticate never happened
+            telemetry_observe(TM_AUTH_US, index, verdicts[t].elapsed_us);
+            if (verdicts[t].result != TAG_AUTH_OK) {
+                telemetry_count(TM_AUTH_FAILURES);
+                SCAN_LOGW("AUTH", "%s rejected: %s (%lu us)\n", uid_hex,
+                    tag_auth_result_name(verdicts[t].result), (unsigned long)verdicts[t].elapsed_us);
+                continue;
+            }
+            tag_auth_stats_t ts = tag_auth_stats();
+            SCAN_LOGD("AUTH", "Credential %lu verified in %lu us (max %lu), %lu of %lu taps without HMAC\n",
+                (unsigned long)verdicts[t].serial, (unsigned long)verdicts[t].elapsed_us,
+                (unsigned long)ts.max_us, (unsigned long)ts.cache_hits,
+                (unsigned long)(ts.cache_hits + ts.cache_misses));
+    #endif
+
+            // Report a UID again only once its hold-off on this reader has passed
+            int64_t now_us = esp_timer_get_time();
+            uint32_t repeats;
+            if (scan_debounce_check(index, tags[t].bytes, tags[t].size, now_us, &repeats)) {
+                // Hand off to the upload task
+                scan_record_t rec = {
+                    .seq = (*scan_seq)++,
+                    .timestamp_ms = now_us / 1000,
+                    .direction = r->cfg->direction,
+                    .facility_id = r->cfg->facility_id,
+                    .reader = index,
+                    .uid_len = tags[t].size,
+                };
+                memcpy(rec.uid, tags[t].bytes, tags[t].size);
+                
+    #ifdef CONFIG_SCANNER_ACCESS_CACHE
+                // Decide from the local allowlist; the backend learns the outcome with the upload
+                bool granted = access_cache_lookup(tags[t].bytes, tags[t].size);
+                rec.flags |= SCAN_FLAG_DECIDED | (granted ? SCAN_FLAG_GRANTED : 0);
+    #ifdef PIN_NUM_GATE
+                if (granted) {
+                    gate_open();
+                }
+    #endif
+                access_cache_stats_t as = access_cache_stats();
+                SCAN_LOGI("ACCESS", "%s in %lld us (tap to decision %lld us), %lu keyfobs, version %lu%s\n",
+                    granted ? "Granted" : "Denied", (long long)as.last_lookup_us,
+                    (long long)(esp_timer_get_time() - scan_start), (unsigned long)as.entries,
+                    (unsigned long)as.version, access_cache_synced() ? "" : " (never synced)");
+    #endif
+                
+                int64_t enqueue_start = esp_timer_get_time();
+                bool queued = scan_queue_push(&rec);
+                int64_t enqueue_time = esp_timer_get_time() - enqueue_start;
+                if (queued) {
+                    telemetry_count(TM_SCANS);
+                    xTaskNotifyGive(upload_task_handle);
+                    SCAN_LOGD("QUEUE", "Scan %lu (%s, facility %u) queued in %lld us (tap to enqueue %lld us)\n",
+                        (unsigned long)rec.seq, rec.direction == SCAN_DIR_OUT ? "out" : "in",
+                        rec.facility_id, (long long)enqueue_time,
+                        (long long)(esp_timer_get_time() - scan_start));
+                } else {
+                    SCAN_LOGW("QUEUE", "Full, scan dropped\n");
+                }
+            } else {
+                telemetry_count(TM_SCANS_SUPPRESSED);
+                scan_debounce_stats_t ds = scan_debounce_stats();
+                SCAN_LOGD("DEBOUNCE", "Same card detected recently, waiting... (%lu repeats, %lu suppressed in total)\n",
+                    (unsigned long)repeats, (unsigned long)ds.suppressed);
+            }
+        }
+    }
+
+    // vTaskDelay() for at least us; pdMS_TO_TICKS() rounds short waits down to nothing
+    static void delay_us(int64_t us) {
+        TickType_t ticks = (us * configTICK_RATE_HZ + 999999) / 1000000;
+        vTaskDelay(ticks ? ticks : 1);
+    }
+
+    static void scan_pm_hold(bool hold) {
+    #ifdef CONFIG_PM_ENABLE
+        if (scan_pm_lock) {
+            if (hold) {
+                esp_pm_lock_acquire(scan_pm_lock);
+            } else {
+                esp_pm_lock_release(scan_pm_lock);
+            }
+        }
+    #endif
+    }
+
+    static void readers_power(reader_t *const *active, int count, bool on) {
+        for (int i = 0; i < count; i++) {
+            if (!rc522_power_down(&active[i]->dev, !on)) {
+                SCAN_LOGW("READER", "%d did not %s\n", (int)(active[i] - readers),
+                    on ? "wake up" : "power down");
+            }
+        }
+    }
+
+    // Producer: detect, read and enqueue; never touches the network
+    //
+    // Every round probes all readers together (rc522_probe_all overlaps their RF
+    // round trips), then reads the ones that saw a new card, so a second reader
+    // adds a few SPI frames per round rather than another probe timeout.
+    static void scan_task(void *arg) {
+        int poll_ms = PROBE_POLL_MS;
+        rc522_t *devs[READER_COUNT];
+        reader_t *active[READER_COUNT];
+        bool present[READER_COUNT];
+        int count = 0;
+
+        for (int i = 0; i < READER_COUNT; i++) {
+            if (readers[i].ready) {
+                active[count] = &readers[i];
+                devs[count] = &readers[i].dev;
+                count++;
+            }
+        }
+
+    #ifdef CONFIG_SCANNER_DETECT_IRQ
+        // Probe faster only when no reader has to be polled for its answer
+        bool all_irq = true;
+        for (int i = 0; i < count; i++) {
+            if (rc522_irq_enable(devs[i])) {
+                SCAN_LOGI("IRQ", "Reader %d card detection on GPIO %d\n",
+                    (int)(active[i] - readers), active[i]->cfg->pin_irq);
+            } else {
+                SCAN_LOGW("IRQ", "Reader %d IRQ line unavailable, falling back to polling\n",
+                    (int)(active[i] - readers));
+                all_irq = false;
+            }
+        }
+        if (all_irq) {
+            poll_ms = CONFIG_SCANNER_IRQ_PROBE_INTERVAL_MS;
+            SCAN_LOGI("IRQ", "Probe every %d ms\n", CONFIG_SCANNER_IRQ_PROBE_INTERVAL_MS);
+        }
+    #endif
+
+        // Without power saving this is a fixed interval with the field always on
+        scan_sched_config_t sched_cfg = {
+            .fast_us = poll_ms * 1000,
+            .idle_us = poll_ms * 1000,
+        };
+    #ifdef CONFIG_SCANNER_POWER_SAVE
+        sched_cfg.idle_us = CONFIG_SCANNER_PROBE_IDLE_MS * 1000;
+        if (sched_cfg.fast_us > sched_cfg.idle_us) {
+            sched_cfg.fast_us = sched_cfg.idle_us;
+        }
+        sched_cfg.hold_us = CONFIG_SCANNER_PROBE_ACTIVE_S * 1000000;
+        sched_cfg.sleep_min_us = PROBE_SLEEP_MIN_US;
+        sched_cfg.settle_us = RC522_FIELD_SETTLE_US;
+        SCAN_LOGI("POWER", "Probe every %lu ms after a card, %lu ms when idle, field off in between\n",
+            (unsigned long)(sched_cfg.fast_us / 1000), (unsigned long)(sched_cfg.idle_us / 1000));
+    #endif
+        scan_sched_t sched;
+        scan_sched_init(&sched, &sched_cfg, esp_timer_get_time());
+        int64_t field_on_ms = 0;            // already added to TM_FIELD_ON_MS
+
+        uint32_t scan_seq = 0;
+        scan_debounce_init((int64_t)CONFIG_SCANNER_DEBOUNCE_MS * 1000);
+        
+        while (1) {
+            scan_pm_hold(true);
+    #ifdef CONFIG_HEAP_USE_HOOKS
+            uint32_t allocs_start = mem_budget_allocs();
+    #endif
+            int64_t probe_start = esp_timer_get_time();
+            int64_t probe_gap = scan_sched_probe(&sched, probe_start);
+            rc522_probe_all(devs, count, present);
+            int64_t probe_time = esp_timer_get_time() - probe_start;
+            telemetry_count(TM_PROBES);
+            
+            bool any_present = false;
+            for (int i = 0; i < count; i++) {
+                reader_t *r = active[i];
+                int index = r - readers;
+                any_present |= present[i];
+                
+                if (present[i] && !r->card_present) {
+                    r->card_present = true;
+                    SCAN_LOGD("DETECTED", "Card found on reader %d (%s)!\n", index,
+                        r->cfg->direction == SCAN_DIR_OUT ? "out" : "in");
+                    // Polled readers only know the round took this long
+                    int64_t detect_us = probe_time;
+    #ifdef CONFIG_SCANNER_DETECT_IRQ
+                    if (r->dev.irq_mode) {
+                        rc522_irq_stats_t st = rc522_irq_stats_get(&r->dev);
+                        detect_us = st.last_detect_us;
+                        SCAN_LOGD("IRQ", "detect %lld us (avg %lld, max %lld), wake %lld us, %lu probes, %lu missed\n",
+                            (long long)st.last_detect_us,
+                            (long long)(st.detects ? st.total_detect_us / st.detects : 0),
+                            (long long)st.max_detect_us, (long long)st.last_wake_us,
+                            (unsigned long)st.probes, (unsigned long)st.missed);
+                    }
+    #endif
+                    telemetry_observe(TM_DETECT_US, index, (uint32_t)detect_us);
+                    telemetry_observe(TM_PROBE_GAP_US, index, (uint32_t)probe_gap);
+                    reader_scan(r, index, &scan_seq);
+                } else if (!present[i] && r->card_present) {
+                    r->card_present = false;
+                    SCAN_LOGD("REMOVED", "Card removed from reader %d\n\n", index);
+                } else if (!present[i]) {
+                    // Between taps only: the check reuses the timer and the FIFO
+                    spi_tune_watch(&r->tune, &r->dev);
+                }
+            }
+            
+    #ifdef CONFIG_HEAP_USE_HOOKS
+            // Probing and scanning run on static buffers only; an allocation here is a regression
+            uint32_t allocs = mem_budget_allocs() - allocs_start;
+            if (allocs > 0) {
+                SCAN_LOGE("MEM", "Scan round made %lu heap allocation(s)\n", (unsigned long)allocs);
+    #ifdef CONFIG_SCANNER_HEAP_CHECK
+                scan_log_flush();
+                abort();
+    #endif
+            }
+    #endif
+            
+            int64_t now = esp_timer_get_time();
+            int64_t wait_us = scan_sched_next(&sched, any_present, now);
+            scan_sched_stats_t st = scan_sched_stats(&sched, now);
+            telemetry_add(TM_FIELD_ON_MS, (uint32_t)(st.awake_us / 1000 - field_on_ms));
+            field_on_ms = st.awake_us / 1000;
+            scan_pm_hold(false);
+            
+            if (scan_sched_should_sleep(&sched, wait_us)) {
+                // Wake early enough for the tags in the field to power up
+                readers_power(active, count, false);
+                scan_sched_power(&sched, false, esp_timer_get_time());
+                delay_us(wait_us - RC522_FIELD_SETTLE_US);
+                readers_power(active, count, true);
+                scan_sched_power(&sched, true, esp_timer_get_time());
+                delay_us(RC522_FIELD_SETTLE_US);
+            } else {
+                delay_us(wait_us);
+            }
+        }
+    }
+
+    // main.c's share of the budget; the other modules add their own at init
+    static void mem_budget_register(void) {
+        mem_budget_add("scan queue", SCAN_QUEUE_LEN * sizeof(scan_record_t));
+        mem_budget_add("http client", HTTP_RX_BUF_LEN + HTTP_TX_BUF_LEN);
+        mem_budget_add("http response", HTTP_RESPONSE_MAX);
+    #ifdef CONFIG_SCANNER_UPLOAD_BATCH
+        mem_budget_add("upload batch", UPLOAD_BUF_LEN + UPLOAD_BATCH_MAX * sizeof(scan_record_t));
+    #endif
+    #ifdef CONFIG_SCANNER_ACCESS_CACHE
+        mem_budget_add("allowlist body", ACCESS_SYNC_BUF_LEN);
+    #endif
+    #if CONFIG_SCANNER_TELEMETRY_PUSH_INTERVAL_S > 0
+        mem_budget_add("telemetry push", TELEMETRY_PUSH_BUF_LEN);
+    #endif
     }
 
     void app_main(void) {
@@ -493,34 +1203,102 @@
         printf("       ESP32 RFID Reader with WiFi\n");
         printf("========================================\n\n");
         
+        // Everything after this is logged through the ring
+        scan_log_init();
+        
+    #ifdef CONFIG_PM_ENABLE
+        // Frequency scaling, and light sleep in idle time when tickless idle is on
+        esp_pm_config_t pm_config = {
+            .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+            .min_freq_mhz = PM_MIN_FREQ_MHZ,
+    #if defined(CONFIG_SCANNER_POWER_SAVE) && defined(CONFIG_FREERTOS_USE_TICKLESS_IDLE)
+            .light_sleep_enable = true,
+    #endif
+        };
+        esp_err_t pm_ret = esp_pm_configure(&pm_config);
+        if (pm_ret == ESP_OK) {
+            pm_ret = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "scan", &scan_pm_lock);
+        }
+        if (pm_ret != ESP_OK) {
+            SCAN_LOGW("POWER", "Power management not available: %s\n", esp_err_to_name(pm_ret));
+        }
+    #endif
+        
         // Initialize WiFi first
-        printf("[WiFi] Initializing WiFi...\n");
+        SCAN_LOGI("WiFi", "Initializing WiFi...\n");
         wifi_init_sta();
         
-        // Wait for WiFi connection
-        printf("[WiFi] Waiting for connection...\n");
-        for (int i = 0; i < 20; i++) {
-            printf(".");
-            vTaskDelay(pdMS_TO_TICKS(500));
+        // Unique per board, so the backend can tell replays from different scanners apart
+        uint8_t mac[6];
+        if (esp_read_mac(mac, ESP_MAC_WIFI_STA) == ESP_OK) {
+            snprintf(device_id, sizeof(device_id), DEVICE_NAME "-%02x%02x%02x%02x%02x%02x",
+                mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
         }
-        printf("\n");
+        boot_epoch = esp_random() | 1;
         
-        // Test GPIO pins
-        test_gpio_pins();
+    #ifdef CONFIG_SCANNER_JOURNAL
+        scan_journal_init();
+    #endif
+    #ifdef CONFIG_SCANNER_ACCESS_CACHE
+        access_cache_init();
+    #endif
+    #ifdef CONFIG_SCANNER_TAG_AUTH
+        tag_auth_init();
+    #endif
+    #ifdef PIN_NUM_GATE
+        gate_init();
+    #endif
+    #if CONFIG_SCANNER_TELEMETRY_PORT > 0
+        telemetry_server_start(CONFIG_SCANNER_TELEMETRY_PORT);
+    #endif
         
-        // Try to initialize RC522
-        if (!rc522_init()) {
+        // One bus, one device per reader
+        int ready_count = 0;
+        esp_err_t bus_ret = rc522_hal_esp_bus_init(SPI2_HOST, PIN_NUM_MISO, PIN_NUM_MOSI, PIN_NUM_CLK);
+        for (int i = 0; i < READER_COUNT && bus_ret == ESP_OK; i++) {
+            reader_t *r = &readers[i];
+            r->cfg = &reader_table[i];
+            
+            // Test GPIO pins
+            test_gpio_pins(r->cfg);
+            
+            // Try to initialize RC522
+            rc522_hal_esp_config_t reader_cfg = {
+                .host = SPI2_HOST,
+                .pin_cs = r->cfg->pin_cs,
+                .pin_rst = r->cfg->pin_rst,
+                .pin_irq = r->cfg->pin_irq,
+                .clock_hz = RC522_CLOCK_HZ,
+            };
+            r->ready = rc522_hal_esp_init(&r->hal, &reader_cfg) == ESP_OK &&
+                       rc522_init(&r->dev, &r->hal.hal);
+            if (r->ready) {
+                ready_count++;
+                uint32_t clock_hz = spi_tune_init(&r->tune, &r->dev, i);
+                SCAN_LOGI("READER", "%d on CS %d: %s, facility %u, SPI %lu kHz\n", i, r->cfg->pin_cs,
+                    r->cfg->direction == SCAN_DIR_OUT ? "out" : "in", r->cfg->facility_id,
+                    (unsigned long)(clock_hz / 1000));
+            } else {
+                SCAN_LOGW("READER", "%d on CS %d did not answer, skipped\n", i, r->cfg->pin_cs);
+            }
+        }
+        
+        if (ready_count == 0) {
+            // Straight to the console, after whatever the readers logged
+            scan_log_flush();
             printf("\n========================================\n");
             printf("FAILED: RC522 initialization failed!\n");
             printf("========================================\n\n");
             
             printf("TROUBLESHOOTING STEPS:\n");
             printf("1. Check all connections:\n");
-            printf("   - SDA/CS  (RC522 pin 5) -> GPIO 21\n");
-            printf("   - SCK     (RC522 pin 1) -> GPIO 18\n");
-            printf("   - MOSI    (RC522 pin 2) -> GPIO 23\n");
-            printf("   - MISO    (RC522 pin 3) -> GPIO 19\n");
-            printf("   - RST     (RC522 pin 6) -> GPIO 22\n");
+            for (int i = 0; i < READER_COUNT; i++) {
+                printf("   - Reader %d SDA/CS (RC522 pin 5) -> GPIO %d\n", i, reader_table[i].pin_cs);
+                printf("   - Reader %d RST    (RC522 pin 6) -> GPIO %d\n", i, reader_table[i].pin_rst);
+            }
+            printf("   - SCK     (RC522 pin 1) -> GPIO %d\n", PIN_NUM_CLK);
+            printf("   - MOSI    (RC522 pin 2) -> GPIO %d\n", PIN_NUM_MOSI);
+            printf("   - MISO    (RC522 pin 3) -> GPIO %d\n", PIN_NUM_MISO);
             printf("   - GND     (RC522 pin 4) -> ESP32 GND\n");
             printf("   - 3.3V    (RC522 pin 8) -> ESP32 3.3V\n");
             printf("2. Make sure RC522 is getting 3.3V (NOT 5V!)\n");
@@ -532,54 +1310,23 @@
             }
         }
         
-        printf("\n");
-        printf("RC522 is READY!\n");
-        printf("Place RFID card near the reader...\n\n");
+        SCAN_LOGI("BOOT", "RC522 is READY! Place RFID card near the reader...\n");
         
-        bool card_present = false;
-        uint32_t last_scan_time = 0;
+        // Reader on its own core so uploads never hold up the next tap
+        upload_task_handle = xTaskCreateStaticPinnedToCore(upload_task, "upload", UPLOAD_TASK_STACK, NULL,
+            UPLOAD_TASK_PRIO, upload_task_stack, &upload_task_tcb, UPLOAD_TASK_CORE);
+        mem_budget_task(upload_task_handle, sizeof(upload_task_stack));
+        TaskHandle_t scan_task_handle = xTaskCreateStaticPinnedToCore(scan_task, "scan", SCAN_TASK_STACK, NULL,
+            SCAN_TASK_PRIO, scan_task_stack, &scan_task_tcb, SCAN_TASK_CORE);
+        mem_budget_task(scan_task_handle, sizeof(scan_task_stack));
+        SCAN_LOGI("BOOT", "Reader ready %lld ms after boot\n", (long long)(esp_timer_get_time() / 1000));
+        mem_budget_register();
+        mem_budget_report();
         
-        while (1) {
-            bool detected = rc522_is_card_present();
-            
-            if (detected && !card_present) {
-                card_present = true;
-                printf("[DETECTED] Card found!\n");
-                
-                uint8_t uid[10] = {0};
-                if (rc522_read_uid(uid)) {
-                    // Convert UID to hex string
-                    char uid_hex[32] = {0};
-
-                    for (int i = 0; i < 4; i++) {
-                        char tmp[4];
-                        snprintf(tmp, sizeof(tmp), "%02X", uid[i]);
-                        strcat(uid_hex, tmp);
-                        if (i < 3) strcat(uid_hex, ":");
-                    }
-
-                    printf("[UID] %s\n", uid_hex);
-
-                    // Check if this is a new UID or enough time has passed
-                    uint32_t current_time = esp_timer_get_time() / 1000;
-                    if (strcmp(uid_hex, last_uid) != 0 || (current_time - last_scan_time) > 5000) {
-                        // Store this UID and timestamp
-                        strcpy(last_uid, uid_hex);
-                        last_scan_time = current_time;
-                        
-                        // Send to backend
-                        printf("[HTTP] Sending scan to backend...\n");
-                        send_scan_to_backend(uid_hex);
-                    } else {
-                        printf("[INFO] Same card detected recently, waiting...\n");
-                    }
-                }
-                
-            } else if (!detected && card_present) {
-                card_present = false;
-                printf("[REMOVED] Card removed\n\n");
-            }
-            
-            vTaskDelay(pdMS_TO_TICKS(500));
+        // Scans are kept until the link is up; this wait only reports a slow start
+        EventBits_t bits = xEventGroupWaitBits(wifi_events, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                               pdMS_TO_TICKS(WIFI_BOOT_WAIT_MS));
+        if (!(bits & WIFI_CONNECTED_BIT)) {
+            SCAN_LOGW("WiFi", "Not connected %d s after boot, still trying\n", WIFI_BOOT_WAIT_MS / 1000);
         }
-    }
\ No newline at end of file
+    }
@@ -0,0 +1,118 @@
+// Memory budget
+//
+// The allocation hook runs inside every malloc() in the system, ISRs and the
+// Wi-Fi task included, so it only compares the current task against a short table
+// and bumps an atomic; it must never allocate or log itself.
+#include <stdatomic.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "scan_log.h"
+#include "mem_budget.h"
+
+typedef struct {
+    const char *name;
+    size_t bytes;
+} region_t;
+
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t stack_bytes;
+    _Atomic uint32_t allocs;
+} watched_t;
+
+static region_t regions[MEM_BUDGET_REGIONS];
+static int region_count;
+static watched_t tasks[MEM_BUDGET_TASKS];
+static _Atomic int task_count;
+
+void mem_budget_add(const char *name, size_t bytes) {
+    if (region_count < MEM_BUDGET_REGIONS) {
+        regions[region_count++] = (region_t) {name, bytes};
+    }
+}
+
+void mem_budget_task(TaskHandle_t task, size_t stack_bytes) {
+    int n = atomic_load(&task_count);
+    if (!task || n >= MEM_BUDGET_TASKS) {
+        return;
+    }
+    tasks[n].handle = task;
+    tasks[n].stack_bytes = stack_bytes;
+    atomic_init(&tasks[n].allocs, 0);
+    // The hook only looks at entries below task_count
+    atomic_store(&task_count, n + 1);
+}
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    if (xPortInIsrContext()) {
+        return;
+    }
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int n = atomic_load_explicit(&task_count, memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        if (tasks[i].handle == self) {
+            atomic_fetch_add_explicit(&tasks[i].allocs, 1, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr) {
+}
+#endif
+
+uint32_t mem_budget_allocs(void) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int n = atomic_load(&task_count);
+    for (int i = 0; i < n; i++) {
+        if (tasks[i].handle == self) {
+            return atomic_load_explicit(&tasks[i].allocs, memory_order_relaxed);
+        }
+    }
+    return 0;
+}
+
+int mem_budget_tasks(mem_budget_task_t *out, int max) {
+    int n = atomic_load(&task_count);
+    if (n > max) {
+        n = max;
+    }
+    for (int i = 0; i < n; i++) {
+        out[i] = (mem_budget_task_t) {
+            .name = pcTaskGetName(tasks[i].handle),
+            .stack_bytes = tasks[i].stack_bytes,
+            // Bytes on ESP-IDF, where StackType_t is a byte
+            .stack_free = uxTaskGetStackHighWaterMark(tasks[i].handle),
+            .heap_allocs = atomic_load_explicit(&tasks[i].allocs, memory_order_relaxed),
+        };
+    }
+    return n;
+}
+
+void mem_budget_report(void) {
+    size_t total = 0;
+    for (int i = 0; i < region_count; i++) {
+        SCAN_LOGI("MEM", "%-20s %6u bytes\n", regions[i].name, (unsigned)regions[i].bytes);
+        total += regions[i].bytes;
+    }
+
+    mem_budget_task_t t[MEM_BUDGET_TASKS];
+    int n = mem_budget_tasks(t, MEM_BUDGET_TASKS);
+    for (int i = 0; i < n; i++) {
+        SCAN_LOGI("MEM", "%-20s %6lu bytes, %lu free\n", t[i].name, (unsigned long)t[i].stack_bytes,
+            (unsigned long)t[i].stack_free);
+        total += t[i].stack_bytes;
+    }
+
+    SCAN_LOGI("MEM", "Set aside at boot: %u bytes; heap free %u, largest block %u, low-water %u\n",
+        (unsigned)total, (unsigned)esp_get_free_heap_size(),
+        (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+        (unsigned)esp_get_minimum_free_heap_size());
+#ifndef CONFIG_HEAP_USE_HOOKS
+    SCAN_LOGW("MEM", "Heap allocations per task not counted, scan rounds are not checked (CONFIG_HEAP_USE_HOOKS is off)\n");
+#endif
+}
@@ -0,0 +1,42 @@
+// Memory budget
+//
+// Everything the scanner needs in steady state is set aside at boot: buffers are
+// static and the task stacks are handed to xTaskCreateStatic(), so after boot the
+// heap only serves Wi-Fi, lwIP and the HTTP client. Modules register what they set
+// aside and the boot report lists it next to what is left of the heap.
+//
+// With CONFIG_HEAP_USE_HOOKS the heap allocations of every registered task are
+// counted, so a task can check that a unit of work (one scan round) left the heap
+// alone; CONFIG_SCANNER_HEAP_CHECK makes the scan task abort when one did not.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define MEM_BUDGET_REGIONS  16
+#define MEM_BUDGET_TASKS    4
+
+typedef struct {
+    const char *name;
+    uint32_t stack_bytes;
+    uint32_t stack_free;        // least free stack since the task started
+    uint32_t heap_allocs;       // 0 without CONFIG_HEAP_USE_HOOKS
+} mem_budget_task_t;
+
+// A static region set aside at boot; call before mem_budget_report()
+void mem_budget_add(const char *name, size_t bytes);
+
+// A task on a static stack; counts towards the budget and is watched
+void mem_budget_task(TaskHandle_t task, size_t stack_bytes);
+
+// Heap allocations made by the calling task so far, or 0 when it is not registered
+// or allocations are not counted
+uint32_t mem_budget_allocs(void);
+
+int mem_budget_tasks(mem_budget_task_t *out, int max);
+
+// Log the regions, the task stacks and the heap
+void mem_budget_report(void);
@@ -0,0 +1,979 @@
+// MFRC522 driver
+//
+// Everything here goes through the rc522_hal_t of the reader, so the same code runs
+// on the ESP32 and against the simulator in scanner/host.
+#include <string.h>
+#include "rc522.h"
+#include "scan_log.h"
+
+#define RC522_VERSION_PAD     VersionReg      // harmless register to pad reads with
+
+static int64_t now_us(const rc522_t *dev) {
+    return dev->hal->now_us(dev->hal->ctx);
+}
+
+rc522_spi_stats_t rc522_spi_stats_get(const rc522_t *dev) {
+    return dev->spi_stats;
+}
+
+rc522_spi_stats_t rc522_spi_stats_since(const rc522_t *dev, const rc522_spi_stats_t *start) {
+    rc522_spi_stats_t d = {
+        .batches = dev->spi_stats.batches - start->batches,
+        .transactions = dev->spi_stats.transactions - start->transactions,
+        .bytes = dev->spi_stats.bytes - start->bytes,
+        .bus_time_us = dev->spi_stats.bus_time_us - start->bus_time_us,
+    };
+    return d;
+}
+
+rc522_irq_stats_t rc522_irq_stats_get(const rc522_t *dev) {
+    return dev->irq_stats;
+}
+
+rc522_link_stats_t rc522_link_stats_get(const rc522_t *dev) {
+    return dev->link_stats;
+}
+
+// Hand frames to the HAL and account for them
+static bool rc522_bus(rc522_t *dev, const rc522_hal_frame_t *frames, int count) {
+    int64_t start = now_us(dev);
+    bool ok = dev->hal->transfer(dev->hal->ctx, frames, count);
+    dev->spi_stats.bus_time_us += now_us(dev) - start;
+    dev->spi_stats.transactions += count;
+    for (int i = 0; i < count; i++) {
+        dev->spi_stats.bytes += frames[i].len;
+    }
+    if (!ok) dev->link_stats.bus_errors++;
+    return ok;
+}
+
+// Write a byte to the specified register
+bool rc522_write(rc522_t *dev, uint8_t reg, uint8_t value) {
+    uint8_t tx[2] = {(reg << 1) & 0x7E, value};
+    rc522_hal_frame_t f = {.tx = tx, .len = sizeof(tx)};
+    return rc522_bus(dev, &f, 1);
+}
+
+// Read a byte from the specified register
+uint8_t rc522_read(rc522_t *dev, uint8_t reg) {
+    uint8_t tx[2] = {((reg << 1) & 0x7E) | 0x80, 0x00};
+    uint8_t rx[2];
+    rc522_hal_frame_t f = {.tx = tx, .rx = rx, .len = sizeof(tx)};
+    if (!rc522_bus(dev, &f, 1)) {
+        SCAN_LOGE("RC522", "SPI read error for reg 0x%02X\n", reg);
+        return 0xFF;
+    }
+    return rx[1];
+}
+
+// Register batches
+//
+// The RC522 takes one address byte per CS assertion and then streams data for it:
+// a write frame sends N bytes to one register (a FIFO burst when reg is FIFODataReg),
+// a read frame sends a list of read addresses terminated by 0x00 and gets one
+// register value back per address. A batch collects frames and hands them to the
+// HAL in one go instead of one blocking call per register.
+static rc522_frame_t *rc522_batch_add(rc522_batch_t *b, size_t len) {
+    if (b->count >= RC522_HAL_MAX_FRAMES || len > RC522_HAL_FRAME_MAX) {
+        b->overflow = true;
+        return NULL;
+    }
+    rc522_frame_t *f = &b->frames[b->count++];
+    f->len = len;
+    f->out = NULL;
+    f->out_len = 0;
+    return f;
+}
+
+static void rc522_batch_begin(rc522_batch_t *b) {
+    b->count = 0;
+    b->overflow = false;
+}
+
+// Queue len bytes for a single register (FIFO writes go in one frame)
+static void rc522_batch_write_multi(rc522_batch_t *b, uint8_t reg, const uint8_t *data, size_t len) {
+    rc522_frame_t *f = rc522_batch_add(b, len + 1);
+    if (!f) return;
+    f->tx[0] = (reg << 1) & 0x7E;
+    memcpy(&f->tx[1], data, len);
+}
+
+static void rc522_batch_write(rc522_batch_t *b, uint8_t reg, uint8_t value) {
+    rc522_batch_write_multi(b, reg, &value, 1);
+}
+
+// Queue reads of n registers into out[0..n-1]; regs may repeat (FIFO burst)
+static void rc522_batch_read_regs(rc522_batch_t *b, const uint8_t *regs, size_t n, uint8_t *out) {
+    size_t len = n + 1;
+    // DMA reads need a word-sized length; pad with harmless VersionReg reads
+    if (len > 4) len = (len + 3) & ~3u;
+    rc522_frame_t *f = rc522_batch_add(b, len);
+    if (!f) return;
+    for (size_t i = 0; i < len - 1; i++) {
+        uint8_t reg = i < n ? regs[i] : RC522_VERSION_PAD;
+        f->tx[i] = ((reg << 1) & 0x7E) | 0x80;
+    }
+    f->tx[len - 1] = 0x00;
+    f->out = out;
+    f->out_len = n;
+}
+
+static void rc522_batch_read(rc522_batch_t *b, uint8_t reg, uint8_t *out) {
+    rc522_batch_read_regs(b, &reg, 1, out);
+}
+
+static void rc522_batch_read_fifo(rc522_batch_t *b, uint8_t *out, size_t n) {
+    uint8_t regs[RC522_HAL_FRAME_MAX];
+    if (n >= RC522_HAL_FRAME_MAX) {
+        b->overflow = true;
+        return;
+    }
+    memset(regs, FIFODataReg, n);
+    rc522_batch_read_regs(b, regs, n, out);
+}
+
+// Clock out every frame in the batch; read results land in the caller's buffers
+static bool rc522_batch_submit(rc522_t *dev, rc522_batch_t *b) {
+    rc522_hal_frame_t frames[RC522_HAL_MAX_FRAMES];
+
+    if (b->overflow) {
+        SCAN_LOGE("RC522", "SPI batch overflow (%d frames)\n", b->count);
+        return false;
+    }
+    if (b->count == 0) return true;
+
+    for (int i = 0; i < b->count; i++) {
+        rc522_frame_t *f = &b->frames[i];
+        frames[i].tx = f->tx;
+        frames[i].rx = f->out ? f->rx : NULL;
+        frames[i].len = f->len;
+    }
+    dev->spi_stats.batches++;
+    if (!rc522_bus(dev, frames, b->count)) {
+        SCAN_LOGE("RC522", "SPI batch error\n");
+        return false;
+    }
+
+    // Byte i + 1 carries the value of the address sent in byte i. The padding reads
+    // come for free as a link check: VersionReg never changes after init.
+    for (int i = 0; i < b->count; i++) {
+        rc522_frame_t *f = &b->frames[i];
+        if (!f->out) continue;
+        memcpy(f->out, &f->rx[1], f->out_len);
+        for (size_t j = f->out_len + 1; dev->version && j < f->len; j++) {
+            if (f->rx[j] != dev->version) {
+                dev->link_stats.errors++;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+#define RC522_WAKE_TIMEOUT_US 10000
+
+bool rc522_power_down(rc522_t *dev, bool down) {
+    if (down) {
+        return rc522_write(dev, CommandReg, PCD_POWERDOWN | PCD_IDLE);
+    }
+    if (!rc522_write(dev, CommandReg, PCD_IDLE)) return false;
+
+    // PowerDown reads back set until the oscillator runs again
+    int64_t deadline = now_us(dev) + RC522_WAKE_TIMEOUT_US;
+    while (rc522_read(dev, CommandReg) & PCD_POWERDOWN) {
+        if (now_us(dev) > deadline) {
+            SCAN_LOGE("RC522", "No wake-up from power-down\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+// SPI link check
+//
+// Each round writes a pattern to TReloadRegL/H in short frames and 32 bytes into
+// the FIFO in one burst, then reads all of it back in one more burst. The patterns
+// rotate through stuck lines (0xFF/0x00), adjacent-bit crosstalk (0xAA/0x55), a
+// walking one and zero, and pseudo-random data for late sampling.
+#define RC522_CHECK_LEN       32
+
+static void rc522_check_pattern(int round, uint8_t *buf, size_t len) {
+    uint32_t x = 0x9E3779B9u * (uint32_t)(round + 1);
+    for (size_t i = 0; i < len; i++) {
+        switch (round % 5) {
+        case 0: buf[i] = i & 1 ? 0x00 : 0xFF; break;
+        case 1: buf[i] = i & 1 ? 0x55 : 0xAA; break;
+        case 2: buf[i] = 1u << (i & 7); break;
+        case 3: buf[i] = ~(1u << (i & 7)); break;
+        default:
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            buf[i] = x >> 24;
+            break;
+        }
+    }
+}
+
+bool rc522_spi_check(rc522_t *dev, int rounds) {
+    static const uint8_t regs[] = {TReloadRegL, TReloadRegH, FIFOLevelReg};
+    uint8_t pattern[2 + RC522_CHECK_LEN];
+    uint8_t fifo[RC522_CHECK_LEN];
+    uint8_t values[sizeof(regs)];
+    bool ok = true;
+
+    for (int r = 0; r < rounds; r++) {
+        rc522_batch_t *b = &dev->batch;
+        uint32_t errors = dev->link_stats.errors;
+
+        rc522_check_pattern(r, pattern, sizeof(pattern));
+        rc522_batch_begin(b);
+        rc522_batch_write(b, TReloadRegL, pattern[0]);
+        rc522_batch_write(b, TReloadRegH, pattern[1]);
+        rc522_batch_write(b, FIFOLevelReg, 0x80);             // FlushBuffer
+        rc522_batch_write_multi(b, FIFODataReg, &pattern[2], RC522_CHECK_LEN);
+        rc522_batch_read_regs(b, regs, sizeof(regs), values);
+        rc522_batch_read_fifo(b, fifo, RC522_CHECK_LEN);
+
+        bool match = rc522_batch_submit(dev, b) &&
+                     values[0] == pattern[0] && values[1] == pattern[1] &&
+                     (values[2] & 0x7F) == RC522_CHECK_LEN &&
+                     memcmp(fifo, &pattern[2], RC522_CHECK_LEN) == 0;
+        // A bad pad byte fails the round too; count the round once either way
+        if (!match || dev->link_stats.errors != errors) {
+            dev->link_stats.errors = errors + 1;
+            ok = false;
+        }
+        dev->link_stats.checks++;
+    }
+    rc522_write(dev, FIFOLevelReg, 0x80);
+    return ok;
+}
+
+uint32_t rc522_spi_calibrate(rc522_t *dev, const uint32_t *rates, int count, int rounds) {
+    const rc522_hal_t *hal = dev->hal;
+    int pick = -1;
+
+    if (!hal->set_clock || count <= 0) return 0;
+
+    for (int i = 0; i < count; i++) {
+        if (!hal->set_clock(hal->ctx, rates[i])) break;
+        bool ok = rc522_spi_check(dev, rounds);
+        SCAN_LOGD("RC522", "SPI check at %lu Hz: %s\n", (unsigned long)rates[i], ok ? "ok" : "failed");
+        if (!ok) break;
+        pick = i;
+    }
+    // The margin: one step below the fastest rate that passed, whether or not a faster
+    // one failed, so a few clean rounds at the edge of the link are never relied on
+    if (pick > 0) pick--;
+
+    while (pick >= 0) {
+        if (hal->set_clock(hal->ctx, rates[pick]) && rc522_spi_check(dev, rounds)) {
+            return rates[pick];
+        }
+        pick--;
+    }
+    hal->set_clock(hal->ctx, rates[0]);
+    return 0;
+}
+
+// Test SPI communication
+static bool rc522_test_spi(rc522_t *dev) {
+    // Test 1: Write to version register (should always respond)
+    uint8_t version = rc522_read(dev, VersionReg);
+    SCAN_LOGD("RC522", "SPI test: version register (0x37) reads 0x%02X\n", version);
+
+    // Test 2: Write and read back from a test register
+    rc522_write(dev, TModeReg, 0x8D);
+    dev->hal->delay_ms(dev->hal->ctx, 10);
+    uint8_t readback = rc522_read(dev, TModeReg);
+    SCAN_LOGD("RC522", "SPI test: wrote 0x8D to TModeReg, read back 0x%02X\n", readback);
+
+    if (readback == 0x8D) {
+        return true;
+    } else {
+        SCAN_LOGE("RC522", "SPI communication failed: TModeReg read back 0x%02X\n", readback);
+        return false;
+    }
+}
+
+// Initialize RC522
+bool rc522_init(rc522_t *dev, const rc522_hal_t *hal) {
+    memset(dev, 0, sizeof(*dev));
+    dev->hal = hal;
+
+    // Hard reset
+    SCAN_LOGD("RC522", "Hard reset\n");
+    hal->reset(hal->ctx, true);
+    hal->delay_ms(hal->ctx, 100);
+    hal->reset(hal->ctx, false);
+    hal->delay_ms(hal->ctx, 50);
+
+    // Test SPI communication first
+    if (!rc522_test_spi(dev)) {
+        return false;
+    }
+
+    // Soft reset
+    rc522_write(dev, CommandReg, PCD_RESETPHASE);
+    hal->delay_ms(hal->ctx, 50);
+
+    // Check if chip is responding
+    uint8_t version = rc522_read(dev, VersionReg);
+    if (version == 0x00 || version == 0xFF) {
+        SCAN_LOGE("RC522", "Not responding (version 0x%02X): check wiring, 3.3V supply and the CS pull-up\n",
+            version);
+        return false;
+    }
+
+    // Configure RC522: TAuto timer at 25 us per tick, reload set per transfer
+    uint8_t tx_control = 0;
+    rc522_batch_t *b = &dev->batch;
+    rc522_batch_begin(b);
+    rc522_batch_write(b, TModeReg, 0x80);
+    rc522_batch_write(b, TPrescalerReg, 0xA9);
+    rc522_batch_write(b, TReloadRegL, 0xE8);
+    rc522_batch_write(b, TReloadRegH, 0x03);
+    rc522_batch_write(b, TxASKReg, 0x40);
+    rc522_batch_write(b, ModeReg, 0x3D);
+    rc522_batch_read(b, TxControlReg, &tx_control);
+    if (!rc522_batch_submit(dev, b)) {
+        return false;
+    }
+
+    // Enable antenna
+    rc522_write(dev, TxControlReg, tx_control | 0x03);
+
+    dev->version = version;
+    SCAN_LOGI("RC522", "Initialized, version 0x%02X\n", version);
+    return true;
+}
+
+// IRQ-driven completion
+//
+// Transfers still start over SPI, but instead of polling ComIrqReg the caller blocks
+// until the chip pulls IRQ low on RxIRq, IdleIRq or TimerIRq. ErrIRq is left out:
+// the chip raises it mid-frame (a collision, a parity error) while the answer is
+// still coming in, and ErrorReg is read once the frame has ended anyway.
+bool rc522_irq_enable(rc522_t *dev) {
+    const rc522_hal_t *hal = dev->hal;
+    if (!hal->irq_enable || !hal->irq_enable(hal->ctx)) {
+        return false;
+    }
+
+    rc522_batch_t *b = &dev->batch;
+    rc522_batch_begin(b);
+    rc522_batch_write(b, DivIEnReg, 0x80);    // IRQPushPull
+    rc522_batch_write(b, ComIEnReg, 0x80 |    // IRqInv, IRQ pin active low
+        RC522_IRQ_RX | RC522_IRQ_IDLE | RC522_IRQ_TIMER);
+    rc522_batch_write(b, ComIrqReg, 0x7F);
+    if (!rc522_batch_submit(dev, b)) {
+        return false;
+    }
+    dev->irq_mode = true;
+    return true;
+}
+
+// Transceive engine
+//
+// rc522_xfer_start() loads the FIFO, timer and command in one SPI batch.
+// rc522_xfer_poll() checks ComIrqReg once and, when the command finished or the
+// timer fired, collects error/collision state and the FIFO contents. It never
+// sleeps, so callers can interleave several transfers or block on the IRQ pin.
+bool rc522_xfer_start(rc522_t *dev, rc522_xfer_t *x) {
+    uint32_t ticks = x->timeout_us / RC522_TIMER_TICK_US;
+    if (ticks == 0) ticks = 1;
+    if (ticks > 0xFFFF) ticks = 0xFFFF;
+
+    x->state = RC522_XFER_BUSY;
+    x->status = RC522_ERROR;
+    x->rx_len = 0;
+    x->rx_last_bits = 0;
+    x->coll_pos = 0;
+
+    rc522_batch_t *b = &dev->batch;
+    rc522_batch_begin(b);
+    rc522_batch_write(b, CommandReg, PCD_IDLE);
+    rc522_batch_write(b, ComIrqReg, 0x7F);
+    rc522_batch_write(b, FIFOLevelReg, 0x80);
+    if (x->tx_len) {
+        rc522_batch_write_multi(b, FIFODataReg, x->tx, x->tx_len);
+    }
+    rc522_batch_write(b, TReloadRegH, ticks >> 8);
+    rc522_batch_write(b, TReloadRegL, ticks & 0xFF);
+    rc522_batch_write(b, BitFramingReg, (x->rx_align << 4) | (x->tx_last_bits & 0x07));
+    rc522_batch_write(b, CommandReg, x->command);
+    if (x->command == PCD_TRANSCEIVE) {
+        // StartSend
+        rc522_batch_write(b, BitFramingReg, 0x80 | (x->rx_align << 4) | (x->tx_last_bits & 0x07));
+    }
+    if (dev->irq_mode) {
+        dev->hal->irq_arm(dev->hal->ctx);
+    }
+
+    x->start_us = now_us(dev);
+    if (!rc522_batch_submit(dev, b)) {
+        x->state = RC522_XFER_DONE;
+        x->end_us = now_us(dev);
+        return false;
+    }
+    // Counted from the end of the batch, which on a slow bus takes longer than the
+    // answer. The chip timer only runs until the answer starts, so the backstop also
+    // allows for both frames on the air.
+    x->deadline_us = now_us(dev) + x->timeout_us + (x->tx_len + x->rx_max) * RC522_BYTE_AIR_US +
+        RC522_XFER_MARGIN_US;
+    return true;
+}
+
+static void rc522_xfer_finish(rc522_t *dev, rc522_xfer_t *x, rc522_status_t status) {
+    x->status = status;
+    x->state = RC522_XFER_DONE;
+    x->end_us = now_us(dev);
+}
+
+// Returns true once the transfer is done
+bool rc522_xfer_poll(rc522_t *dev, rc522_xfer_t *x) {
+    static const uint8_t result_regs[] = {ErrorReg, FIFOLevelReg, ControlReg, CollReg};
+    uint8_t result[4];
+
+    if (x->state != RC522_XFER_BUSY) {
+        return true;
+    }
+
+    uint8_t irq = rc522_read(dev, ComIrqReg);
+    uint8_t done_mask = x->command == PCD_TRANSCEIVE ? RC522_IRQ_RX | RC522_IRQ_IDLE : RC522_IRQ_IDLE;
+    if (!(irq & done_mask)) {
+        if ((irq & RC522_IRQ_TIMER) || now_us(dev) > x->deadline_us) {
+            rc522_write(dev, CommandReg, PCD_IDLE);
+            rc522_xfer_finish(dev, x, RC522_TIMEOUT);
+            return true;
+        }
+        return false;
+    }
+
+    // Stop the command and fetch error, FIFO level, RxLastBits and collision position
+    rc522_batch_t *b = &dev->batch;
+    rc522_batch_begin(b);
+    rc522_batch_write(b, CommandReg, PCD_IDLE);
+    if (x->command == PCD_TRANSMIT) {
+        // TStopNow: TAuto started the timer as the frame went out and nothing
+        // answers to stop it, so it would fire into the next transfer
+        rc522_batch_write(b, ControlReg, 0x80);
+    }
+    rc522_batch_read_regs(b, result_regs, sizeof(result_regs), result);
+    if (!rc522_batch_submit(dev, b)) {
+        rc522_xfer_finish(dev, x, RC522_ERROR);
+        return true;
+    }
+
+    uint8_t error = result[0];
+    uint8_t level = result[1] & 0x7F;
+    x->rx_last_bits = result[2] & 0x07;
+
+    // BufferOvfl, ParityErr, ProtocolErr
+    if (error & 0x13) {
+        rc522_xfer_finish(dev, x, RC522_ERROR);
+        return true;
+    }
+
+    if (level > x->rx_max) level = x->rx_max;
+    if (level && x->rx) {
+        rc522_batch_begin(b);
+        rc522_batch_read_fifo(b, x->rx, level);
+        if (!rc522_batch_submit(dev, b)) {
+            rc522_xfer_finish(dev, x, RC522_ERROR);
+            return true;
+        }
+    }
+    x->rx_len = level;
+
+    if (error & 0x08) {
+        // CollPosNotValid clear means CollPos holds the bit, 0 meaning 32
+        if (!(result[3] & 0x20)) {
+            uint8_t pos = result[3] & 0x1F;
+            x->coll_pos = pos ? pos : 32;
+        }
+        rc522_xfer_finish(dev, x, RC522_COLLISION);
+        return true;
+    }
+
+    rc522_xfer_finish(dev, x, RC522_OK);
+    return true;
+}
+
+// Run a transfer to completion: block on the IRQ pin when enabled, otherwise poll
+rc522_status_t rc522_transceive(rc522_t *dev, rc522_xfer_t *x) {
+    if (!rc522_xfer_start(dev, x)) {
+        return x->status;
+    }
+    while (!rc522_xfer_poll(dev, x)) {
+        if (dev->irq_mode) {
+            int64_t left_us = x->deadline_us - now_us(dev);
+            if (!dev->hal->irq_wait(dev->hal->ctx, left_us > 0 ? left_us : 0, &dev->irq_edge_us)) {
+                dev->irq_stats.missed++;
+            }
+        }
+    }
+    return x->status;
+}
+
+// CRC_A (ISO 14443-3): CRC-16/CCITT reflected, preset 0x6363, one table step per
+// byte. Cheaper on the host than a CalcCRC round trip, which costs two SPI batches
+// and a DivIrqReg poll per frame.
+static const uint16_t crc_a_table[256] = {
+    0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+    0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+    0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+    0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+    0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+    0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+    0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+    0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+    0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+    0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+    0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+    0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+    0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+    0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+    0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+    0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+    0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+    0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+    0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+    0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+    0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+    0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+    0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+    0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+    0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+    0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+    0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+    0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+    0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+    0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+    0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+    0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78,
+};
+
+void rc522_crc_a(const uint8_t *data, size_t len, uint8_t *crc_out) {
+    uint16_t crc = 0x6363;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ crc_a_table[(crc ^ data[i]) & 0xFF];
+    }
+    crc_out[0] = crc & 0xFF;
+    crc_out[1] = crc >> 8;
+}
+
+// True when the last two bytes are the CRC_A of the ones before
+static bool rc522_crc_a_ok(const uint8_t *data, size_t len) {
+    uint8_t crc[2];
+    if (len < 3) return false;
+    rc522_crc_a(data, len - 2, crc);
+    return crc[0] == data[len - 2] && crc[1] == data[len - 1];
+}
+
+// Send REQA or WUPA (7-bit short frame)
+rc522_status_t rc522_request(rc522_t *dev, uint8_t cmd, uint8_t *atqa) {
+    rc522_xfer_t x = {
+        .command = PCD_TRANSCEIVE,
+        .tx = &cmd,
+        .tx_len = 1,
+        .tx_last_bits = 7,
+        .rx = atqa,
+        .rx_max = 2,
+        .timeout_us = RC522_TIMEOUT_SHORT_US,
+    };
+    return rc522_transceive(dev, &x);
+}
+
+// WUPA so tags we halted after reading still count as present until they leave
+static const uint8_t probe_cmd = PICC_WUPA;
+
+static void rc522_probe_prepare(rc522_xfer_t *x, uint8_t *atqa) {
+    *x = (rc522_xfer_t) {
+        .command = PCD_TRANSCEIVE,
+        .tx = &probe_cmd,
+        .tx_len = 1,
+        .tx_last_bits = 7,
+        .rx = atqa,
+        .rx_max = 2,
+        .timeout_us = RC522_TIMEOUT_SHORT_US,
+    };
+}
+
+// Several cards answering at once still means a card is there
+static bool rc522_probe_result(rc522_t *dev, const rc522_xfer_t *x) {
+    bool present = x->status == RC522_OK || x->status == RC522_COLLISION;
+
+    if (dev->irq_mode) {
+        rc522_irq_stats_t *st = &dev->irq_stats;
+        st->probes++;
+        if (present && dev->irq_edge_us >= x->start_us) {
+            int64_t latency = dev->irq_edge_us - x->start_us;
+            int64_t wake = x->end_us - dev->irq_edge_us;
+            st->detects++;
+            st->last_detect_us = latency;
+            st->total_detect_us += latency;
+            if (latency > st->max_detect_us) st->max_detect_us = latency;
+            st->last_wake_us = wake;
+            if (wake > st->max_wake_us) st->max_wake_us = wake;
+        }
+    }
+    return present;
+}
+
+// Simple card detection
+bool rc522_is_card_present(rc522_t *dev) {
+    rc522_xfer_t x;
+    uint8_t atqa[2];
+    rc522_probe_prepare(&x, atqa);
+    rc522_transceive(dev, &x);
+    return rc522_probe_result(dev, &x);
+}
+
+// Card detection on several readers sharing a bus
+//
+// WUPA goes out on every reader before any answer is collected, so the RF round
+// trips overlap and N readers cost one probe timeout rather than N. Completion is
+// then polled round-robin; when every reader still busy has its IRQ line enabled
+// the caller blocks until one of them fires instead.
+void rc522_probe_all(rc522_t *const *devs, int count, bool *present) {
+    rc522_xfer_t x[RC522_PROBE_MAX];
+    uint8_t atqa[RC522_PROBE_MAX][2];
+
+    if (count > RC522_PROBE_MAX) count = RC522_PROBE_MAX;
+    for (int i = 0; i < count; i++) {
+        rc522_probe_prepare(&x[i], atqa[i]);
+        rc522_xfer_start(devs[i], &x[i]);
+    }
+
+    int busy;
+    do {
+        rc522_t *waiter = NULL;
+        bool irq_only = true;
+        int64_t deadline = 0;
+
+        busy = 0;
+        for (int i = 0; i < count; i++) {
+            if (rc522_xfer_poll(devs[i], &x[i])) continue;
+            busy++;
+            if (!devs[i]->irq_mode) {
+                irq_only = false;
+            } else if (!waiter || x[i].deadline_us < deadline) {
+                waiter = devs[i];
+                deadline = x[i].deadline_us;
+            }
+        }
+
+        if (busy && irq_only) {
+            int64_t left_us = deadline - now_us(waiter);
+            int64_t edge_us;
+            if (waiter->hal->irq_wait(waiter->hal->ctx, left_us > 0 ? left_us : 0, &edge_us)) {
+                // The readers share one wakeup, so whichever finishes next owns the edge
+                for (int i = 0; i < count; i++) {
+                    if (x[i].state == RC522_XFER_BUSY) devs[i]->irq_edge_us = edge_us;
+                }
+            } else {
+                waiter->irq_stats.missed++;
+            }
+        }
+    } while (busy);
+
+    for (int i = 0; i < count; i++) {
+        present[i] = rc522_probe_result(devs[i], &x[i]);
+    }
+}
+
+// Anticollision and select over cascade levels 1-3 for one tag in READY state
+rc522_status_t rc522_select(rc522_t *dev, rc522_uid_t *uid) {
+    static const uint8_t sel_cmds[] = {PICC_SEL_CL1, PICC_SEL_CL2, PICC_SEL_CL3};
+    uint8_t rx[5];
+
+    uid->size = 0;
+    uid->sak = 0;
+
+    for (int level = 0; level < 3; level++) {
+        // SEL, NVB, 4 UID bytes of this level, BCC, CRC_A
+        uint8_t buf[9] = {sel_cmds[level]};
+        uint8_t known = 0;      // UID bits of this level already fixed
+
+        // ANTICOLLISION: resend the known bits until one tag answers the rest cleanly
+        while (known < 32) {
+            uint8_t whole = known / 8;
+            uint8_t bits = known % 8;
+            buf[1] = ((2 + whole) << 4) | bits;
+
+            rc522_xfer_t x = {
+                .command = PCD_TRANSCEIVE,
+                .tx = buf,
+                .tx_len = 2 + whole + (bits ? 1 : 0),
+                .tx_last_bits = bits,
+                .rx_align = bits,
+                .rx = rx,
+                .rx_max = sizeof(rx),
+                .timeout_us = RC522_TIMEOUT_SHORT_US,
+            };
+            rc522_status_t status = rc522_transceive(dev, &x);
+            if (status != RC522_OK && status != RC522_COLLISION) {
+                return status;
+            }
+
+            // The answer continues right behind our last bit, so the first received
+            // byte shares its low bits with the partial byte we sent
+            uint8_t keep = (1 << bits) - 1;
+            for (int i = 0; i < x.rx_len && 2 + whole + i < 7; i++) {
+                uint8_t v = rx[i];
+                if (i == 0) v = (buf[2 + whole] & keep) | (v & ~keep);
+                buf[2 + whole + i] = v;
+            }
+
+            if (status == RC522_COLLISION) {
+                // CollPos counts from bit 0 of the first FIFO byte, RxAlign included
+                uint8_t pos = x.coll_pos ? whole * 8 + x.coll_pos : 0;
+                if (pos <= known || pos > 32) {
+                    return RC522_ERROR;
+                }
+                // Keep the tags that sent a 1 at the colliding bit
+                known = pos;
+                buf[2 + (pos - 1) / 8] |= 1 << ((pos - 1) % 8);
+            } else {
+                if (x.rx_len < 5 - whole) {
+                    return RC522_ERROR;
+                }
+                known = 32;
+            }
+        }
+
+        if ((buf[2] ^ buf[3] ^ buf[4] ^ buf[5]) != buf[6]) {
+            return RC522_ERROR;
+        }
+
+        // SELECT the tag we converged on; it answers with SAK + CRC_A
+        buf[1] = 0x70;
+        rc522_crc_a(buf, 7, &buf[7]);
+        rc522_xfer_t x = {
+            .command = PCD_TRANSCEIVE,
+            .tx = buf,
+            .tx_len = 9,
+            .rx = rx,
+            .rx_max = 3,
+            .timeout_us = RC522_TIMEOUT_SHORT_US,
+        };
+        rc522_status_t status = rc522_transceive(dev, &x);
+        if (status != RC522_OK) {
+            return status;
+        }
+        if (x.rx_len != 3 || x.rx_last_bits != 0 || !rc522_crc_a_ok(rx, 3)) {
+            return RC522_ERROR;
+        }
+        uint8_t sak = rx[0];
+
+        if (sak & PICC_SAK_CASCADE) {
+            // First byte of this level is the cascade tag, three UID bytes follow
+            if (buf[2] != PICC_CASCADE_TAG || level == 2) {
+                return RC522_ERROR;
+            }
+            memcpy(&uid->bytes[uid->size], &buf[3], 3);
+            uid->size += 3;
+        } else {
+            memcpy(&uid->bytes[uid->size], &buf[2], 4);
+            uid->size += 4;
+            uid->sak = sak;
+            return RC522_OK;
+        }
+    }
+    return RC522_ERROR;
+}
+
+// Put the selected tag into HALT so the next REQA only wakes the others. A halted
+// tag does not answer, so the frame is only transmitted: waiting out the timer for
+// the silence would add the whole timeout to every tag read.
+rc522_status_t rc522_halt(rc522_t *dev) {
+    uint8_t buf[4] = {PICC_HLTA, 0x00};
+    rc522_crc_a(buf, 2, &buf[2]);
+    rc522_xfer_t x = {
+        .command = PCD_TRANSMIT,
+        .tx = buf,
+        .tx_len = sizeof(buf),
+        .timeout_us = RC522_TIMEOUT_SHORT_US,
+    };
+    return rc522_transceive(dev, &x);
+}
+
+// MIFARE Classic three-pass authentication, run by the RC522 itself: the FIFO takes
+// the command, block, key and the last four UID bytes (AN10927 3.2.5, so 7-byte
+// UIDs work too). On success the chip sets MFCrypto1On and encrypts every frame
+// after it, HLTA included, until rc522_mifare_stop_crypto().
+rc522_status_t rc522_mifare_auth(rc522_t *dev, uint8_t key_cmd, uint8_t block, const uint8_t *key,
+                                 const rc522_uid_t *uid) {
+    uint8_t buf[2 + RC522_MF_KEY_SIZE + 4] = {key_cmd, block};
+    memcpy(&buf[2], key, RC522_MF_KEY_SIZE);
+    memcpy(&buf[2 + RC522_MF_KEY_SIZE], &uid->bytes[uid->size - 4], 4);
+
+    rc522_xfer_t x = {
+        .command = PCD_AUTHENT,
+        .tx = buf,
+        .tx_len = sizeof(buf),
+        .timeout_us = RC522_TIMEOUT_AUTH_US,
+    };
+    // A wrong key leaves the tag silent, so the timer ends the command
+    rc522_status_t status = rc522_transceive(dev, &x);
+    if (status != RC522_OK) {
+        return status;
+    }
+    if (!(rc522_read(dev, Status2Reg) & RC522_STATUS2_CRYPTO1_ON)) {
+        return RC522_ERROR;
+    }
+    dev->crypto_on = true;
+    return RC522_OK;
+}
+
+void rc522_mifare_stop_crypto(rc522_t *dev) {
+    if (!dev->crypto_on) return;
+    // The other writable bits (TempSensClear, I2CForceHS) stay at their reset value
+    rc522_write(dev, Status2Reg, 0x00);
+    dev->crypto_on = false;
+}
+
+// READ: 16 bytes from the selected tag, a MIFARE Classic block or four NTAG pages
+rc522_status_t rc522_tag_read(rc522_t *dev, uint8_t addr, uint8_t *out) {
+    uint8_t buf[4] = {PICC_READ, addr};
+    uint8_t rx[RC522_BLOCK_SIZE + 2];
+    rc522_crc_a(buf, 2, &buf[2]);
+
+    rc522_xfer_t x = {
+        .command = PCD_TRANSCEIVE,
+        .tx = buf,
+        .tx_len = sizeof(buf),
+        .rx = rx,
+        .rx_max = sizeof(rx),
+        .timeout_us = RC522_TIMEOUT_READ_US,
+    };
+    rc522_status_t status = rc522_transceive(dev, &x);
+    if (status != RC522_OK) {
+        return status;
+    }
+    // A 4-bit NAK means not authenticated or out of range
+    if (x.rx_len != sizeof(rx) || x.rx_last_bits != 0 || !rc522_crc_a_ok(rx, sizeof(rx))) {
+        return RC522_ERROR;
+    }
+    memcpy(out, rx, RC522_BLOCK_SIZE);
+    return RC522_OK;
+}
+
+// NTAG21x PWD_AUTH: the tag answers a matching password with its 2-byte PACK
+rc522_status_t rc522_ntag_pwd_auth(rc522_t *dev, const uint8_t *pwd, uint8_t *pack) {
+    uint8_t buf[1 + RC522_NTAG_PWD_SIZE + 2] = {PICC_NTAG_PWD_AUTH};
+    uint8_t rx[RC522_NTAG_PACK_SIZE + 2];
+    memcpy(&buf[1], pwd, RC522_NTAG_PWD_SIZE);
+    rc522_crc_a(buf, 1 + RC522_NTAG_PWD_SIZE, &buf[1 + RC522_NTAG_PWD_SIZE]);
+
+    rc522_xfer_t x = {
+        .command = PCD_TRANSCEIVE,
+        .tx = buf,
+        .tx_len = sizeof(buf),
+        .rx = rx,
+        .rx_max = sizeof(rx),
+        .timeout_us = RC522_TIMEOUT_READ_US,
+    };
+    rc522_status_t status = rc522_transceive(dev, &x);
+    if (status != RC522_OK) {
+        return status;
+    }
+    if (x.rx_len != sizeof(rx) || x.rx_last_bits != 0 || !rc522_crc_a_ok(rx, sizeof(rx))) {
+        return RC522_ERROR;
+    }
+    memcpy(pack, rx, RC522_NTAG_PACK_SIZE);
+    return RC522_OK;
+}
+
+rc522_tag_type_t rc522_tag_type(const rc522_uid_t *uid) {
+    // SAK 0x08 marks MIFARE Classic (Mini, 1K, 4K); plain 0x00 is a type 2 tag
+    if ((uid->sak & 0x08) && !(uid->sak & PICC_SAK_ISO14443_4)) return RC522_TAG_MIFARE_CLASSIC;
+    if (uid->sak == 0x00) return RC522_TAG_NTAG;
+    return RC522_TAG_OTHER;
+}
+
+// Unlock and read one 16-byte block of the selected tag: Classic sector key A or
+// NTAG password, whichever the SAK calls for. An NTAG whose PACK does not match
+// is treated as a failed read: the tag did not prove it knows the password.
+rc522_status_t rc522_read_protected(rc522_t *dev, const rc522_uid_t *uid, uint8_t addr,
+                                    const rc522_tag_key_t *key, uint8_t *out) {
+    rc522_status_t status;
+    uint8_t pack[RC522_NTAG_PACK_SIZE];
+
+    switch (rc522_tag_type(uid)) {
+    case RC522_TAG_MIFARE_CLASSIC:
+        status = rc522_mifare_auth(dev, PICC_MF_AUTH_KEY_A, addr, key->mf_key, uid);
+        break;
+    case RC522_TAG_NTAG:
+        status = rc522_ntag_pwd_auth(dev, key->ntag_pwd, pack);
+        if (status == RC522_OK && memcmp(pack, key->ntag_pack, RC522_NTAG_PACK_SIZE) != 0) {
+            status = RC522_ERROR;
+        }
+        break;
+    default:
+        return RC522_ERROR;
+    }
+    if (status != RC522_OK) {
+        return status;
+    }
+    return rc522_tag_read(dev, addr, out);
+}
+
+static bool rc522_uid_seen(const rc522_uid_t *uids, int count, const rc522_uid_t *uid) {
+    for (int i = 0; i < count; i++) {
+        if (uids[i].size == uid->size && memcmp(uids[i].bytes, uid->bytes, uid->size) == 0) return true;
+    }
+    return false;
+}
+
+// Read every tag in the field: select one, visit it, halt it, ask again.
+// Expects the tags in READY state, as left by rc522_is_card_present().
+int rc522_scan_tags_visit(rc522_t *dev, rc522_uid_t *uids, int max, rc522_tag_fn fn, void *arg) {
+    uint8_t atqa[2];
+    int found = 0;
+    int misses = 0;
+    bool need_request = false;
+
+    while (found < max && misses < 2) {
+        if (need_request) {
+            // Tags that lost the previous round went back to IDLE on our HLTA and
+            // REQA wakes them, so silence means the field is empty. A garbled
+            // answer gets another try.
+            rc522_status_t status = rc522_request(dev, PICC_REQA, atqa);
+            if (status == RC522_TIMEOUT) {
+                break;
+            }
+            if (status != RC522_OK && status != RC522_COLLISION) {
+                misses++;
+                continue;
+            }
+        }
+        need_request = true;
+
+        if (rc522_select(dev, &uids[found]) != RC522_OK) {
+            misses++;
+            continue;
+        }
+        // A tag the visit knocked back to IDLE (failed authentication) answers the
+        // next REQA again: halt it this time and leave it out
+        if (rc522_uid_seen(uids, found, &uids[found])) {
+            rc522_halt(dev);
+            misses++;
+            continue;
+        }
+        misses = 0;
+        if (fn) {
+            fn(dev, &uids[found], found, arg);
+        }
+        rc522_halt(dev);
+        rc522_mifare_stop_crypto(dev);
+        found++;
+    }
+    return found;
+}
+
+int rc522_scan_tags(rc522_t *dev, rc522_uid_t *uids, int max) {
+    return rc522_scan_tags_visit(dev, uids, max, NULL, NULL);
+}
@@ -0,0 +1,200 @@
+// MFRC522 driver: register access, transceive engine and ISO 14443-3 type A
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "rc522_hal.h"
+#include "rc522_regs.h"
+
+#define RC522_UID_MAX         10       // triple size UID
+#define RC522_MAX_TAGS        4        // tags enumerated per detection
+#define RC522_PROBE_MAX       4        // readers probed together by rc522_probe_all()
+
+#define RC522_TIMER_TICK_US     25      // TPrescaler 0xA9: 13.56 MHz / 339 = 40 kHz
+#define RC522_TIMEOUT_SHORT_US  300     // REQA/anticollision/select answer starts after ~90 us
+#define RC522_XFER_MARGIN_US    300     // backstop slack on top of the chip timer and air time
+#define RC522_BYTE_AIR_US       85      // one byte plus parity at 106 kbit/s
+#define RC522_TIMEOUT_AUTH_US   5000    // MFAuthent: two round trips plus the tag's crypto
+#define RC522_TIMEOUT_READ_US   5000    // READ, PWD_AUTH: answer within ~2.5 ms on Classic
+
+#define RC522_BLOCK_SIZE        16      // READ answer: a Classic block, four NTAG pages
+#define RC522_MF_KEY_SIZE       6
+#define RC522_NTAG_PWD_SIZE     4
+#define RC522_NTAG_PACK_SIZE    2
+
+// Bus usage counters, so the cost of an operation can be measured as a delta
+typedef struct {
+    uint32_t batches;           // rc522 batch submits
+    uint32_t transactions;      // SPI frames clocked out (one CS assertion each)
+    uint32_t bytes;             // bytes clocked out
+    int64_t  bus_time_us;       // time spent waiting on the HAL
+} rc522_spi_stats_t;
+
+// SPI link health: readback mismatches point at a clock the wiring cannot carry
+typedef struct {
+    uint32_t checks;            // rc522_spi_check() rounds
+    uint32_t errors;            // failed check rounds plus VersionReg pad bytes read back wrong
+    uint32_t bus_errors;        // transfers the HAL reported as failed
+} rc522_link_stats_t;
+
+typedef struct {
+    uint32_t probes;            // presence checks sent with the IRQ line enabled
+    uint32_t detects;           // probes answered by a card
+    uint32_t missed;            // waits that ended without an edge
+    int64_t  last_detect_us;    // WUPA armed -> IRQ edge for the last detect
+    int64_t  max_detect_us;
+    int64_t  total_detect_us;
+    int64_t  last_wake_us;      // IRQ edge -> caller running again
+    int64_t  max_wake_us;
+} rc522_irq_stats_t;
+
+// Transceive results
+typedef enum {
+    RC522_OK = 0,
+    RC522_TIMEOUT,              // no answer before the RC522 timer (or the backstop) ran out
+    RC522_COLLISION,            // CollErr set, see coll_pos
+    RC522_ERROR,                // protocol, parity, FIFO overflow or SPI error
+} rc522_status_t;
+
+typedef enum {
+    RC522_XFER_IDLE = 0,
+    RC522_XFER_BUSY,            // command running, waiting for an IRQ bit
+    RC522_XFER_DONE,            // status and rx fields are valid
+} rc522_xfer_state_t;
+
+// One command/response exchange with the card
+typedef struct {
+    // Request
+    uint8_t command;            // PCD_TRANSCEIVE, PCD_TRANSMIT, ...
+    const uint8_t *tx;
+    uint8_t tx_len;
+    uint8_t tx_last_bits;       // valid bits in the last tx byte, 0 = all 8
+    uint8_t rx_align;           // bit position of the first received bit
+    uint8_t *rx;
+    uint8_t rx_max;
+    uint32_t timeout_us;        // loaded into the RC522 timer
+    // Result
+    rc522_xfer_state_t state;
+    rc522_status_t status;
+    uint8_t rx_len;
+    uint8_t rx_last_bits;       // valid bits in the last rx byte, 0 = all 8
+    uint8_t coll_pos;           // first colliding bit (1..32), 0 if unknown
+    int64_t start_us;
+    int64_t deadline_us;        // backstop in case the IRQ bits never show up
+    int64_t end_us;
+} rc522_xfer_t;
+
+// UID as selected from the card
+typedef struct {
+    uint8_t size;               // 4, 7 or 10 bytes
+    uint8_t bytes[RC522_UID_MAX];
+    uint8_t sak;
+} rc522_uid_t;
+
+// A register frame: one address byte per CS assertion, then data for it
+typedef struct {
+    uint8_t tx[RC522_HAL_FRAME_MAX] __attribute__((aligned(4)));
+    uint8_t rx[RC522_HAL_FRAME_MAX] __attribute__((aligned(4)));
+    uint8_t len;                // bytes clocked, including padding
+    uint8_t out_len;            // register values to copy back
+    uint8_t *out;               // NULL for write frames
+} rc522_frame_t;
+
+typedef struct {
+    rc522_frame_t frames[RC522_HAL_MAX_FRAMES];
+    int count;
+    bool overflow;
+} rc522_batch_t;
+
+// One reader. Large (the batch buffers), so keep it static rather than on a stack.
+// A reader is driven from one task at a time.
+typedef struct {
+    const rc522_hal_t *hal;
+    uint8_t version;            // VersionReg, known after rc522_init()
+    bool irq_mode;
+    bool crypto_on;             // MFCrypto1On set by rc522_mifare_auth()
+    int64_t irq_edge_us;        // last edge reported by the HAL
+    rc522_spi_stats_t spi_stats;
+    rc522_irq_stats_t irq_stats;
+    rc522_link_stats_t link_stats;
+    rc522_batch_t batch;
+} rc522_t;
+
+// Reset the chip, check it answers and configure timer and antenna
+bool rc522_init(rc522_t *dev, const rc522_hal_t *hal);
+
+// Wait on the IRQ line instead of polling ComIrqReg; false when the HAL has none
+bool rc522_irq_enable(rc522_t *dev);
+
+bool rc522_write(rc522_t *dev, uint8_t reg, uint8_t value);
+uint8_t rc522_read(rc522_t *dev, uint8_t reg);
+
+// Soft power-down: oscillator and RF field off, register contents kept. Waking
+// waits for the oscillator; tags in the field lost their power meanwhile and need
+// RC522_FIELD_SETTLE_US before they can answer a probe.
+#define RC522_FIELD_SETTLE_US   5000    // ISO 14443-3: PICC ready within 5 ms of field on
+bool rc522_power_down(rc522_t *dev, bool down);
+
+// Write patterns to the timer reload registers and the FIFO and read them back,
+// short and burst frames alike; true when every round matched. Call only between
+// transfers: it leaves the FIFO empty and the reload value for the next transfer to set.
+bool rc522_spi_check(rc522_t *dev, int rounds);
+// Step the clock up through rates (ascending, rates[0] known to work) while
+// rc522_spi_check() passes, then settle one step below the fastest rate that passed
+// (rates[0] when only that one did). Returns the rate left set, or 0 when the HAL has
+// no set_clock or rates[0] fails too.
+uint32_t rc522_spi_calibrate(rc522_t *dev, const uint32_t *rates, int count, int rounds);
+
+// Transceive engine
+bool rc522_xfer_start(rc522_t *dev, rc522_xfer_t *x);
+bool rc522_xfer_poll(rc522_t *dev, rc522_xfer_t *x);
+rc522_status_t rc522_transceive(rc522_t *dev, rc522_xfer_t *x);
+
+// CRC_A (ISO 14443-3) computed on the host, low byte first
+void rc522_crc_a(const uint8_t *data, size_t len, uint8_t *crc_out);
+
+// Card operations
+rc522_status_t rc522_request(rc522_t *dev, uint8_t cmd, uint8_t *atqa);
+bool rc522_is_card_present(rc522_t *dev);
+// rc522_is_card_present() on up to RC522_PROBE_MAX readers, their probes overlapped
+void rc522_probe_all(rc522_t *const *devs, int count, bool *present);
+rc522_status_t rc522_select(rc522_t *dev, rc522_uid_t *uid);
+rc522_status_t rc522_halt(rc522_t *dev);
+int rc522_scan_tags(rc522_t *dev, rc522_uid_t *uids, int max);
+
+// Called for each tag while it is selected, before rc522_scan_tags_visit() halts it;
+// index is its position in uids. The visit may leave Crypto1 on, the scan stops it.
+typedef void (*rc522_tag_fn)(rc522_t *dev, const rc522_uid_t *uid, int index, void *arg);
+int rc522_scan_tags_visit(rc522_t *dev, rc522_uid_t *uids, int max, rc522_tag_fn fn, void *arg);
+
+// Tag memory, on the tag selected last
+typedef enum {
+    RC522_TAG_OTHER = 0,        // nothing this driver can unlock, e.g. ISO-DEP
+    RC522_TAG_MIFARE_CLASSIC,
+    RC522_TAG_NTAG,             // NTAG21x and other type 2 tags with PWD_AUTH
+} rc522_tag_type_t;
+
+// What unlocks a protected block: a Classic sector key A, or an NTAG password and
+// the PACK the tag has to answer it with
+typedef struct {
+    uint8_t mf_key[RC522_MF_KEY_SIZE];
+    uint8_t ntag_pwd[RC522_NTAG_PWD_SIZE];
+    uint8_t ntag_pack[RC522_NTAG_PACK_SIZE];
+} rc522_tag_key_t;
+
+rc522_tag_type_t rc522_tag_type(const rc522_uid_t *uid);
+rc522_status_t rc522_mifare_auth(rc522_t *dev, uint8_t key_cmd, uint8_t block, const uint8_t *key,
+                                 const rc522_uid_t *uid);
+void rc522_mifare_stop_crypto(rc522_t *dev);
+rc522_status_t rc522_ntag_pwd_auth(rc522_t *dev, const uint8_t *pwd, uint8_t *pack);
+// 16 bytes from block (Classic) or page (NTAG) addr
+rc522_status_t rc522_tag_read(rc522_t *dev, uint8_t addr, uint8_t *out);
+// Authenticate as the tag type calls for, then rc522_tag_read()
+rc522_status_t rc522_read_protected(rc522_t *dev, const rc522_uid_t *uid, uint8_t addr,
+                                    const rc522_tag_key_t *key, uint8_t *out);
+
+rc522_spi_stats_t rc522_spi_stats_get(const rc522_t *dev);
+rc522_spi_stats_t rc522_spi_stats_since(const rc522_t *dev, const rc522_spi_stats_t *start);
+rc522_irq_stats_t rc522_irq_stats_get(const rc522_t *dev);
+rc522_link_stats_t rc522_link_stats_get(const rc522_t *dev);
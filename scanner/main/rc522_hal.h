@@ -0,0 +1,40 @@
+// Bus, pin and clock access for the RC522 driver
+//
+// The driver never talks to the SPI peripheral or GPIOs itself; it hands frames to
+// a HAL. rc522_hal_esp.c implements it on ESP-IDF, the host build under scanner/host
+// implements it on top of a simulated chip.
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RC522_HAL_MAX_FRAMES    16     // frames per transfer() call
+#define RC522_HAL_FRAME_MAX     68     // address byte + 64-byte FIFO, padded to a word
+
+// One CS assertion. rx is NULL for write frames; otherwise rx[i] receives the byte
+// clocked in while tx[i] went out.
+typedef struct {
+    const uint8_t *tx;
+    uint8_t *rx;
+    uint8_t len;
+} rc522_hal_frame_t;
+
+typedef struct {
+    // Clock out the frames in order; false on a bus error
+    bool (*transfer)(void *ctx, const rc522_hal_frame_t *frames, int count);
+    // Drive NRSTPD; true holds the chip in reset
+    void (*reset)(void *ctx, bool active);
+    void (*delay_ms)(void *ctx, uint32_t ms);
+    int64_t (*now_us)(void *ctx);
+    // Change the SPI clock between transfers; NULL when it is fixed
+    bool (*set_clock)(void *ctx, uint32_t hz);
+
+    // IRQ line, all NULL when it is not wired
+    bool (*irq_enable)(void *ctx);
+    // Forget edges seen so far, before starting a command
+    void (*irq_arm)(void *ctx);
+    // Wait for an edge; false on timeout. *edge_us is when the edge happened
+    bool (*irq_wait)(void *ctx, int64_t timeout_us, int64_t *edge_us);
+
+    void *ctx;
+} rc522_hal_t;
@@ -0,0 +1,214 @@
+// RC522 HAL for ESP-IDF
+//
+// Batches of fewer than RC522_QUEUE_MIN_FRAMES frames are polled; longer ones keep
+// up to RC522_SPI_QUEUE_SIZE transactions queued so the driver chains them. Frames
+// of up to four bytes travel in the transaction itself, without DMA descriptors.
+#include <string.h>
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "rc522_hal_esp.h"
+#include "scan_log.h"
+
+esp_err_t rc522_hal_esp_bus_init(spi_host_device_t host, int pin_miso, int pin_mosi, int pin_sclk) {
+    spi_bus_config_t buscfg = {
+        .miso_io_num = pin_miso,
+        .mosi_io_num = pin_mosi,
+        .sclk_io_num = pin_sclk,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+        .max_transfer_sz = RC522_HAL_FRAME_MAX,
+        .flags = 0,
+    };
+    esp_err_t ret = spi_bus_initialize(host, &buscfg, SPI_DMA_CH_AUTO);
+    if (ret != ESP_OK) {
+        SCAN_LOGE("SPI", "Bus init failed: %s\n", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static void frame_prepare(spi_transaction_t *t, const rc522_hal_frame_t *f) {
+    memset(t, 0, sizeof(*t));
+    t->length = f->len * 8;
+    if (f->len <= 4) {
+        t->flags = SPI_TRANS_USE_TXDATA | (f->rx ? SPI_TRANS_USE_RXDATA : 0);
+        memcpy(t->tx_data, f->tx, f->len);
+    } else {
+        t->tx_buffer = f->tx;
+        t->rx_buffer = f->rx;
+    }
+}
+
+static void frame_finish(const spi_transaction_t *t, const rc522_hal_frame_t *f) {
+    if (f->rx && (t->flags & SPI_TRANS_USE_RXDATA)) {
+        memcpy(f->rx, t->rx_data, f->len);
+    }
+}
+
+static bool hal_transfer(void *ctx, const rc522_hal_frame_t *frames, int count) {
+    rc522_hal_esp_t *h = ctx;
+    esp_err_t ret = ESP_OK;
+
+    if (count > RC522_HAL_MAX_FRAMES) {
+        return false;
+    }
+    if (count < RC522_QUEUE_MIN_FRAMES) {
+        for (int i = 0; i < count && ret == ESP_OK; i++) {
+            frame_prepare(&h->trans[i], &frames[i]);
+            ret = spi_device_polling_transmit(h->spi, &h->trans[i]);
+        }
+    } else {
+        // Keep up to queue_size transactions in flight so the driver chains them
+        int queued = 0, done = 0;
+        while (done < count) {
+            while (ret == ESP_OK && queued < count && queued - done < RC522_SPI_QUEUE_SIZE) {
+                frame_prepare(&h->trans[queued], &frames[queued]);
+                ret = spi_device_queue_trans(h->spi, &h->trans[queued], portMAX_DELAY);
+                if (ret != ESP_OK) break;
+                queued++;
+            }
+            if (done == queued) break;
+            spi_transaction_t *t;
+            esp_err_t r = spi_device_get_trans_result(h->spi, &t, portMAX_DELAY);
+            if (ret == ESP_OK) ret = r;
+            done++;
+        }
+    }
+
+    if (ret != ESP_OK) {
+        SCAN_LOGE("SPI", "Error on CS %d: %s\n", h->cfg.pin_cs, esp_err_to_name(ret));
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        frame_finish(&h->trans[i], &frames[i]);
+    }
+    return true;
+}
+
+static esp_err_t device_add(rc522_hal_esp_t *h) {
+    spi_device_interface_config_t devcfg = {
+        .clock_speed_hz = h->cfg.clock_hz,
+        .mode = 0,                     // SPI Mode 0
+        .spics_io_num = h->cfg.pin_cs,
+        .queue_size = RC522_SPI_QUEUE_SIZE,
+        .flags = 0,
+    };
+    return spi_bus_add_device(h->cfg.host, &devcfg, &h->spi);
+}
+
+// The driver fixes the clock per device, so re-add the device with the new one.
+// Nothing is in flight between transfer() calls.
+static bool hal_set_clock(void *ctx, uint32_t hz) {
+    rc522_hal_esp_t *h = ctx;
+    int old_hz = h->cfg.clock_hz;
+
+    if ((int)hz == old_hz) return true;
+    spi_bus_remove_device(h->spi);
+    h->cfg.clock_hz = hz;
+    esp_err_t ret = device_add(h);
+    if (ret != ESP_OK) {
+        SCAN_LOGW("SPI", "%lu Hz not possible on CS %d: %s\n", (unsigned long)hz, h->cfg.pin_cs,
+            esp_err_to_name(ret));
+        h->cfg.clock_hz = old_hz;
+        device_add(h);
+        return false;
+    }
+    return true;
+}
+
+static void hal_reset(void *ctx, bool active) {
+    rc522_hal_esp_t *h = ctx;
+    gpio_set_level(h->cfg.pin_rst, active ? 0 : 1);
+}
+
+static void hal_delay_ms(void *ctx, uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+static int64_t hal_now_us(void *ctx) {
+    return esp_timer_get_time();
+}
+
+// Every reader notifies the task driving it, usually the same one for all of them,
+// so a wakeup reports the most recent edge on any reader
+static volatile int64_t irq_last_edge_us;
+
+static void IRAM_ATTR hal_irq_isr(void *arg) {
+    rc522_hal_esp_t *h = arg;
+    BaseType_t woken = pdFALSE;
+    h->irq_edge_us = esp_timer_get_time();
+    irq_last_edge_us = h->irq_edge_us;
+    if (h->irq_task) {
+        vTaskNotifyGiveFromISR(h->irq_task, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+static bool hal_irq_enable(void *ctx) {
+    rc522_hal_esp_t *h = ctx;
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << h->cfg.pin_irq,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    esp_err_t ret = gpio_config(&io);
+    if (ret == ESP_OK) {
+        ret = gpio_install_isr_service(0);
+        // Already installed by someone else is fine
+        if (ret == ESP_ERR_INVALID_STATE) ret = ESP_OK;
+    }
+    if (ret == ESP_OK) {
+        h->irq_task = xTaskGetCurrentTaskHandle();
+        ret = gpio_isr_handler_add(h->cfg.pin_irq, hal_irq_isr, h);
+    }
+    if (ret != ESP_OK) {
+        SCAN_LOGW("IRQ", "GPIO %d setup failed: %s\n", h->cfg.pin_irq, esp_err_to_name(ret));
+        return false;
+    }
+    return true;
+}
+
+static void hal_irq_arm(void *ctx) {
+    ulTaskNotifyTake(pdTRUE, 0);
+}
+
+static bool hal_irq_wait(void *ctx, int64_t timeout_us, int64_t *edge_us) {
+    TickType_t ticks = pdMS_TO_TICKS(timeout_us / 1000);
+    if (ulTaskNotifyTake(pdTRUE, ticks ? ticks : 1) == 0) {
+        return false;
+    }
+    *edge_us = irq_last_edge_us;
+    return true;
+}
+
+esp_err_t rc522_hal_esp_init(rc522_hal_esp_t *h, const rc522_hal_esp_config_t *cfg) {
+    memset(h, 0, sizeof(*h));
+    h->cfg = *cfg;
+
+    gpio_reset_pin(cfg->pin_rst);
+    gpio_set_direction(cfg->pin_rst, GPIO_MODE_OUTPUT);
+    gpio_set_level(cfg->pin_rst, 1);
+
+    esp_err_t ret = device_add(h);
+    if (ret != ESP_OK) {
+        SCAN_LOGE("SPI", "Device add failed: %s\n", esp_err_to_name(ret));
+        return ret;
+    }
+
+    h->hal = (rc522_hal_t) {
+        .transfer = hal_transfer,
+        .reset = hal_reset,
+        .delay_ms = hal_delay_ms,
+        .now_us = hal_now_us,
+        .set_clock = hal_set_clock,
+        .ctx = h,
+    };
+    if (cfg->pin_irq >= 0) {
+        h->hal.irq_enable = hal_irq_enable;
+        h->hal.irq_arm = hal_irq_arm;
+        h->hal.irq_wait = hal_irq_wait;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,36 @@
+// RC522 HAL on the ESP-IDF SPI master driver and GPIOs
+#pragma once
+
+#include <stdint.h>
+#include "driver/spi_master.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "rc522_hal.h"
+
+#define RC522_SPI_QUEUE_SIZE    7       // transactions in flight for long batches
+#define RC522_QUEUE_MIN_FRAMES  3       // smaller batches are cheaper to poll
+
+typedef struct {
+    spi_host_device_t host;
+    int pin_cs;
+    int pin_rst;
+    int pin_irq;                // -1 when not wired
+    int clock_hz;
+} rc522_hal_esp_config_t;
+
+typedef struct {
+    rc522_hal_t hal;            // pass &h->hal to rc522_init()
+    rc522_hal_esp_config_t cfg;
+    spi_device_handle_t spi;
+    spi_transaction_t trans[RC522_HAL_MAX_FRAMES];
+    TaskHandle_t irq_task;      // task blocked in irq_wait()
+    volatile int64_t irq_edge_us;
+} rc522_hal_esp_t;
+
+// Shared by every reader on the bus; call once
+esp_err_t rc522_hal_esp_bus_init(spi_host_device_t host, int pin_miso, int pin_mosi, int pin_sclk);
+
+// Add the reader to the bus. IRQ waits notify the task that later calls
+// rc522_irq_enable(), so do that from the task that drives the reader.
+esp_err_t rc522_hal_esp_init(rc522_hal_esp_t *h, const rc522_hal_esp_config_t *cfg);
@@ -0,0 +1,94 @@
+// MFRC522 registers and commands, and the ISO 14443-3 type A card commands
+#pragma once
+
+// RC522 Commands
+#define PCD_IDLE              0x00
+#define PCD_AUTHENT           0x0E
+#define PCD_RECEIVE           0x08
+#define PCD_TRANSMIT          0x04
+#define PCD_TRANSCEIVE        0x0C
+#define PCD_RESETPHASE        0x0F
+#define PCD_CALCCRC           0x03
+#define PCD_POWERDOWN         0x10      // CommandReg bit: soft power-down
+
+// RC522 Registers
+#define CommandReg            0x01
+#define ComIEnReg             0x02
+#define DivIEnReg             0x03
+#define ComIrqReg             0x04
+#define DivIrqReg             0x05
+#define ErrorReg              0x06
+#define Status1Reg            0x07
+#define Status2Reg            0x08
+#define FIFODataReg           0x09
+#define FIFOLevelReg          0x0A
+#define WaterLevelReg         0x0B
+#define ControlReg            0x0C
+#define BitFramingReg         0x0D
+#define CollReg               0x0E
+#define ModeReg               0x11
+#define TxModeReg             0x12
+#define RxModeReg             0x13
+#define TxControlReg          0x14
+#define TxASKReg              0x15
+#define TxSelReg              0x16
+#define RxSelReg              0x17
+#define RxThresholdReg        0x18
+#define DemodReg              0x19
+#define MfTxReg               0x1C
+#define MfRxReg               0x1D
+#define SerialSpeedReg        0x1F
+#define CRCResultRegH         0x21
+#define CRCResultRegL         0x22
+#define ModWidthReg           0x24
+#define RFCfgReg              0x26
+#define GsNReg                0x27
+#define CWGsPReg              0x28
+#define ModGsPReg             0x29
+#define TModeReg              0x2A
+#define TPrescalerReg         0x2B
+#define TReloadRegH           0x2C
+#define TReloadRegL           0x2D
+#define TCounterValueRegH     0x2E
+#define TCounterValueRegL     0x2F
+#define TestSel1Reg           0x31
+#define TestSel2Reg           0x32
+#define TestPinEnReg          0x33
+#define TestPinValueReg       0x34
+#define TestBusReg            0x35
+#define AutoTestReg           0x36
+#define VersionReg            0x37
+#define AnalogTestReg         0x38
+#define TestDAC1Reg           0x39
+#define TestDAC2Reg           0x3A
+#define TestADCReg            0x3B
+
+// PICC commands (ISO 14443-3 type A)
+#define PICC_REQA             0x26
+#define PICC_WUPA             0x52
+#define PICC_SEL_CL1          0x93
+#define PICC_SEL_CL2          0x95
+#define PICC_SEL_CL3          0x97
+#define PICC_HLTA             0x50
+#define PICC_CASCADE_TAG      0x88
+#define PICC_SAK_CASCADE      0x04     // UID not complete, go to the next cascade level
+#define PICC_SAK_ISO14443_4   0x20     // ISO-DEP, e.g. DESFire
+#define PICC_READ             0x30     // 16 bytes: one Classic block or four NTAG pages
+#define PICC_MF_AUTH_KEY_A    0x60
+#define PICC_MF_AUTH_KEY_B    0x61
+#define PICC_NTAG_PWD_AUTH    0x1B
+
+// ComIrqReg / ComIEnReg bits
+#define RC522_IRQ_TX          0x40
+#define RC522_IRQ_RX          0x20
+#define RC522_IRQ_IDLE        0x10
+#define RC522_IRQ_HI_ALERT    0x08
+#define RC522_IRQ_LO_ALERT    0x04
+#define RC522_IRQ_ERR         0x02
+#define RC522_IRQ_TIMER       0x01
+
+// DivIrqReg bits
+#define RC522_DIV_IRQ_CRC     0x04
+
+// Status2Reg bits
+#define RC522_STATUS2_CRYPTO1_ON  0x08
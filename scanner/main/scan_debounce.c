@@ -0,0 +1,134 @@
+// Debounce table
+//
+// Open addressing with linear probing over SCAN_DEBOUNCE_SLOTS slots, keyed on the
+// reader index plus the raw UID bytes. Each entry remembers when its UID was last
+// reported (for the hold-off) and last seen (for eviction). Once SCAN_DEBOUNCE_MAX
+// entries are live, the least recently seen one is removed with backward-shift
+// deletion, so probe chains never need tombstones.
+//
+// Only the scan task calls scan_debounce_check(); the stats are plain reads.
+#include <string.h>
+#include "scan_debounce.h"
+
+_Static_assert((SCAN_DEBOUNCE_SLOTS & (SCAN_DEBOUNCE_SLOTS - 1)) == 0, "SCAN_DEBOUNCE_SLOTS must be a power of two");
+_Static_assert(SCAN_DEBOUNCE_MAX < SCAN_DEBOUNCE_SLOTS, "the table needs free slots to end probe chains");
+
+#define SLOT_MASK (SCAN_DEBOUNCE_SLOTS - 1)
+
+typedef struct {
+    bool used;
+    uint8_t reader;
+    uint8_t len;
+    uint8_t uid[SCAN_DEBOUNCE_UID_MAX];
+    uint8_t home;               // slot the hash points at
+    uint32_t repeats;           // suppressed since the last report
+    int64_t reported_us;
+    int64_t seen_us;
+} debounce_entry_t;
+
+static debounce_entry_t slots[SCAN_DEBOUNCE_SLOTS];
+static int64_t holdoff;
+static scan_debounce_stats_t stats;
+
+// FNV-1a over the reader index and the UID
+static uint32_t key_hash(uint8_t reader, const uint8_t *uid, uint8_t len) {
+    uint32_t h = 2166136261u;
+    h = (h ^ reader) * 16777619u;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ uid[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool key_equal(const debounce_entry_t *e, uint8_t reader, const uint8_t *uid, uint8_t len) {
+    return e->reader == reader && e->len == len && memcmp(e->uid, uid, len) == 0;
+}
+
+// Empty slot i and pull later entries of the chain back over it
+static void slot_delete(int i) {
+    int j = i;
+    while (1) {
+        slots[i].used = false;
+        int home;
+        do {
+            j = (j + 1) & SLOT_MASK;
+            if (!slots[j].used) return;
+            home = slots[j].home;
+            // Entry j may stay put when its home lies cyclically in (i, j]
+        } while (i <= j ? (i < home && home <= j) : (i < home || home <= j));
+        slots[i] = slots[j];
+        i = j;
+    }
+}
+
+static void evict_oldest(void) {
+    int oldest = -1;
+    for (int i = 0; i < SCAN_DEBOUNCE_SLOTS; i++) {
+        if (slots[i].used && (oldest < 0 || slots[i].seen_us < slots[oldest].seen_us)) {
+            oldest = i;
+        }
+    }
+    if (oldest >= 0) {
+        slot_delete(oldest);
+        stats.entries--;
+        stats.evicted++;
+    }
+}
+
+void scan_debounce_init(int64_t holdoff_us) {
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    holdoff = holdoff_us;
+}
+
+bool scan_debounce_check(uint8_t reader, const uint8_t *uid, uint8_t len, int64_t now_us,
+                         uint32_t *repeats) {
+    if (len > SCAN_DEBOUNCE_UID_MAX) len = SCAN_DEBOUNCE_UID_MAX;
+    uint8_t home = key_hash(reader, uid, len) & SLOT_MASK;
+
+    int i = home;
+    while (slots[i].used) {
+        debounce_entry_t *e = &slots[i];
+        if (key_equal(e, reader, uid, len)) {
+            e->seen_us = now_us;
+            if (now_us - e->reported_us < holdoff) {
+                e->repeats++;
+                stats.suppressed++;
+                if (repeats) *repeats = e->repeats;
+                return false;
+            }
+            if (repeats) *repeats = e->repeats;
+            e->repeats = 0;
+            e->reported_us = now_us;
+            stats.accepted++;
+            return true;
+        }
+        i = (i + 1) & SLOT_MASK;
+    }
+
+    // New UID; evicting may shift entries, so look for the free slot again
+    if (stats.entries >= SCAN_DEBOUNCE_MAX) {
+        evict_oldest();
+        i = home;
+        while (slots[i].used) {
+            i = (i + 1) & SLOT_MASK;
+        }
+    }
+    debounce_entry_t *e = &slots[i];
+    e->used = true;
+    e->reader = reader;
+    e->len = len;
+    memcpy(e->uid, uid, len);
+    e->home = home;
+    e->repeats = 0;
+    e->reported_us = now_us;
+    e->seen_us = now_us;
+    stats.entries++;
+    stats.accepted++;
+    if (repeats) *repeats = 0;
+    return true;
+}
+
+scan_debounce_stats_t scan_debounce_stats(void) {
+    return stats;
+}
@@ -0,0 +1,26 @@
+// Per-keyfob duplicate suppression for the scan task
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCAN_DEBOUNCE_SLOTS     32      // must be a power of two
+#define SCAN_DEBOUNCE_MAX       24      // live entries before the least recently seen is evicted
+#define SCAN_DEBOUNCE_UID_MAX   10
+
+typedef struct {
+    uint32_t accepted;          // taps reported
+    uint32_t suppressed;        // repeats inside the hold-off window
+    uint32_t evicted;           // entries dropped to make room
+    uint32_t entries;
+} scan_debounce_stats_t;
+
+void scan_debounce_init(int64_t holdoff_us);
+
+// True when this tap should be reported: the UID was not seen on this reader, or
+// its last report is older than the hold-off. *repeats gets the number of taps
+// suppressed for the UID since it was last reported (may be NULL).
+bool scan_debounce_check(uint8_t reader, const uint8_t *uid, uint8_t len, int64_t now_us,
+                         uint32_t *repeats);
+
+scan_debounce_stats_t scan_debounce_stats(void);
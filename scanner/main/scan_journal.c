@@ -0,0 +1,313 @@
+// Append-only scan journal
+//
+// The partition is a ring of 4 KB sectors holding fixed 32-byte records. Appends walk
+// forward and a sector is only erased when the write position enters it, so every
+// sector sees the same number of erase cycles. Each record carries a sequence number
+// and a CRC32; at boot the whole partition is scanned once to find the newest record
+// (write position) and the oldest one past the acknowledged sequence kept in NVS
+// (replay position). A record torn by a power cut fails its CRC and is skipped.
+//
+// Append, peek and ack are meant to be called from one task (the uploader).
+#include <stddef.h>
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "mem_budget.h"
+#include "scan_journal.h"
+#include "scan_log.h"
+
+#define JOURNAL_PARTITION_LABEL   "scanlog"
+#define JOURNAL_PARTITION_SUBTYPE 0x40
+#define JOURNAL_MAGIC             0x4A        // "J"
+#define JOURNAL_VERSION           2
+#define JOURNAL_SECTOR_SIZE       4096
+#define JOURNAL_RECORD_SIZE       32
+#define JOURNAL_PER_SECTOR        (JOURNAL_SECTOR_SIZE / JOURNAL_RECORD_SIZE)
+#define JOURNAL_CHUNK             16          // records per flash read
+#define JOURNAL_NVS_NAMESPACE     "journal"
+#define JOURNAL_NVS_ACKED         "acked"
+#define JOURNAL_NVS_EPOCH         "epoch"
+#define JOURNAL_FLAG_OUT          0x80        // direction, folded into flags to make room
+#define JOURNAL_READER_SHIFT      5           // reader index in flags bits 5-6
+#define JOURNAL_READER_MASK       0x60
+
+typedef struct __attribute__((packed)) {
+    uint8_t  magic;
+    uint8_t  version;
+    uint8_t  flags;             // SCAN_FLAG_*, JOURNAL_FLAG_OUT, reader index
+    uint8_t  uid_len;
+    uint32_t seq;
+    int64_t  timestamp_ms;
+    uint16_t facility_id;
+    uint8_t  uid[SCAN_UID_MAX];
+    uint32_t crc;               // CRC32 of everything above
+} journal_record_t;
+
+_Static_assert(sizeof(journal_record_t) == JOURNAL_RECORD_SIZE, "journal record must stay 32 bytes");
+
+static const esp_partition_t *part = NULL;
+static nvs_handle_t nvs;
+static uint32_t slot_count;
+
+static uint32_t write_slot;     // next slot to write
+static uint32_t read_slot;      // oldest unacknowledged record
+static uint32_t next_seq;
+static uint32_t acked_seq;      // highest sequence the backend has confirmed
+static uint32_t epoch;          // names this run of sequence numbers, never 0
+
+// Outstanding peek, committed by scan_journal_ack()
+static uint32_t peek_end_slot;
+static uint32_t peek_count;
+static uint32_t peek_last_seq;
+
+static scan_journal_stats_t stats;
+static journal_record_t chunk[JOURNAL_CHUNK];
+
+static uint32_t record_crc(const journal_record_t *r) {
+    return esp_rom_crc32_le(0, (const uint8_t *)r, offsetof(journal_record_t, crc));
+}
+
+static bool record_valid(const journal_record_t *r) {
+    return r->magic == JOURNAL_MAGIC && r->version == JOURNAL_VERSION &&
+           r->uid_len <= SCAN_UID_MAX && r->crc == record_crc(r);
+}
+
+static void record_decode(const journal_record_t *r, scan_record_t *rec) {
+    rec->seq = r->seq;
+    rec->timestamp_ms = r->timestamp_ms;
+    rec->flags = r->flags & ~(JOURNAL_FLAG_OUT | JOURNAL_READER_MASK);
+    rec->direction = (r->flags & JOURNAL_FLAG_OUT) ? SCAN_DIR_OUT : SCAN_DIR_IN;
+    rec->reader = (r->flags & JOURNAL_READER_MASK) >> JOURNAL_READER_SHIFT;
+    rec->facility_id = r->facility_id;
+    rec->uid_len = r->uid_len;
+    memcpy(rec->uid, r->uid, r->uid_len);
+}
+
+static bool slot_blank(uint32_t slot) {
+    uint8_t buf[JOURNAL_RECORD_SIZE];
+    if (esp_partition_read(part, slot * JOURNAL_RECORD_SIZE, buf, sizeof(buf)) != ESP_OK) {
+        return false;
+    }
+    for (int i = 0; i < JOURNAL_RECORD_SIZE; i++) {
+        if (buf[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static uint32_t next_slot(uint32_t slot) {
+    return slot + 1 == slot_count ? 0 : slot + 1;
+}
+
+esp_err_t scan_journal_init(void) {
+    mem_budget_add("journal chunk", sizeof(chunk));
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, JOURNAL_PARTITION_SUBTYPE, JOURNAL_PARTITION_LABEL);
+    if (!part) {
+        SCAN_LOGW("JOURNAL", "No '%s' partition, scans are kept in RAM only\n", JOURNAL_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    slot_count = (part->size / JOURNAL_SECTOR_SIZE) * JOURNAL_PER_SECTOR;
+
+    esp_err_t ret = nvs_open(JOURNAL_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret != ESP_OK) {
+        SCAN_LOGE("JOURNAL", "NVS open failed: %s\n", esp_err_to_name(ret));
+        part = NULL;
+        return ret;
+    }
+    acked_seq = 0;
+    nvs_get_u32(nvs, JOURNAL_NVS_ACKED, &acked_seq);
+    // The backend drops sequence numbers it has acknowledged for this epoch. When NVS
+    // was wiped the acknowledged position is gone and numbering may restart, so a new
+    // epoch tells the backend not to compare against the old numbers.
+    if (nvs_get_u32(nvs, JOURNAL_NVS_EPOCH, &epoch) != ESP_OK || epoch == 0) {
+        epoch = esp_random() | 1;
+        nvs_set_u32(nvs, JOURNAL_NVS_EPOCH, epoch);
+        nvs_commit(nvs);
+    }
+
+    // One pass over the partition: newest record overall, oldest unacknowledged one
+    int64_t start = esp_timer_get_time();
+    bool have_newest = false, have_oldest = false;
+    uint32_t newest_seq = 0, newest_slot = 0;
+    uint32_t oldest_seq = 0, oldest_slot = 0;
+    uint32_t pending = 0;
+
+    for (uint32_t base = 0; base < slot_count; base += JOURNAL_CHUNK) {
+        ret = esp_partition_read(part, base * JOURNAL_RECORD_SIZE, chunk, sizeof(chunk));
+        if (ret != ESP_OK) {
+            SCAN_LOGE("JOURNAL", "Read failed at slot %lu: %s\n", (unsigned long)base, esp_err_to_name(ret));
+            part = NULL;
+            return ret;
+        }
+        for (int i = 0; i < JOURNAL_CHUNK; i++) {
+            const journal_record_t *r = &chunk[i];
+            if (!record_valid(r)) continue;
+            if (!have_newest || r->seq > newest_seq) {
+                have_newest = true;
+                newest_seq = r->seq;
+                newest_slot = base + i;
+            }
+            if (r->seq > acked_seq) {
+                pending++;
+                if (!have_oldest || r->seq < oldest_seq) {
+                    have_oldest = true;
+                    oldest_seq = r->seq;
+                    oldest_slot = base + i;
+                }
+            }
+        }
+    }
+
+    write_slot = 0;
+    next_seq = acked_seq + 1;
+    if (have_newest) {
+        // Continue behind the newest record, stepping over torn writes in its sector
+        write_slot = next_slot(newest_slot);
+        while (write_slot % JOURNAL_PER_SECTOR != 0 && !slot_blank(write_slot)) {
+            write_slot = next_slot(write_slot);
+        }
+        if (newest_seq >= next_seq) next_seq = newest_seq + 1;
+    }
+    read_slot = have_oldest ? oldest_slot : write_slot;
+    stats.pending = pending;
+    stats.capacity = slot_count;
+    peek_count = 0;
+
+    SCAN_LOGI("JOURNAL", "%lu records capacity, %lu pending, next seq %lu (mounted in %lld ms)\n",
+        (unsigned long)slot_count, (unsigned long)pending, (unsigned long)next_seq,
+        (long long)((esp_timer_get_time() - start) / 1000));
+    return ESP_OK;
+}
+
+bool scan_journal_ready(void) {
+    return part != NULL;
+}
+
+// The write position is about to enter a sector: erase it, giving up on any
+// unsent records still in there (the oldest ones in the journal)
+static esp_err_t journal_reclaim_sector(uint32_t sector) {
+    if (stats.pending && read_slot / JOURNAL_PER_SECTOR == sector) {
+        uint32_t lost = 0;
+        for (uint32_t base = sector * JOURNAL_PER_SECTOR; base < (sector + 1) * JOURNAL_PER_SECTOR; base += JOURNAL_CHUNK) {
+            if (esp_partition_read(part, base * JOURNAL_RECORD_SIZE, chunk, sizeof(chunk)) != ESP_OK) break;
+            for (int i = 0; i < JOURNAL_CHUNK; i++) {
+                if (record_valid(&chunk[i]) && chunk[i].seq > acked_seq) lost++;
+            }
+        }
+        if (lost > stats.pending) lost = stats.pending;
+        stats.pending -= lost;
+        stats.dropped += lost;
+        read_slot = ((sector + 1) * JOURNAL_PER_SECTOR) % slot_count;
+        SCAN_LOGW("JOURNAL", "Full, dropped %lu unsent records\n", (unsigned long)lost);
+    }
+    return esp_partition_erase_range(part, sector * JOURNAL_SECTOR_SIZE, JOURNAL_SECTOR_SIZE);
+}
+
+esp_err_t scan_journal_append(scan_record_t *rec) {
+    if (!part) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t start = esp_timer_get_time();
+
+    if (write_slot % JOURNAL_PER_SECTOR == 0) {
+        esp_err_t ret = journal_reclaim_sector(write_slot / JOURNAL_PER_SECTOR);
+        if (ret != ESP_OK) {
+            SCAN_LOGE("JOURNAL", "Erase failed: %s\n", esp_err_to_name(ret));
+            return ret;
+        }
+    }
+
+    journal_record_t r = {
+        .magic = JOURNAL_MAGIC,
+        .version = JOURNAL_VERSION,
+        .flags = rec->flags | (rec->direction == SCAN_DIR_OUT ? JOURNAL_FLAG_OUT : 0) |
+                 ((rec->reader << JOURNAL_READER_SHIFT) & JOURNAL_READER_MASK),
+        .uid_len = rec->uid_len,
+        .seq = next_seq,
+        .timestamp_ms = rec->timestamp_ms,
+        .facility_id = rec->facility_id,
+    };
+    memcpy(r.uid, rec->uid, rec->uid_len);
+    r.crc = record_crc(&r);
+
+    esp_err_t ret = esp_partition_write(part, write_slot * JOURNAL_RECORD_SIZE, &r, sizeof(r));
+    if (ret != ESP_OK) {
+        // Leave the slot behind; a half-written record fails its CRC
+        write_slot = next_slot(write_slot);
+        SCAN_LOGE("JOURNAL", "Write failed: %s\n", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (stats.pending == 0) read_slot = write_slot;
+    rec->seq = next_seq++;
+    write_slot = next_slot(write_slot);
+    stats.pending++;
+    stats.appended++;
+
+    int64_t elapsed = esp_timer_get_time() - start;
+    stats.last_append_us = elapsed;
+    stats.total_append_us += elapsed;
+    if (elapsed > stats.max_append_us) stats.max_append_us = elapsed;
+    return ESP_OK;
+}
+
+int scan_journal_peek(scan_record_t *out, int max) {
+    journal_record_t r;
+    uint32_t slot = read_slot;
+    int n = 0;
+
+    peek_count = 0;
+    if (!part || stats.pending == 0) {
+        return 0;
+    }
+
+    while (n < max && slot != write_slot) {
+        esp_err_t ret = esp_partition_read(part, slot * JOURNAL_RECORD_SIZE, &r, sizeof(r));
+        if (ret != ESP_OK) break;
+        slot = next_slot(slot);
+        if (!record_valid(&r) || r.seq <= acked_seq) continue;
+
+        record_decode(&r, &out[n++]);
+        peek_last_seq = r.seq;
+    }
+
+    peek_end_slot = slot;
+    peek_count = n;
+    return n;
+}
+
+void scan_journal_ack(void) {
+    if (!part || peek_count == 0) {
+        return;
+    }
+
+    read_slot = peek_end_slot;
+    acked_seq = peek_last_seq;
+    stats.pending = peek_count < stats.pending ? stats.pending - peek_count : 0;
+    stats.replayed += peek_count;
+    if (stats.pending == 0) read_slot = write_slot;
+    peek_count = 0;
+
+    // A power cut before this lands means the batch is sent again; the backend
+    // drops repeats by device, epoch and sequence number
+    esp_err_t ret = nvs_set_u32(nvs, JOURNAL_NVS_ACKED, acked_seq);
+    if (ret == ESP_OK) ret = nvs_commit(nvs);
+    if (ret != ESP_OK) {
+        SCAN_LOGE("JOURNAL", "Saving replay position failed: %s\n", esp_err_to_name(ret));
+    }
+}
+
+uint32_t scan_journal_pending(void) {
+    return stats.pending;
+}
+
+scan_journal_stats_t scan_journal_stats(void) {
+    return stats;
+}
+
+uint32_t scan_journal_epoch(void) {
+    return epoch;
+}
@@ -0,0 +1,37 @@
+// Durable scan journal on the "scanlog" flash partition
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "scan_queue.h"
+
+typedef struct {
+    uint32_t appended;          // records written since boot
+    uint32_t replayed;          // records acknowledged by the backend since boot
+    uint32_t dropped;           // unsent records overwritten because the journal wrapped
+    uint32_t pending;           // records not yet acknowledged
+    uint32_t capacity;          // records the partition holds
+    int64_t  last_append_us;
+    int64_t  max_append_us;     // includes the sector erase every 128 records
+    int64_t  total_append_us;
+} scan_journal_stats_t;
+
+// Mount the partition and recover the write and replay positions; needs NVS
+esp_err_t scan_journal_init(void);
+bool scan_journal_ready(void);
+
+// Store a record; rec->seq is set to its journal sequence number
+esp_err_t scan_journal_append(scan_record_t *rec);
+
+// Read up to max of the oldest unacknowledged records, in order
+int scan_journal_peek(scan_record_t *out, int max);
+
+// Mark everything returned by the last peek as delivered
+void scan_journal_ack(void);
+
+uint32_t scan_journal_pending(void);
+
+// Sent with every upload; the sequence numbers only mean something within an epoch
+uint32_t scan_journal_epoch(void);
+scan_journal_stats_t scan_journal_stats(void);
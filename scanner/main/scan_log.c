@@ -0,0 +1,240 @@
+// Log ring
+//
+// A bounded multi-producer queue after Vyukov: each slot carries a sequence number
+// that says whether it is free for position p (seq == p), holds message p
+// (seq == p + 1) or has been printed (seq == p + SCAN_LOG_LINES). Writers claim a
+// position with one compare-and-swap on head and publish with one store, so a task
+// that logs never blocks; when the drain task falls a full ring behind, messages are
+// counted and dropped instead.
+//
+// The sequence numbers stay in DRAM (atomics do not work on RTC memory); the message
+// text and its position go to RTC memory, which a panic or watchdog reset leaves alone.
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mem_budget.h"
+#include "scan_log.h"
+
+_Static_assert((SCAN_LOG_LINES & (SCAN_LOG_LINES - 1)) == 0, "SCAN_LOG_LINES must be a power of two");
+_Static_assert(SCAN_LOG_LINE_LEN <= 255, "line length is stored in a byte");
+
+#define LOG_MASK            (SCAN_LOG_LINES - 1)
+#define LOG_MAGIC           0x534C4F47u     // "SLOG"
+#define LOG_DRAIN_PRIO      (tskIDLE_PRIORITY + 1)
+#define LOG_DRAIN_STACK     2560
+#define LOG_DRAIN_IDLE_MS   20
+
+typedef struct {
+    uint32_t pos;                   // position in the message stream
+    uint32_t time_ms;
+    uint8_t level;
+    uint8_t len;
+    char text[SCAN_LOG_LINE_LEN];
+} log_line_t;
+
+typedef struct {
+    uint32_t magic;
+    log_line_t lines[SCAN_LOG_LINES];
+} log_store_t;
+
+static RTC_NOINIT_ATTR log_store_t store;
+
+static _Atomic uint32_t seqs[SCAN_LOG_LINES];
+static _Atomic uint32_t head;       // next position to claim
+static _Atomic uint32_t dropped;
+static atomic_bool ready;
+static uint32_t tail;               // next position to print; drain task only
+static uint32_t first;              // oldest position that holds a message
+
+static const char *crash_reason(esp_reset_reason_t reason) {
+    switch (reason) {
+    case ESP_RST_PANIC:    return "panic";
+    case ESP_RST_INT_WDT:  return "interrupt watchdog";
+    case ESP_RST_TASK_WDT: return "task watchdog";
+    case ESP_RST_WDT:      return "watchdog";
+    case ESP_RST_BROWNOUT: return "brownout";
+    default:               return NULL;
+    }
+}
+
+static bool line_valid(const log_line_t *l, uint32_t pos) {
+    return l->pos == pos && l->level <= SCAN_LOG_DEBUG && l->len < SCAN_LOG_LINE_LEN &&
+           l->text[l->len] == '\0';
+}
+
+static void drain_task(void *arg) {
+    uint32_t reported = 0;
+
+    while (1) {
+        _Atomic uint32_t *seq = &seqs[tail & LOG_MASK];
+        if (atomic_load_explicit(seq, memory_order_acquire) == tail + 1) {
+            const log_line_t *l = &store.lines[tail & LOG_MASK];
+            fwrite(l->text, 1, l->len, stdout);
+            atomic_store_explicit(seq, tail + SCAN_LOG_LINES, memory_order_release);
+            tail++;
+            continue;
+        }
+
+        uint32_t lost = atomic_load_explicit(&dropped, memory_order_relaxed);
+        if (lost != reported) {
+            printf("[LOG] %lu messages dropped, the console could not keep up\n",
+                (unsigned long)(lost - reported));
+            reported = lost;
+        }
+        fflush(stdout);
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_IDLE_MS));
+    }
+}
+
+void scan_log_init(void) {
+    esp_reset_reason_t reason = esp_reset_reason();
+    uint32_t newest = 0;
+    bool kept = false;
+
+    // After anything but a power-on the previous boot's messages are still there;
+    // carry on numbering after the newest so they stay readable until overwritten
+    if (reason != ESP_RST_POWERON && store.magic == LOG_MAGIC) {
+        for (uint32_t i = 0; i < SCAN_LOG_LINES; i++) {
+            const log_line_t *l = &store.lines[i];
+            if ((l->pos & LOG_MASK) == i && line_valid(l, l->pos) &&
+                (!kept || (int32_t)(l->pos - newest) > 0)) {
+                newest = l->pos;
+                kept = true;
+            }
+        }
+    }
+    uint32_t start = kept ? newest + 1 : 0;
+    if (!kept) {
+        memset(&store, 0, sizeof(store));
+        store.magic = LOG_MAGIC;
+    }
+
+    const char *crash = crash_reason(reason);
+    if (kept && crash) {
+        printf("[LOG] Last messages before the %s reset:\n", crash);
+        for (uint32_t pos = start - SCAN_LOG_LINES; pos != start; pos++) {
+            const log_line_t *l = &store.lines[pos & LOG_MASK];
+            if (line_valid(l, pos)) {
+                printf("(%lu) %s", (unsigned long)l->time_ms, l->text);
+            }
+        }
+        printf("[LOG] End of the previous boot\n");
+    }
+
+    // Positions start.. are free; the older ones count as printed
+    for (uint32_t i = 0; i < SCAN_LOG_LINES; i++) {
+        atomic_init(&seqs[i], start + ((i - start) & LOG_MASK));
+    }
+    first = kept ? start - SCAN_LOG_LINES : start;
+    tail = start;
+    atomic_store_explicit(&head, start, memory_order_relaxed);
+    atomic_store_explicit(&ready, true, memory_order_release);
+    if (kept) {
+        // Marks where the previous boot's messages end in GET /log
+        SCAN_LOGI("LOG", "Boot after reset reason %d\n", (int)reason);
+    }
+
+    static StackType_t drain_stack[LOG_DRAIN_STACK];
+    static StaticTask_t drain_tcb;
+    TaskHandle_t drain = xTaskCreateStatic(drain_task, "log", LOG_DRAIN_STACK, NULL, LOG_DRAIN_PRIO,
+        drain_stack, &drain_tcb);
+    mem_budget_task(drain, sizeof(drain_stack));
+    mem_budget_add("log ring", sizeof(seqs));
+    mem_budget_add("log text (RTC)", sizeof(store));
+}
+
+void scan_log_write(int level, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    if (!atomic_load_explicit(&ready, memory_order_acquire)) {
+        vprintf(fmt, args);
+        va_end(args);
+        return;
+    }
+
+    uint32_t pos = atomic_load_explicit(&head, memory_order_relaxed);
+    while (1) {
+        uint32_t seq = atomic_load_explicit(&seqs[pos & LOG_MASK], memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0) {
+            // Acquire keeps the text stores below after the claim
+            if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1,
+                    memory_order_acquire, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            va_end(args);
+            return;
+        } else {
+            pos = atomic_load_explicit(&head, memory_order_relaxed);
+        }
+    }
+
+    log_line_t *l = &store.lines[pos & LOG_MASK];
+    int n = vsnprintf(l->text, sizeof(l->text), fmt, args);
+    va_end(args);
+    if (n < 0) {
+        n = 0;
+        l->text[0] = '\0';
+    } else if (n >= (int)sizeof(l->text)) {
+        // Cut, but keep the line break
+        n = sizeof(l->text) - 1;
+        l->text[n - 1] = '\n';
+    }
+    l->len = n;
+    l->level = level;
+    l->time_ms = esp_timer_get_time() / 1000;
+    l->pos = pos;
+    atomic_store_explicit(&seqs[pos & LOG_MASK], pos + 1, memory_order_release);
+}
+
+void scan_log_flush(void) {
+    if (!atomic_load_explicit(&ready, memory_order_acquire)) {
+        return;
+    }
+    // Printed in order, so once the newest message is out the rest are too
+    uint32_t last = atomic_load_explicit(&head, memory_order_relaxed) - 1;
+    while ((int32_t)(atomic_load_explicit(&seqs[last & LOG_MASK], memory_order_acquire) -
+                     (last + SCAN_LOG_LINES)) < 0) {
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_IDLE_MS));
+    }
+}
+
+uint32_t scan_log_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+void scan_log_for_each(scan_log_fn fn, void *ctx) {
+    if (!atomic_load_explicit(&ready, memory_order_acquire)) {
+        return;
+    }
+    uint32_t end = atomic_load_explicit(&head, memory_order_acquire);
+    uint32_t pos = end - SCAN_LOG_LINES;
+    if ((int32_t)(first - pos) > 0) {
+        pos = first;
+    }
+
+    for (; pos != end; pos++) {
+        const log_line_t *l = &store.lines[pos & LOG_MASK];
+        uint32_t seq = atomic_load_explicit(&seqs[pos & LOG_MASK], memory_order_acquire);
+        if (seq != pos + 1 && seq != pos + SCAN_LOG_LINES) {
+            continue;               // claimed but not written yet
+        }
+        log_line_t copy = *l;
+        // The copy is good unless a writer claimed the slot for its next turn meanwhile
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t now = atomic_load_explicit(&head, memory_order_relaxed);
+        if ((int32_t)(now - (pos + SCAN_LOG_LINES)) > 0 || !line_valid(&copy, pos)) {
+            continue;
+        }
+        fn(copy.time_ms, copy.level, copy.text, ctx);
+    }
+}
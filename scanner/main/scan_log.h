@@ -0,0 +1,58 @@
+// Levelled diagnostics that never wait on the UART
+//
+// SCAN_LOGE/W/I/D format into a lock-free RAM ring and return; a low-priority task
+// copies the ring to the console. Messages above CONFIG_SCANNER_LOG_LEVEL compile
+// out, arguments included. The ring text lives in RTC memory, so the last messages
+// before a panic or watchdog reset are printed on the next boot, and the current
+// contents are served on GET /log next to /metrics.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+#define SCAN_LOG_NONE       0
+#define SCAN_LOG_ERROR      1
+#define SCAN_LOG_WARN       2
+#define SCAN_LOG_INFO       3
+#define SCAN_LOG_DEBUG      4
+
+#ifdef CONFIG_SCANNER_LOG_LEVEL
+#define SCAN_LOG_LEVEL      CONFIG_SCANNER_LOG_LEVEL
+#else
+#define SCAN_LOG_LEVEL      SCAN_LOG_INFO
+#endif
+
+#define SCAN_LOG_LINES      32      // must be a power of two
+#define SCAN_LOG_LINE_LEN   124     // longer messages are cut
+
+#define SCAN_LOG(level, tag, fmt, ...) do { \
+        if ((level) <= SCAN_LOG_LEVEL) { \
+            scan_log_write((level), "[" tag "] " fmt, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define SCAN_LOGE(tag, fmt, ...) SCAN_LOG(SCAN_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define SCAN_LOGW(tag, fmt, ...) SCAN_LOG(SCAN_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define SCAN_LOGI(tag, fmt, ...) SCAN_LOG(SCAN_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define SCAN_LOGD(tag, fmt, ...) SCAN_LOG(SCAN_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+// Dump the previous boot's messages if it crashed, then start the drain task.
+// Messages written before this go straight to the console.
+void scan_log_init(void);
+
+void scan_log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Wait until everything written so far is on the console, before printing to it
+// directly
+void scan_log_flush(void);
+
+// Messages dropped because the ring was full
+uint32_t scan_log_dropped(void);
+
+// Calls fn for each message still in the ring, oldest first, skipping any that are
+// overwritten while being copied. Safe to call from any task.
+typedef void (*scan_log_fn)(uint32_t time_ms, int level, const char *text, void *ctx);
+void scan_log_for_each(scan_log_fn fn, void *ctx);
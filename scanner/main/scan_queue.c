@@ -0,0 +1,68 @@
+// Lock-free SPSC ring buffer
+//
+// head is only written by the producer and tail only by the consumer, so each side
+// owns one index and reads the other with acquire ordering. Indices run freely and
+// are masked on access; head - tail is the depth.
+#include <stdatomic.h>
+#include "scan_queue.h"
+
+_Static_assert((SCAN_QUEUE_LEN & (SCAN_QUEUE_LEN - 1)) == 0, "SCAN_QUEUE_LEN must be a power of two");
+
+static scan_record_t slots[SCAN_QUEUE_LEN];
+static atomic_uint_fast32_t head;      // next slot to write
+static atomic_uint_fast32_t tail;      // next slot to read
+
+static atomic_uint_fast32_t dropped;
+static atomic_uint_fast32_t high_water;
+
+bool scan_queue_push(const scan_record_t *rec) {
+    uint32_t h = atomic_load_explicit(&head, memory_order_relaxed);
+    uint32_t t = atomic_load_explicit(&tail, memory_order_acquire);
+
+    if (h - t >= SCAN_QUEUE_LEN) {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    slots[h & (SCAN_QUEUE_LEN - 1)] = *rec;
+    atomic_store_explicit(&head, h + 1, memory_order_release);
+
+    // Only the producer raises the mark, so a plain compare is enough
+    uint32_t depth = h + 1 - t;
+    if (depth > atomic_load_explicit(&high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&high_water, depth, memory_order_relaxed);
+    }
+    return true;
+}
+
+bool scan_queue_pop(scan_record_t *rec) {
+    uint32_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+    uint32_t h = atomic_load_explicit(&head, memory_order_acquire);
+
+    if (t == h) {
+        return false;
+    }
+
+    *rec = slots[t & (SCAN_QUEUE_LEN - 1)];
+    atomic_store_explicit(&tail, t + 1, memory_order_release);
+    return true;
+}
+
+uint32_t scan_queue_depth(void) {
+    uint32_t t = atomic_load_explicit(&tail, memory_order_acquire);
+    uint32_t h = atomic_load_explicit(&head, memory_order_acquire);
+    return h - t;
+}
+
+scan_queue_stats_t scan_queue_stats(void) {
+    uint32_t t = atomic_load_explicit(&tail, memory_order_acquire);
+    uint32_t h = atomic_load_explicit(&head, memory_order_acquire);
+    scan_queue_stats_t st = {
+        .enqueued = h,
+        .dequeued = t,
+        .dropped = atomic_load_explicit(&dropped, memory_order_relaxed),
+        .depth = h - t,
+        .high_water = atomic_load_explicit(&high_water, memory_order_relaxed),
+    };
+    return st;
+}
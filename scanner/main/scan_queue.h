@@ -0,0 +1,44 @@
+// Single-producer/single-consumer queue between the scan task and the upload task
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCAN_UID_MAX    10      // triple size UID
+#define SCAN_QUEUE_LEN  32      // must be a power of two
+
+#define SCAN_DIR_IN         0
+#define SCAN_DIR_OUT        1
+
+#define SCAN_FLAG_UNIX_TIME 0x01    // timestamp_ms is Unix time instead of uptime
+#define SCAN_FLAG_DECIDED   0x02    // access was decided locally at the reader
+#define SCAN_FLAG_GRANTED   0x04    // ... and the keyfob was on the allowlist
+
+// One tap, as handed from the reader to the uploader
+typedef struct {
+    uint32_t seq;               // per enqueued scan; replaced by the journal sequence once stored
+    int64_t  timestamp_ms;      // esp_timer time of the tap, or Unix time with SCAN_FLAG_UNIX_TIME
+    uint8_t  flags;             // SCAN_FLAG_*
+    uint8_t  direction;         // SCAN_DIR_*
+    uint16_t facility_id;       // location_id of the reader that took the scan
+    uint8_t  reader;            // index in the reader table
+    uint8_t  uid_len;
+    uint8_t  uid[SCAN_UID_MAX];
+} scan_record_t;
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t dequeued;
+    uint32_t dropped;           // pushes refused because the queue was full
+    uint32_t depth;
+    uint32_t high_water;        // deepest the queue has been
+} scan_queue_stats_t;
+
+// Producer side; returns false (and counts a drop) when full, never blocks
+bool scan_queue_push(const scan_record_t *rec);
+
+// Consumer side; returns false when empty
+bool scan_queue_pop(scan_record_t *rec);
+
+uint32_t scan_queue_depth(void);
+scan_queue_stats_t scan_queue_stats(void);
@@ -0,0 +1,66 @@
+// Adaptive probe schedule
+//
+// No platform calls: the scan task passes esp_timer time, the host bench passes the
+// simulator's clock.
+#include <string.h>
+#include "scan_sched.h"
+
+void scan_sched_init(scan_sched_t *s, const scan_sched_config_t *cfg, int64_t now_us) {
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    if (s->cfg.idle_us < s->cfg.fast_us) {
+        s->cfg.idle_us = s->cfg.fast_us;
+    }
+    s->gap_us = s->cfg.fast_us;
+    s->last_probe_us = now_us;
+    s->last_active_us = now_us;
+    s->state_since_us = now_us;
+}
+
+int64_t scan_sched_probe(scan_sched_t *s, int64_t now_us) {
+    int64_t gap = now_us - s->last_probe_us;
+    s->last_probe_us = now_us;
+    s->stats.probes++;
+    if (gap > s->stats.max_gap_us) {
+        s->stats.max_gap_us = gap;
+    }
+    return gap;
+}
+
+int64_t scan_sched_next(scan_sched_t *s, bool active, int64_t now_us) {
+    if (active) {
+        s->last_active_us = now_us;
+        s->gap_us = s->cfg.fast_us;
+    } else if (now_us - s->last_active_us >= s->cfg.hold_us && s->gap_us < s->cfg.idle_us) {
+        s->gap_us = s->gap_us > s->cfg.idle_us / 2 ? s->cfg.idle_us : s->gap_us * 2;
+    }
+    int64_t wait = s->last_probe_us + s->gap_us - now_us;
+    return wait > 0 ? wait : 0;
+}
+
+bool scan_sched_should_sleep(const scan_sched_t *s, int64_t wait_us) {
+    return s->cfg.sleep_min_us && wait_us >= s->cfg.sleep_min_us && wait_us > s->cfg.settle_us;
+}
+
+void scan_sched_power(scan_sched_t *s, bool awake, int64_t now_us) {
+    if (awake == !s->asleep) return;
+    int64_t spent = now_us - s->state_since_us;
+    if (s->asleep) {
+        s->stats.asleep_us += spent;
+    } else {
+        s->stats.awake_us += spent;
+        s->stats.sleeps++;
+    }
+    s->asleep = !awake;
+    s->state_since_us = now_us;
+}
+
+scan_sched_stats_t scan_sched_stats(const scan_sched_t *s, int64_t now_us) {
+    scan_sched_stats_t st = s->stats;
+    if (s->asleep) {
+        st.asleep_us += now_us - s->state_since_us;
+    } else {
+        st.awake_us += now_us - s->state_since_us;
+    }
+    return st;
+}
@@ -0,0 +1,55 @@
+// Adaptive probe schedule for the scan task
+//
+// Right after a card the readers are probed every fast_us. Once nothing has been in
+// the field for hold_us the gap doubles on every probe, up to idle_us, which is the
+// longest a new card waits to be noticed. Gaps of at least sleep_min_us are spent
+// with the readers powered down (field off); they are woken settle_us ahead of the
+// probe so the tags have power again. Times are the caller's clock in microseconds.
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    uint32_t fast_us;
+    uint32_t idle_us;           // worst-case probe gap; at least fast_us
+    uint32_t hold_us;
+    uint32_t sleep_min_us;      // 0 never powers the readers down
+    uint32_t settle_us;
+} scan_sched_config_t;
+
+typedef struct {
+    uint32_t probes;
+    uint32_t sleeps;            // gaps spent powered down
+    int64_t awake_us;           // readers powered up, field on
+    int64_t asleep_us;
+    int64_t max_gap_us;         // longest time between two probe starts
+} scan_sched_stats_t;
+
+typedef struct {
+    scan_sched_config_t cfg;
+    uint32_t gap_us;            // between the last probe start and the next
+    int64_t last_probe_us;
+    int64_t last_active_us;
+    bool asleep;
+    int64_t state_since_us;
+    scan_sched_stats_t stats;
+} scan_sched_t;
+
+void scan_sched_init(scan_sched_t *s, const scan_sched_config_t *cfg, int64_t now_us);
+
+// A probe round starts; returns the time since the previous one, the longest a
+// card that shows up now may have waited
+int64_t scan_sched_probe(scan_sched_t *s, int64_t now_us);
+
+// The round is done; active when a card is in any field. Returns how long to wait
+// until the next probe is due.
+int64_t scan_sched_next(scan_sched_t *s, bool active, int64_t now_us);
+
+// Whether a wait of wait_us is worth powering the readers down for
+bool scan_sched_should_sleep(const scan_sched_t *s, int64_t wait_us);
+
+// The readers were powered down or up
+void scan_sched_power(scan_sched_t *s, bool awake, int64_t now_us);
+
+scan_sched_stats_t scan_sched_stats(const scan_sched_t *s, int64_t now_us);
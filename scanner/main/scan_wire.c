@@ -0,0 +1,72 @@
+// Binary scan batch encoder
+//
+// Writes bytes with shifts rather than casting structs onto the buffer, so the
+// output does not depend on the compiler's layout or the CPU's byte order.
+#include <string.h>
+#include "scan_wire.h"
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static uint8_t *put_i64(uint8_t *p, int64_t v) {
+    p = put_u32(p, (uint64_t)v);
+    return put_u32(p, (uint64_t)v >> 32);
+}
+
+static uint8_t wire_flags(const scan_record_t *rec) {
+    uint8_t flags = 0;
+    if (rec->direction == SCAN_DIR_OUT) flags |= SCAN_WIRE_FLAG_OUT;
+    if (rec->flags & SCAN_FLAG_UNIX_TIME) flags |= SCAN_WIRE_FLAG_UNIX_TIME;
+    if (rec->flags & SCAN_FLAG_DECIDED) flags |= SCAN_WIRE_FLAG_DECIDED;
+    if (rec->flags & SCAN_FLAG_GRANTED) flags |= SCAN_WIRE_FLAG_GRANTED;
+    return flags;
+}
+
+size_t scan_wire_encode_batch(uint8_t *buf, size_t cap, const char *device, uint32_t epoch,
+                              int64_t now_ms, const scan_record_t *recs, int count) {
+    size_t device_len = strlen(device);
+    if (count < 0 || count > 255 || device_len > 255) {
+        return 0;
+    }
+
+    size_t need = SCAN_WIRE_HEADER_LEN + device_len;
+    for (int i = 0; i < count; i++) {
+        need += SCAN_WIRE_RECORD_LEN + recs[i].uid_len;
+    }
+    if (need > cap) {
+        return 0;
+    }
+
+    uint8_t *p = buf;
+    *p++ = SCAN_WIRE_VERSION;
+    *p++ = count;
+    p = put_i64(p, now_ms);
+    p = put_u32(p, epoch);
+    *p++ = device_len;
+    memcpy(p, device, device_len);
+    p += device_len;
+
+    for (int i = 0; i < count; i++) {
+        const scan_record_t *rec = &recs[i];
+        *p++ = rec->uid_len;
+        *p++ = wire_flags(rec);
+        *p++ = rec->reader;
+        p = put_u16(p, rec->facility_id);
+        p = put_u32(p, rec->seq);
+        p = put_i64(p, rec->timestamp_ms);
+        memcpy(p, rec->uid, rec->uid_len);
+        p += rec->uid_len;
+    }
+    return p - buf;
+}
@@ -0,0 +1,40 @@
+// Compact binary encoding of scan batches for /api/druppel/scans/binary
+//
+// All fields are little-endian and packed, with no padding. A batch is a header
+// followed by count records back to back; a record is as long as its UID needs.
+//
+//   header   u8  version          SCAN_WIRE_VERSION
+//            u8  count            records that follow
+//            i64 now_ms           uptime when the batch was encoded
+//            u32 epoch            what the seq numbers count within; 0 for none
+//            u8  device_len
+//            ..  device           device_len bytes, not terminated
+//
+//   record   u8  uid_len          4, 7 or 10
+//            u8  flags            SCAN_WIRE_FLAG_*
+//            u8  reader           index in the scanner's reader table
+//            u16 facility_id      sent as location_id
+//            u32 seq
+//            i64 timestamp_ms     uptime, or Unix time with SCAN_WIRE_FLAG_UNIX_TIME
+//            ..  uid              uid_len bytes
+//
+// backend/helpers/scanWire.js is the decoder; keep the two in step.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "scan_queue.h"
+
+#define SCAN_WIRE_VERSION           2
+#define SCAN_WIRE_HEADER_LEN        15      // without the device string
+#define SCAN_WIRE_RECORD_LEN        17      // without the UID
+#define SCAN_WIRE_RECORD_MAX        (SCAN_WIRE_RECORD_LEN + SCAN_UID_MAX)
+
+#define SCAN_WIRE_FLAG_OUT          0x01
+#define SCAN_WIRE_FLAG_UNIX_TIME    0x02
+#define SCAN_WIRE_FLAG_DECIDED      0x04
+#define SCAN_WIRE_FLAG_GRANTED      0x08
+
+// Encode count records into buf; returns the length, or 0 when it does not fit
+size_t scan_wire_encode_batch(uint8_t *buf, size_t cap, const char *device, uint32_t epoch,
+                              int64_t now_ms, const scan_record_t *recs, int count);
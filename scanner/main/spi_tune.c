@@ -0,0 +1,156 @@
+// SPI clock tuning
+//
+// The RC522 is specified up to 10 MHz, but what a board actually carries depends on
+// the wiring: flying leads to a door frame often top out at a few MHz. At boot the
+// clock steps up through a fixed table while rc522_spi_check() reads back clean and
+// settles one step below the fastest rate that passed, also when every rate passed,
+// which leaves a margin for temperature and supply drift. The result is cached per reader in NVS, so later
+// boots only verify it.
+//
+// At runtime the readback errors the driver counts (failed checks, corrupted
+// padding bytes) are watched over a sliding window; too many and the clock goes one
+// step down, for good. RF errors (CRC, collisions) say nothing about the SPI link
+// and are not counted.
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "scan_log.h"
+#include "spi_tune.h"
+#include "telemetry.h"
+
+#define TUNE_NVS_NAMESPACE    "spi_tune"
+#define TUNE_BOOT_ROUNDS      10          // check rounds per rate at boot
+#define TUNE_CHECK_INTERVAL_US (10 * 1000000LL)
+#define TUNE_WINDOW_US        (60 * 1000000LL)
+#define TUNE_WINDOW_ERRORS    3           // errors per window that lower the clock
+
+#ifdef CONFIG_SCANNER_SPI_CLOCK_MAX_KHZ
+#define TUNE_MAX_HZ           (CONFIG_SCANNER_SPI_CLOCK_MAX_KHZ * 1000u)
+#else
+#define TUNE_MAX_HZ           10000000u
+#endif
+
+// The first rate is the one the HAL starts at
+static const uint32_t rates[] = {500000, 1000000, 2000000, 4000000, 5000000, 8000000, 10000000};
+
+static int rate_count(void) {
+    int n = 1;
+    while (n < (int)(sizeof(rates) / sizeof(rates[0])) && rates[n] <= TUNE_MAX_HZ) n++;
+    return n;
+}
+
+static void nvs_key(int reader, char *key, size_t len) {
+    snprintf(key, len, "r%d", reader);
+}
+
+static uint32_t cache_load(int reader) {
+    nvs_handle_t nvs;
+    char key[8];
+    uint32_t hz = 0;
+
+    nvs_key(reader, key, sizeof(key));
+    if (nvs_open(TUNE_NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK) {
+        nvs_get_u32(nvs, key, &hz);
+        nvs_close(nvs);
+    }
+    return hz;
+}
+
+static void cache_store(int reader, uint32_t hz) {
+    nvs_handle_t nvs;
+    char key[8];
+
+    nvs_key(reader, key, sizeof(key));
+    esp_err_t ret = nvs_open(TUNE_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(nvs, key, hz);
+        if (ret == ESP_OK) ret = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        SCAN_LOGW("SPI", "Reader %d clock not saved: %s\n", reader, esp_err_to_name(ret));
+    }
+}
+
+static int rate_index(uint32_t hz) {
+    for (int i = 0; i < rate_count(); i++) {
+        if (rates[i] == hz) return i;
+    }
+    return -1;
+}
+
+static bool set_rate(rc522_t *dev, int rate) {
+    return dev->hal->set_clock && dev->hal->set_clock(dev->hal->ctx, rates[rate]);
+}
+
+uint32_t spi_tune_init(spi_tune_t *t, rc522_t *dev, int reader) {
+    *t = (spi_tune_t) {.reader = reader};
+    t->window_start_us = esp_timer_get_time();
+    t->next_check_us = t->window_start_us + TUNE_CHECK_INTERVAL_US;
+
+    int n = rate_count();
+    if (n == 1 || !dev->hal->set_clock) {
+        return rates[0];
+    }
+
+    int cached = rate_index(cache_load(reader));
+    if (cached >= 0) {
+        if (set_rate(dev, cached) && rc522_spi_check(dev, TUNE_BOOT_ROUNDS)) {
+            t->rate = cached;
+            t->seen_errors = rc522_link_stats_get(dev).errors;
+            SCAN_LOGI("SPI", "Reader %d at %lu kHz (saved)\n", reader, (unsigned long)(rates[cached] / 1000));
+            return rates[cached];
+        }
+        SCAN_LOGW("SPI", "Reader %d saved clock %lu kHz failed its check, recalibrating\n",
+            reader, (unsigned long)(rates[cached] / 1000));
+    }
+
+    uint32_t hz = rc522_spi_calibrate(dev, rates, n, TUNE_BOOT_ROUNDS);
+    if (hz == 0) {
+        // Not even the start rate checked out; stay there, rc522_init() passed on it
+        set_rate(dev, 0);
+        t->seen_errors = rc522_link_stats_get(dev).errors;
+        SCAN_LOGW("SPI", "Reader %d link check failed at %lu kHz\n", reader, (unsigned long)(rates[0] / 1000));
+        return rates[0];
+    }
+    t->rate = rate_index(hz);
+    cache_store(reader, hz);
+    rc522_link_stats_t link = rc522_link_stats_get(dev);
+    t->seen_errors = link.errors;
+    SCAN_LOGI("SPI", "Reader %d calibrated to %lu kHz (%lu checks, %lu failed)\n", reader,
+        (unsigned long)(hz / 1000), (unsigned long)link.checks, (unsigned long)link.errors);
+    return hz;
+}
+
+void spi_tune_watch(spi_tune_t *t, rc522_t *dev) {
+    int64_t now = esp_timer_get_time();
+    if (now < t->next_check_us) return;
+    t->next_check_us = now + TUNE_CHECK_INTERVAL_US;
+
+    // Padding bytes are checked on every read, so errors also come in between checks
+    rc522_spi_check(dev, 1);
+    uint32_t errors = rc522_link_stats_get(dev).errors;
+    if (now - t->window_start_us >= TUNE_WINDOW_US) {
+        t->window_start_us = now;
+        t->window_errors = 0;
+    }
+    t->window_errors += errors - t->seen_errors;
+    t->seen_errors = errors;
+    if (t->window_errors < TUNE_WINDOW_ERRORS || t->rate == 0) return;
+
+    uint32_t from = rates[t->rate];
+    if (!set_rate(dev, t->rate - 1)) return;
+    t->rate--;
+    t->fallbacks++;
+    t->window_start_us = now;
+    t->window_errors = 0;
+    cache_store(t->reader, rates[t->rate]);
+    telemetry_count(TM_SPI_CLOCK_FALLBACKS);
+    SCAN_LOGW("SPI", "Reader %d link errors, clock down from %lu to %lu kHz\n", t->reader,
+        (unsigned long)(from / 1000), (unsigned long)(rates[t->rate] / 1000));
+}
+
+uint32_t spi_tune_clock(const spi_tune_t *t) {
+    return rates[t->rate];
+}
@@ -0,0 +1,26 @@
+// Per-reader SPI clock: calibrated once, cached in NVS, lowered when the link degrades
+#pragma once
+
+#include <stdint.h>
+#include "rc522.h"
+
+typedef struct {
+    int reader;
+    int rate;                   // index into the rate table
+    uint32_t seen_errors;       // driver link error count at the last check
+    uint32_t window_errors;     // link errors counted in the current window
+    int64_t window_start_us;
+    int64_t next_check_us;
+    uint32_t fallbacks;
+} spi_tune_t;
+
+// Bring an initialised reader up to its fastest stable clock: the rate cached for
+// this reader if it still checks out, a fresh calibration otherwise. Needs NVS.
+// Returns the clock in Hz.
+uint32_t spi_tune_init(spi_tune_t *t, rc522_t *dev, int reader);
+
+// Call from the task driving the reader while no card is in the field: checks the
+// link now and then and steps the clock down when readback errors pile up
+void spi_tune_watch(spi_tune_t *t, rc522_t *dev);
+
+uint32_t spi_tune_clock(const spi_tune_t *t);
@@ -0,0 +1,216 @@
+// Authenticated keyfob reads
+//
+// Deriving a secret and checking a MAC take one HMAC each. The HMAC context is
+// keyed once at init, so each costs a reset and two SHA-256 blocks rather than
+// four. The last TAG_AUTH_CACHE_SIZE keyfobs keep their secret and the block that
+// verified, so a keyfob seen recently needs no HMAC at all, only the RF exchange
+// (about 4.5 ms for MFAuthent and READ at 106 kbit/s, see rc522_bench).
+//
+// Only the scan task calls in here, so nothing is locked.
+#include "sdkconfig.h"
+#ifdef CONFIG_SCANNER_TAG_AUTH
+#include <stdbool.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "mbedtls/md.h"
+#include "mem_budget.h"
+#include "nvs.h"
+#include "scan_log.h"
+#include "tag_auth.h"
+
+#define TAG_AUTH_BLOCK          CONFIG_SCANNER_TAG_AUTH_BLOCK
+#define TAG_AUTH_CACHE_SIZE     16
+#define TAG_AUTH_KEY_MIN        16
+#define TAG_AUTH_KEY_MAX        32
+#define TAG_AUTH_PAYLOAD_LEN    8
+#define TAG_AUTH_MAC_LEN        8
+#define TAG_AUTH_NVS_NAMESPACE  "tag_auth"
+#define TAG_AUTH_NVS_KEY        "site_key"
+
+#if TAG_AUTH_BLOCK % 4 == 3
+#error "CONFIG_SCANNER_TAG_AUTH_BLOCK is a MIFARE Classic sector trailer"
+#endif
+
+typedef struct {
+    uint8_t uid_len;            // 0 for a free slot
+    uint8_t uid[RC522_UID_MAX];
+    rc522_tag_key_t secret;
+    bool verified;              // block holds a credential that verified
+    uint8_t block[RC522_BLOCK_SIZE];
+    uint32_t used;              // LRU stamp, 0 for a free slot
+} tag_auth_entry_t;
+
+static mbedtls_md_context_t hmac;
+static bool ready;
+static tag_auth_entry_t cache[TAG_AUTH_CACHE_SIZE];
+static uint32_t use_clock;
+static tag_auth_stats_t stats;
+
+// HMAC(site, label | uid | data)
+static bool hmac_run(uint8_t label, const rc522_uid_t *uid, const uint8_t *data, size_t len, uint8_t *out) {
+    return mbedtls_md_hmac_reset(&hmac) == 0 &&
+        mbedtls_md_hmac_update(&hmac, &label, 1) == 0 &&
+        mbedtls_md_hmac_update(&hmac, uid->bytes, uid->size) == 0 &&
+        (len == 0 || mbedtls_md_hmac_update(&hmac, data, len) == 0) &&
+        mbedtls_md_hmac_finish(&hmac, out) == 0;
+}
+
+// Constant time, so a forged block learns nothing from how long the check took
+static bool bytes_equal(const uint8_t *a, const uint8_t *b, size_t len) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+static int hex_parse(const char *hex, uint8_t *out, size_t cap) {
+    size_t n = 0;
+    for (; hex[0] && hex[1]; hex += 2) {
+        int v = 0;
+        for (int i = 0; i < 2; i++) {
+            char c = hex[i];
+            int d = c >= '0' && c <= '9' ? c - '0' :
+                    c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                    c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            if (d < 0) return -1;
+            v = v * 16 + d;
+        }
+        if (n >= cap) return -1;
+        out[n++] = v;
+    }
+    return hex[0] ? -1 : (int)n;
+}
+
+// Cached secret for the UID, derived on a miss into the least recently used slot
+static tag_auth_entry_t *cache_get(const rc522_uid_t *uid, bool *hit) {
+    tag_auth_entry_t *victim = &cache[0];
+    for (int i = 0; i < TAG_AUTH_CACHE_SIZE; i++) {
+        tag_auth_entry_t *e = &cache[i];
+        if (e->uid_len == uid->size && memcmp(e->uid, uid->bytes, uid->size) == 0) {
+            e->used = ++use_clock;
+            *hit = true;
+            return e;
+        }
+        if (e->used < victim->used) victim = e;
+    }
+
+    uint8_t secret[32];
+    *hit = false;
+    if (!hmac_run('K', uid, NULL, 0, secret)) {
+        return NULL;
+    }
+    memset(victim, 0, sizeof(*victim));
+    victim->uid_len = uid->size;
+    memcpy(victim->uid, uid->bytes, uid->size);
+    memcpy(victim->secret.mf_key, secret, RC522_MF_KEY_SIZE);
+    memcpy(victim->secret.ntag_pwd, secret, RC522_NTAG_PWD_SIZE);
+    memcpy(victim->secret.ntag_pack, &secret[RC522_NTAG_PWD_SIZE], RC522_NTAG_PACK_SIZE);
+    victim->used = ++use_clock;
+    memset(secret, 0, sizeof(secret));
+    return victim;
+}
+
+static tag_auth_result_t tag_auth_check(rc522_t *dev, const rc522_uid_t *uid, uint32_t *serial, bool *hmac_free) {
+    uint8_t block[RC522_BLOCK_SIZE];
+    bool hit;
+
+    if (!ready) return TAG_AUTH_NO_KEY;
+    if (rc522_tag_type(uid) == RC522_TAG_OTHER) return TAG_AUTH_UNSUPPORTED;
+
+    tag_auth_entry_t *e = cache_get(uid, &hit);
+    if (!e || rc522_read_protected(dev, uid, TAG_AUTH_BLOCK, &e->secret, block) != RC522_OK) {
+        return TAG_AUTH_LOCKED;
+    }
+    if (block[0] != TAG_AUTH_FORMAT) {
+        return TAG_AUTH_BAD_MAC;
+    }
+
+    *hmac_free = hit && e->verified && bytes_equal(e->block, block, sizeof(block));
+    if (!*hmac_free) {
+        uint8_t mac[32];
+        e->verified = false;
+        if (!hmac_run('C', uid, block, TAG_AUTH_PAYLOAD_LEN, mac) ||
+            !bytes_equal(mac, &block[TAG_AUTH_PAYLOAD_LEN], TAG_AUTH_MAC_LEN)) {
+            return TAG_AUTH_BAD_MAC;
+        }
+        memcpy(e->block, block, sizeof(block));
+        e->verified = true;
+    }
+    *serial = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+    return TAG_AUTH_OK;
+}
+
+void tag_auth_visit(rc522_t *dev, const rc522_uid_t *uid, int index, void *arg) {
+    tag_auth_verdict_t *v = &((tag_auth_verdict_t *)arg)[index];
+    int64_t start = esp_timer_get_time();
+    bool hmac_free = false;
+
+    v->serial = 0;
+    v->result = tag_auth_check(dev, uid, &v->serial, &hmac_free);
+    v->elapsed_us = (uint32_t)(esp_timer_get_time() - start);
+
+    if (v->result == TAG_AUTH_OK) stats.verified++;
+    else stats.rejected++;
+    if (hmac_free) stats.cache_hits++;
+    else stats.cache_misses++;
+    stats.last_us = v->elapsed_us;
+    if (v->elapsed_us > stats.max_us) stats.max_us = v->elapsed_us;
+}
+
+esp_err_t tag_auth_init(void) {
+    uint8_t key[TAG_AUTH_KEY_MAX];
+    size_t len = sizeof(key);
+    const char *source = "NVS";
+    nvs_handle_t nvs;
+
+    mem_budget_add("tag auth cache", sizeof(cache));
+    esp_err_t ret = nvs_open(TAG_AUTH_NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (ret == ESP_OK) {
+        ret = nvs_get_blob(nvs, TAG_AUTH_NVS_KEY, key, &len);
+        nvs_close(nvs);
+    }
+    if (ret != ESP_OK) {
+        int n = hex_parse(CONFIG_SCANNER_TAG_AUTH_SITE_KEY, key, sizeof(key));
+        len = n < 0 ? 0 : n;
+        source = "Kconfig";
+    }
+    if (len < TAG_AUTH_KEY_MIN) {
+        SCAN_LOGE("AUTH", "No site key of %d-%d bytes in NVS (%s/%s) or Kconfig, every tap is rejected\n",
+            TAG_AUTH_KEY_MIN, TAG_AUTH_KEY_MAX, TAG_AUTH_NVS_NAMESPACE, TAG_AUTH_NVS_KEY);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Only the keyed context keeps the key from here on
+    mbedtls_md_init(&hmac);
+    int err = mbedtls_md_setup(&hmac, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+    if (err == 0) {
+        err = mbedtls_md_hmac_starts(&hmac, key, len);
+    }
+    memset(key, 0, sizeof(key));
+    if (err != 0) {
+        mbedtls_md_free(&hmac);
+        SCAN_LOGE("AUTH", "HMAC setup failed: -0x%04x\n", -err);
+        return ESP_FAIL;
+    }
+    ready = true;
+    SCAN_LOGI("AUTH", "Site key loaded from %s, credential at block/page %d\n", source, TAG_AUTH_BLOCK);
+    return ESP_OK;
+}
+
+const char *tag_auth_result_name(tag_auth_result_t result) {
+    switch (result) {
+    case TAG_AUTH_OK: return "verified";
+    case TAG_AUTH_NO_KEY: return "no site key";
+    case TAG_AUTH_UNSUPPORTED: return "tag type not supported";
+    case TAG_AUTH_LOCKED: return "secret refused";
+    case TAG_AUTH_BAD_MAC: return "credential MAC mismatch";
+    }
+    return "?";
+}
+
+tag_auth_stats_t tag_auth_stats(void) {
+    return stats;
+}
+
+#endif
@@ -0,0 +1,54 @@
+// Authenticated keyfob reads
+//
+// A bare UID is trivially cloned, so with this on a tap only counts when the keyfob
+// unlocks its credential block with a per-tag secret and the block carries a MAC
+// over its UID. Both derive from one site key with HMAC-SHA256:
+//
+//   secret  = HMAC(site, "K" | UID)       Classic key A = secret[0..5],
+//                                         NTAG password = secret[0..3], PACK = secret[4..5]
+//   block   = payload | HMAC(site, "C" | UID | payload)[0..7]
+//   payload = format, key generation, 2 reserved, serial (LE)   8 bytes
+//
+// The block sits at CONFIG_SCANNER_TAG_AUTH_BLOCK: a Classic block in a sector
+// whose key A is the secret, or the first of four NTAG pages behind the password.
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "rc522.h"
+
+#define TAG_AUTH_FORMAT         0x01
+
+typedef enum {
+    TAG_AUTH_OK = 0,
+    TAG_AUTH_NO_KEY,            // no site key configured
+    TAG_AUTH_UNSUPPORTED,       // neither MIFARE Classic nor NTAG
+    TAG_AUTH_LOCKED,            // the tag refused the secret, or the read failed
+    TAG_AUTH_BAD_MAC,           // block not issued for this UID under this site key
+} tag_auth_result_t;
+
+// Outcome of one tag, filled in by tag_auth_visit()
+typedef struct {
+    tag_auth_result_t result;
+    uint32_t serial;            // credential serial, valid with TAG_AUTH_OK
+    uint32_t elapsed_us;        // unlock, read and verify
+} tag_auth_verdict_t;
+
+typedef struct {
+    uint32_t verified;
+    uint32_t rejected;
+    uint32_t cache_hits;        // taps that needed no HMAC at all
+    uint32_t cache_misses;
+    uint32_t last_us;
+    uint32_t max_us;
+} tag_auth_stats_t;
+
+// Load the site key from NVS, or from Kconfig when NVS has none; needs NVS
+esp_err_t tag_auth_init(void);
+
+// rc522_tag_fn for rc522_scan_tags_visit(); arg is a tag_auth_verdict_t array with
+// room for the tags scanned. Only the scan task may call it.
+void tag_auth_visit(rc522_t *dev, const rc522_uid_t *uid, int index, void *arg);
+
+const char *tag_auth_result_name(tag_auth_result_t result);
+tag_auth_stats_t tag_auth_stats(void);
@@ -0,0 +1,357 @@
+// Telemetry
+//
+// Counters and histogram buckets are 32-bit atomics, which the ESP32 updates
+// without a lock. Histogram sums are 64-bit so that _sum never wraps while
+// _count keeps growing; a 64-bit atomic would take a lock anyway, so they are
+// added and read under sum_lock instead. Gauges (queue depth, heap low-water
+// mark, journal backlog) are read when a snapshot is taken.
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_http_server.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "scan_queue.h"
+#include "scan_journal.h"
+#include "scan_log.h"
+#include "mem_budget.h"
+#include "telemetry.h"
+
+typedef struct {
+    const char *name;               // Prometheus metric name
+    const char *help;
+    bool per_reader;
+    bool seconds;                   // values are us, exported as seconds
+    uint32_t bounds[TELEMETRY_BUCKETS];
+} hist_def_t;
+
+static const hist_def_t hist_defs[TM_HIST_COUNT] = {
+    [TM_DETECT_US] = {
+        "scanner_detect_seconds", "Probe start to card answer", true, true,
+        {250, 500, 1000, 1500, 2000, 3000, 5000, 10000, 25000, 50000, 100000, 500000},
+    },
+    [TM_ANTICOLL_US] = {
+        "scanner_anticollision_seconds", "Anticollision, select and halt of every tag in the field", true, true,
+        {2500, 5000, 7500, 10000, 15000, 20000, 30000, 50000, 75000, 100000, 250000, 1000000},
+    },
+    [TM_SPI_TXN] = {
+        "scanner_spi_transactions_per_scan", "SPI transactions for one scan", true, false,
+        {25, 50, 100, 150, 200, 250, 300, 400, 600, 800, 1200, 2000},
+    },
+    [TM_HTTP_RTT_US] = {
+        "scanner_http_rtt_seconds", "Backend request to response", false, true,
+        {5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2000000, 5000000, 10000000, 30000000},
+    },
+    [TM_PROBE_GAP_US] = {
+        "scanner_probe_gap_seconds", "Time between the probe that found a card and the one before", false, true,
+        {10000, 25000, 50000, 75000, 100000, 150000, 200000, 250000, 300000, 500000, 750000, 1000000},
+    },
+    [TM_AUTH_US] = {
+        "scanner_auth_seconds", "Unlock, read and verify of one keyfob credential", true, true,
+        {1000, 2000, 3000, 4000, 5000, 6000, 8000, 10000, 15000, 25000, 50000, 100000},
+    },
+};
+
+static const struct {
+    const char *name;
+    const char *help;
+} counter_defs[TM_COUNTER_COUNT] = {
+    [TM_SCANS] = {"scanner_scans_total", "Taps queued for upload"},
+    [TM_SCANS_SUPPRESSED] = {"scanner_scans_suppressed_total", "Repeat taps inside the debounce window"},
+    [TM_HTTP_REQUESTS] = {"scanner_http_requests_total", "Backend requests"},
+    [TM_HTTP_FAILURES] = {"scanner_http_failures_total", "Backend requests that failed in transport"},
+    [TM_WIFI_DISCONNECTS] = {"scanner_wifi_disconnects_total", "Wi-Fi links lost"},
+    [TM_WIFI_RECONNECTS] = {"scanner_wifi_reconnects_total", "Wi-Fi links regained"},
+    [TM_TELEMETRY_PUSHES] = {"scanner_telemetry_pushes_total", "Snapshots pushed to the backend"},
+    [TM_SPI_CLOCK_FALLBACKS] = {"scanner_spi_clock_fallbacks_total", "Reader SPI clock steps down after readback errors"},
+    [TM_PROBES] = {"scanner_probes_total", "Probe rounds over all readers"},
+    [TM_FIELD_ON_MS] = {"scanner_field_on_ms_total", "Milliseconds the readers were powered up with the RF field on"},
+    [TM_AUTH_FAILURES] = {"scanner_auth_failures_total", "Taps dropped because the keyfob did not authenticate"},
+};
+
+typedef struct {
+    atomic_uint_fast32_t buckets[TELEMETRY_BUCKETS + 1];
+    uint64_t sum;                   // under sum_lock
+} hist_t;
+
+static atomic_uint_fast32_t counters[TM_COUNTER_COUNT];
+static hist_t hists[TM_HIST_COUNT][TELEMETRY_READERS];
+static portMUX_TYPE sum_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void telemetry_count(telemetry_counter_t counter) {
+    atomic_fetch_add_explicit(&counters[counter], 1, memory_order_relaxed);
+}
+
+void telemetry_add(telemetry_counter_t counter, uint32_t n) {
+    atomic_fetch_add_explicit(&counters[counter], n, memory_order_relaxed);
+}
+
+void telemetry_observe(telemetry_hist_t hist, int reader, uint32_t value) {
+    const hist_def_t *def = &hist_defs[hist];
+    if (!def->per_reader || reader < 0 || reader >= TELEMETRY_READERS) {
+        reader = 0;
+    }
+    int b = 0;
+    while (b < TELEMETRY_BUCKETS && value > def->bounds[b]) {
+        b++;
+    }
+    hist_t *h = &hists[hist][reader];
+    atomic_fetch_add_explicit(&h->buckets[b], 1, memory_order_relaxed);
+    portENTER_CRITICAL(&sum_lock);
+    h->sum += value;
+    portEXIT_CRITICAL(&sum_lock);
+}
+
+static uint32_t load(atomic_uint_fast32_t *v) {
+    return atomic_load_explicit(v, memory_order_relaxed);
+}
+
+// Output goes through a small buffer that is flushed as an HTTP chunk when full
+typedef struct {
+    httpd_req_t *req;
+    char buf[512];
+    size_t len;
+    esp_err_t err;
+} metrics_out_t;
+
+static void out_flush(metrics_out_t *out) {
+    if (out->len && out->err == ESP_OK) {
+        out->err = httpd_resp_send_chunk(out->req, out->buf, out->len);
+    }
+    out->len = 0;
+}
+
+static void out_printf(metrics_out_t *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void out_printf(metrics_out_t *out, const char *fmt, ...) {
+    va_list args;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_start(args, fmt);
+        int n = vsnprintf(out->buf + out->len, sizeof(out->buf) - out->len, fmt, args);
+        va_end(args);
+        if (n >= 0 && (size_t)n < sizeof(out->buf) - out->len) {
+            out->len += n;
+            return;
+        }
+        // Did not fit: send what we have and retry into the empty buffer
+        out_flush(out);
+    }
+}
+
+static void render_value(metrics_out_t *out, const hist_def_t *def, uint64_t v) {
+    if (def->seconds) {
+        out_printf(out, "%llu.%06lu", (unsigned long long)(v / 1000000), (unsigned long)(v % 1000000));
+    } else {
+        out_printf(out, "%llu", (unsigned long long)v);
+    }
+}
+
+static void render_hist(metrics_out_t *out, telemetry_hist_t id) {
+    const hist_def_t *def = &hist_defs[id];
+    int series = def->per_reader ? TELEMETRY_READERS : 1;
+
+    out_printf(out, "# HELP %s %s\n# TYPE %s histogram\n", def->name, def->help, def->name);
+    for (int r = 0; r < series; r++) {
+        hist_t *h = &hists[id][r];
+        char label[24] = "";
+        if (def->per_reader) {
+            // Readers that never saw a card are left out
+            uint32_t seen = 0;
+            for (int b = 0; b <= TELEMETRY_BUCKETS; b++) seen += load(&h->buckets[b]);
+            if (seen == 0) continue;
+            snprintf(label, sizeof(label), "reader=\"%d\",", r);
+        }
+
+        uint32_t cumulative = 0;
+        for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+            cumulative += load(&h->buckets[b]);
+            out_printf(out, "%s_bucket{%sle=\"", def->name, label);
+            render_value(out, def, def->bounds[b]);
+            out_printf(out, "\"} %lu\n", (unsigned long)cumulative);
+        }
+        cumulative += load(&h->buckets[TELEMETRY_BUCKETS]);
+        out_printf(out, "%s_bucket{%sle=\"+Inf\"} %lu\n", def->name, label, (unsigned long)cumulative);
+
+        // Drop the trailing comma for the plain series
+        size_t label_len = strlen(label);
+        if (label_len) label[label_len - 1] = '\0';
+        out_printf(out, "%s_sum%s%s%s ", def->name, label_len ? "{" : "", label, label_len ? "}" : "");
+        portENTER_CRITICAL(&sum_lock);
+        uint64_t sum = h->sum;
+        portEXIT_CRITICAL(&sum_lock);
+        render_value(out, def, sum);
+        out_printf(out, "\n%s_count%s%s%s %lu\n", def->name, label_len ? "{" : "", label,
+            label_len ? "}" : "", (unsigned long)cumulative);
+    }
+}
+
+static void render_gauge(metrics_out_t *out, const char *name, const char *help, unsigned long value) {
+    out_printf(out, "# HELP %s %s\n# TYPE %s gauge\n%s %lu\n", name, help, name, name, value);
+}
+
+static metrics_out_t out;           // the server runs handlers on one task
+
+static void out_begin(httpd_req_t *req, const char *type) {
+    out.req = req;
+    out.len = 0;
+    out.err = ESP_OK;
+    httpd_resp_set_type(req, type);
+}
+
+static esp_err_t out_end(void) {
+    out_flush(&out);
+    if (out.err != ESP_OK) {
+        return out.err;
+    }
+    return httpd_resp_send_chunk(out.req, NULL, 0);
+}
+
+static esp_err_t metrics_handler(httpd_req_t *req) {
+    out_begin(req, "text/plain; version=0.0.4");
+
+    for (int c = 0; c < TM_COUNTER_COUNT; c++) {
+        out_printf(&out, "# HELP %s %s\n# TYPE %s counter\n%s %lu\n", counter_defs[c].name,
+            counter_defs[c].help, counter_defs[c].name, counter_defs[c].name, (unsigned long)load(&counters[c]));
+    }
+    scan_queue_stats_t qs = scan_queue_stats();
+    out_printf(&out, "# HELP scanner_queue_dropped_total Taps lost because the queue was full\n"
+        "# TYPE scanner_queue_dropped_total counter\nscanner_queue_dropped_total %lu\n", (unsigned long)qs.dropped);
+    out_printf(&out, "# HELP scanner_log_dropped_total Log messages lost because the log ring was full\n"
+        "# TYPE scanner_log_dropped_total counter\nscanner_log_dropped_total %lu\n", (unsigned long)scan_log_dropped());
+    render_gauge(&out, "scanner_queue_depth", "Taps waiting in the RAM queue", qs.depth);
+    render_gauge(&out, "scanner_queue_high_water", "Deepest the RAM queue has been", qs.high_water);
+    render_gauge(&out, "scanner_journal_pending", "Stored taps not yet acknowledged by the backend",
+        scan_journal_ready() ? scan_journal_pending() : 0);
+    render_gauge(&out, "scanner_heap_free_bytes", "Free heap", esp_get_free_heap_size());
+    render_gauge(&out, "scanner_heap_min_free_bytes", "Heap low-water mark since boot", esp_get_minimum_free_heap_size());
+    render_gauge(&out, "scanner_heap_largest_free_block_bytes", "Largest free heap block; well below free heap means fragmentation",
+        heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    mem_budget_task_t tasks[MEM_BUDGET_TASKS];
+    int task_count = mem_budget_tasks(tasks, MEM_BUDGET_TASKS);
+    out_printf(&out, "# HELP scanner_task_stack_free_bytes Least free stack since boot\n"
+        "# TYPE scanner_task_stack_free_bytes gauge\n");
+    for (int i = 0; i < task_count; i++) {
+        out_printf(&out, "scanner_task_stack_free_bytes{task=\"%s\"} %lu\n", tasks[i].name,
+            (unsigned long)tasks[i].stack_free);
+    }
+    out_printf(&out, "# HELP scanner_task_heap_allocs_total Heap allocations made by the task (needs CONFIG_HEAP_USE_HOOKS)\n"
+        "# TYPE scanner_task_heap_allocs_total counter\n");
+    for (int i = 0; i < task_count; i++) {
+        out_printf(&out, "scanner_task_heap_allocs_total{task=\"%s\"} %lu\n", tasks[i].name,
+            (unsigned long)tasks[i].heap_allocs);
+    }
+    render_gauge(&out, "scanner_uptime_seconds", "Time since boot", (unsigned long)(esp_timer_get_time() / 1000000));
+    for (int h = 0; h < TM_HIST_COUNT; h++) {
+        render_hist(&out, h);
+    }
+    return out_end();
+}
+
+static void log_line(uint32_t time_ms, int level, const char *text, void *ctx) {
+    out_printf(ctx, "(%lu) %s", (unsigned long)time_ms, text);
+}
+
+// The log ring, oldest first; after a reset it starts with the previous boot's tail
+static esp_err_t log_handler(httpd_req_t *req) {
+    out_begin(req, "text/plain");
+    scan_log_for_each(log_line, &out);
+    return out_end();
+}
+
+esp_err_t telemetry_server_start(uint16_t port) {
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = port;
+    // The control socket only has to differ from the other servers' default one
+    config.ctrl_port = port < UINT16_MAX ? port + 1 : port - 1;
+    config.max_uri_handlers = 2;
+
+    httpd_handle_t server = NULL;
+    esp_err_t ret = httpd_start(&server, &config);
+    if (ret != ESP_OK) {
+        SCAN_LOGE("METRICS", "Server start failed: %s\n", esp_err_to_name(ret));
+        return ret;
+    }
+    httpd_uri_t metrics = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = metrics_handler,
+    };
+    httpd_uri_t log = {
+        .uri = "/log",
+        .method = HTTP_GET,
+        .handler = log_handler,
+    };
+    ret = httpd_register_uri_handler(server, &metrics);
+    if (ret == ESP_OK) {
+        ret = httpd_register_uri_handler(server, &log);
+    }
+    if (ret == ESP_OK) {
+        SCAN_LOGI("METRICS", "Serving /metrics and /log on port %u\n", port);
+    }
+    return ret;
+}
+
+// {"device":..,"uptime":s,"counters":[..],"gauges":[queue depth, queue high water,
+//  queue dropped, journal pending, heap min free, heap largest free block],"hist":{"detect":{"le":[..],
+//  "readers":[[buckets + inf],..]},..}}
+// Counters follow telemetry_counter_t; readers without samples are sent as [].
+size_t telemetry_render_push(char *buf, size_t cap, const char *device) {
+    static const char *keys[TM_HIST_COUNT] = {
+        [TM_DETECT_US] = "detect",
+        [TM_ANTICOLL_US] = "anticollision",
+        [TM_SPI_TXN] = "spi_txn",
+        [TM_HTTP_RTT_US] = "http_rtt",
+        [TM_PROBE_GAP_US] = "probe_gap",
+        [TM_AUTH_US] = "auth",
+    };
+    size_t len = 0;
+#define PUSH(...) do { \
+        int n_ = snprintf(buf + len, cap - len, __VA_ARGS__); \
+        if (n_ < 0 || (size_t)n_ >= cap - len) return 0; \
+        len += n_; \
+    } while (0)
+
+    PUSH("{\"device\":\"%s\",\"uptime\":%lld,\"counters\":[", device,
+        (long long)(esp_timer_get_time() / 1000000));
+    for (int c = 0; c < TM_COUNTER_COUNT; c++) {
+        PUSH("%s%lu", c ? "," : "", (unsigned long)load(&counters[c]));
+    }
+    scan_queue_stats_t qs = scan_queue_stats();
+    PUSH("],\"gauges\":[%lu,%lu,%lu,%lu,%lu,%lu],\"hist\":{", (unsigned long)qs.depth,
+        (unsigned long)qs.high_water, (unsigned long)qs.dropped,
+        (unsigned long)(scan_journal_ready() ? scan_journal_pending() : 0),
+        (unsigned long)esp_get_minimum_free_heap_size(),
+        (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    for (int id = 0; id < TM_HIST_COUNT; id++) {
+        const hist_def_t *def = &hist_defs[id];
+        PUSH("%s\"%s\":{\"le\":[", id ? "," : "", keys[id]);
+        for (int b = 0; b < TELEMETRY_BUCKETS; b++) {
+            PUSH("%s%lu", b ? "," : "", (unsigned long)def->bounds[b]);
+        }
+        PUSH("],\"readers\":[");
+        int series = def->per_reader ? TELEMETRY_READERS : 1;
+        for (int r = 0; r < series; r++) {
+            hist_t *h = &hists[id][r];
+            uint32_t counts[TELEMETRY_BUCKETS + 1];
+            uint32_t seen = 0;
+            for (int b = 0; b <= TELEMETRY_BUCKETS; b++) {
+                counts[b] = load(&h->buckets[b]);
+                seen += counts[b];
+            }
+            PUSH("%s[", r ? "," : "");
+            for (int b = 0; seen && b <= TELEMETRY_BUCKETS; b++) {
+                PUSH("%s%lu", b ? "," : "", (unsigned long)counts[b]);
+            }
+            PUSH("]");
+        }
+        PUSH("]}");
+    }
+    PUSH("}}");
+#undef PUSH
+    return len;
+}
@@ -0,0 +1,50 @@
+// Runtime counters and latency histograms
+//
+// Recording is a relaxed atomic add, so any task (or an ISR) can count without
+// locks. The snapshot is served in Prometheus text format on GET /metrics and
+// pushed to the backend in compact JSON by the upload task.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define TELEMETRY_READERS   4       // per-reader series; matches RC522_PROBE_MAX
+#define TELEMETRY_BUCKETS   12      // finite buckets per histogram, +Inf comes on top
+
+typedef enum {
+    TM_SCANS = 0,                   // taps queued for upload
+    TM_SCANS_SUPPRESSED,            // repeats inside the debounce window
+    TM_HTTP_REQUESTS,
+    TM_HTTP_FAILURES,               // transport errors, not HTTP status codes
+    TM_WIFI_DISCONNECTS,
+    TM_WIFI_RECONNECTS,             // links regained after the first connect
+    TM_TELEMETRY_PUSHES,
+    TM_SPI_CLOCK_FALLBACKS,         // reader clock lowered after link errors
+    TM_PROBES,                      // probe rounds over all readers
+    TM_FIELD_ON_MS,                 // time the readers were powered up, RF field on
+    TM_AUTH_FAILURES,               // taps dropped because the keyfob did not authenticate
+    TM_COUNTER_COUNT
+} telemetry_counter_t;
+
+typedef enum {
+    TM_DETECT_US = 0,               // probe start to card answer, per reader
+    TM_ANTICOLL_US,                 // anticollision, select and halt of every tag, per reader
+    TM_SPI_TXN,                     // SPI transactions per scan, per reader
+    TM_HTTP_RTT_US,                 // request to response, any backend call
+    TM_PROBE_GAP_US,                // gap before the probe that found a card: its worst wait
+    TM_AUTH_US,                     // unlock, read and verify of one tag's credential, per reader
+    TM_HIST_COUNT
+} telemetry_hist_t;
+
+void telemetry_count(telemetry_counter_t counter);
+void telemetry_add(telemetry_counter_t counter, uint32_t n);
+// reader is ignored for histograms that are not per reader
+void telemetry_observe(telemetry_hist_t hist, int reader, uint32_t value);
+
+// Serve GET /metrics, and the log ring on GET /log, on the given port
+esp_err_t telemetry_server_start(uint16_t port);
+
+// Compact JSON snapshot for POST /api/druppel/telemetry; returns the length, or 0
+// when it does not fit
+size_t telemetry_render_push(char *buf, size_t cap, const char *device);